@@ -3,15 +3,20 @@ SUBDIRS  = \
     adblock \
     addbookmarkdialog \
     autosaver \
+    closedtabstore \
     cookiejar \
+    downloadwriter \
     historyfiltermodel \
     historymanager \
     modeltoolbar \
+    networkcachestore \
+    networkmonitor \
     opensearchengine \
     opensearchmanager \
     opensearchreader \
     opensearchwriter \
     searchlineedit \
+    sessionjournal \
     tabbar \
     tabwidget \
     utils \
@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QtTest/QtTest>
+#include "qtest_arora.h"
+
+#include <browserapplication.h>
+#include <closedtabstore.h>
+
+class tst_ClosedTabStore : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void closedtabstore_data();
+    void closedtabstore();
+    void take_data();
+    void take();
+    void maximumCount();
+    void memoryBudget();
+    void persistence();
+    void clear();
+
+private:
+    static QByteArray history(int i);
+
+    QString m_fileName;
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_ClosedTabStore::initTestCase()
+{
+    m_fileName = QDir::tempPath() + QLatin1String("/tst_closedtabstore");
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_ClosedTabStore::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_ClosedTabStore::init()
+{
+    QFile::remove(m_fileName);
+    QFile::remove(m_fileName + QLatin1String(".data"));
+}
+
+// This will be called after every test function.
+void tst_ClosedTabStore::cleanup()
+{
+    init();
+}
+
+// Histories that don't compress away to nothing
+QByteArray tst_ClosedTabStore::history(int i)
+{
+    QByteArray data;
+    qsrand(i);
+    for (int j = 0; j < 4096; ++j)
+        data.append(char(qrand() % 256));
+    return data;
+}
+
+void tst_ClosedTabStore::closedtabstore_data()
+{
+}
+
+void tst_ClosedTabStore::closedtabstore()
+{
+    ClosedTabStore store(m_fileName);
+    QVERIFY(store.isEmpty());
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.memoryUsage(), 0);
+    QCOMPARE(store.url(0), QUrl());
+    QCOMPARE(store.id(0), quint32(0));
+    QCOMPARE(store.indexOf(1), -1);
+    QCOMPARE(store.take(0).url, QUrl());
+    store.setMaximumCount(5);
+    QCOMPARE(store.maximumCount(), 5);
+    store.setMemoryBudget(1024);
+    QCOMPARE(store.memoryBudget(), 1024);
+}
+
+void tst_ClosedTabStore::take_data()
+{
+    QTest::addColumn<QByteArray>("history");
+    QTest::newRow("no history") << QByteArray();
+    QTest::newRow("history") << history(1);
+}
+
+// public ClosedTabStore::Tab take(int index)
+void tst_ClosedTabStore::take()
+{
+    QFETCH(QByteArray, history);
+
+    ClosedTabStore store(m_fileName);
+    QSignalSpy spy(&store, SIGNAL(changed()));
+    store.prepend(QUrl("http://a/"), "a");
+    store.prepend(QUrl("http://b/"), history);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.url(0), QUrl("http://b/"));
+    QCOMPARE(store.indexOf(store.id(1)), 1);
+
+    ClosedTabStore::Tab tab = store.take(0);
+    QCOMPARE(tab.url, QUrl("http://b/"));
+    QCOMPARE(tab.history, history);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(spy.count(), 3);
+
+    tab = store.take(0);
+    QCOMPARE(tab.url, QUrl("http://a/"));
+    QCOMPARE(tab.history, QByteArray("a"));
+    QVERIFY(store.isEmpty());
+    QCOMPARE(store.memoryUsage(), 0);
+}
+
+void tst_ClosedTabStore::maximumCount()
+{
+    ClosedTabStore store(m_fileName);
+    store.setMaximumCount(3);
+    for (int i = 0; i < 5; ++i)
+        store.prepend(QUrl(QString("http://%1/").arg(i)), history(i));
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.url(0), QUrl("http://4/"));
+    QCOMPARE(store.url(2), QUrl("http://2/"));
+
+    store.setMaximumCount(1);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.take(0).history, history(4));
+}
+
+// Histories over the budget are moved to the data file and read back
+void tst_ClosedTabStore::memoryBudget()
+{
+    ClosedTabStore store(m_fileName);
+    store.setMemoryBudget(6000);
+    for (int i = 0; i < 5; ++i)
+        store.prepend(QUrl(QString("http://%1/").arg(i)), history(i));
+    QVERIFY(store.memoryUsage() <= 6000);
+    QVERIFY(store.memoryUsage() > 0);
+    QVERIFY(QFile::exists(m_fileName + QLatin1String(".data")));
+
+    for (int i = 4; i >= 0; --i) {
+        ClosedTabStore::Tab tab = store.take(0);
+        QCOMPARE(tab.url, QUrl(QString("http://%1/").arg(i)));
+        QCOMPARE(tab.history, history(i));
+    }
+    QCOMPARE(store.memoryUsage(), 0);
+}
+
+void tst_ClosedTabStore::persistence()
+{
+    {
+        ClosedTabStore store(m_fileName);
+        for (int i = 0; i < 3; ++i)
+            store.prepend(QUrl(QString("http://%1/").arg(i)), history(i));
+        store.prepend(QUrl("http://empty/"), QByteArray());
+        store.save();
+    }
+
+    ClosedTabStore store(m_fileName);
+    QCOMPARE(store.count(), 4);
+    // Only the urls are read until a tab is taken
+    QCOMPARE(store.memoryUsage(), 0);
+    ClosedTabStore::Tab tab = store.take(0);
+    QCOMPARE(tab.url, QUrl("http://empty/"));
+    QVERIFY(tab.history.isEmpty());
+    for (int i = 2; i >= 0; --i) {
+        tab = store.take(0);
+        QCOMPARE(tab.url, QUrl(QString("http://%1/").arg(i)));
+        QCOMPARE(tab.history, history(i));
+    }
+}
+
+// public void clear()
+void tst_ClosedTabStore::clear()
+{
+    ClosedTabStore store(m_fileName);
+    store.setMemoryBudget(0);
+    store.prepend(QUrl("http://a/"), history(1));
+    store.save();
+    QVERIFY(QFile::exists(m_fileName));
+    QVERIFY(QFile::exists(m_fileName + QLatin1String(".data")));
+
+    store.clear();
+    QVERIFY(store.isEmpty());
+    QVERIFY(!QFile::exists(m_fileName + QLatin1String(".data")));
+
+    ClosedTabStore reloaded(m_fileName);
+    QVERIFY(reloaded.isEmpty());
+}
+
+// Tabs closed while browsing privately never reach the disk
+void tst_ClosedTabStore::privateBrowsing()
+{
+    ClosedTabStore store(m_fileName);
+    store.setMemoryBudget(0);
+    store.prepend(QUrl("http://public/"), history(1));
+
+    BrowserApplication::setPrivate(true);
+    store.prepend(QUrl("http://private/"), history(2));
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.url(0), QUrl("http://private/"));
+    store.save();
+    {
+        ClosedTabStore reloaded(m_fileName);
+        QCOMPARE(reloaded.count(), 1);
+        QCOMPARE(reloaded.url(0), QUrl("http://public/"));
+    }
+
+    QSignalSpy spy(&store, SIGNAL(changed()));
+    BrowserApplication::setPrivate(false);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.url(0), QUrl("http://public/"));
+    store.save();
+
+    QFile data(m_fileName + QLatin1String(".data"));
+    QVERIFY(data.open(QIODevice::ReadOnly));
+    QVERIFY(!data.readAll().contains(qCompress(history(2))));
+
+    ClosedTabStore reloaded(m_fileName);
+    QCOMPARE(reloaded.count(), 1);
+    QCOMPARE(reloaded.take(0).history, history(1));
+}
+
+QTEST_MAIN(tst_ClosedTabStore)
+#include "tst_closedtabstore.moc"
+
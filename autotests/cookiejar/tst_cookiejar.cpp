@@ -66,6 +66,10 @@ private slots:
     void cookiesChanged();
     void isOnDomainList_data();
     void isOnDomainList();
+    void exceptionRules_data();
+    void exceptionRules();
+    void exceptionRulesBenchmark_data();
+    void exceptionRulesBenchmark();
 };
 
 // Subclass that exposes the protected functions.
@@ -77,6 +81,9 @@ public:
 
     static bool call_isOnDomainList(QStringList const &list, QString const &domain)
         { return SubCookieJar::isOnDomainList(list, domain); }
+
+    QList<CookieRule> call_exceptionRules(const QString &domain) const
+        { return SubCookieJar::exceptionRules(domain); }
 };
 
 // This will be called before the first test function is executed.
@@ -551,6 +558,75 @@ void tst_CookieJar::isOnDomainList()
     QCOMPARE(jar.call_isOnDomainList(list, domain), isOnDomainList);
 }
 
+void tst_CookieJar::exceptionRules_data()
+{
+    QTest::addColumn<QStringList>("blocked");
+    QTest::addColumn<QStringList>("allowed");
+    QTest::addColumn<QString>("domain");
+    QTest::addColumn<bool>("block");
+    QTest::addColumn<bool>("allow");
+
+    QTest::newRow("null") << QStringList() << QStringList() << QString() << false << false;
+    QTest::newRow("block") << (QStringList() << "foo.com") << QStringList() << "foo.com" << true << false;
+    QTest::newRow("block-sub") << (QStringList() << ".foo.com") << QStringList() << "a.b.foo.com" << true << false;
+    QTest::newRow("allow") << QStringList() << (QStringList() << "foo.com") << "www.foo.com" << false << true;
+    QTest::newRow("both") << (QStringList() << "ads.foo.com") << (QStringList() << "foo.com")
+                          << "ads.foo.com" << true << true;
+    QTest::newRow("parent-only") << (QStringList() << "ads.foo.com") << (QStringList() << "foo.com")
+                                 << "www.foo.com" << false << true;
+    QTest::newRow("no-match") << (QStringList() << "foo.com") << (QStringList() << "bar.com")
+                              << "foo.org" << false << false;
+}
+
+// protected QList<CookieRule> exceptionRules(const QString &domain) const
+void tst_CookieJar::exceptionRules()
+{
+    QFETCH(QStringList, blocked);
+    QFETCH(QStringList, allowed);
+    QFETCH(QString, domain);
+    QFETCH(bool, block);
+    QFETCH(bool, allow);
+
+    SubCookieJar jar;
+    jar.setPrivate(true);
+    jar.setBlockedCookies(blocked);
+    jar.setAllowedCookies(allowed);
+
+    QList<CookieJar::CookieRule> rules = jar.call_exceptionRules(domain);
+    QCOMPARE(rules.contains(CookieJar::Block), block);
+    QCOMPARE(rules.contains(CookieJar::Allow), allow);
+}
+
+void tst_CookieJar::exceptionRulesBenchmark_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+    QTest::newRow("100000") << 100000;
+}
+
+// The lookup should not get slower as the number of exceptions grows
+void tst_CookieJar::exceptionRulesBenchmark()
+{
+    QFETCH(int, count);
+
+    QStringList blocked;
+    for (int i = 0; i < count; ++i)
+        blocked.append(QString(QLatin1String("tracker%1.example%2.com")).arg(i).arg(i % 10));
+
+    SubCookieJar jar;
+    jar.setPrivate(true);
+    jar.setBlockedCookies(blocked);
+
+    QString hit = QString(QLatin1String("www.tracker%1.example%2.com")).arg(count / 2).arg((count / 2) % 10);
+    QString miss = QLatin1String("www.arora-browser.org");
+    QBENCHMARK {
+        QVERIFY(jar.call_exceptionRules(hit).contains(CookieJar::Block));
+        QVERIFY(jar.call_exceptionRules(miss).isEmpty());
+    }
+}
+
 QTEST_MAIN(tst_CookieJar)
 #include "tst_cookiejar.moc"
 
@@ -45,8 +45,99 @@ private slots:
     void download();
     void removePolicy_data();
     void removePolicy();
+    void resumeInformation();
+    void resumeActive();
+    void scheduler();
+    void segmentsIgnored();
+    void segmentFailed();
 };
 
+// Serves one file over http, answering requests for a range either with
+// the whole file or with only half of the range before hanging up
+class RangeServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        IgnoreRanges,
+        FailRanges
+    };
+
+    RangeServer(Mode mode, const QByteArray &body)
+        : m_mode(mode)
+        , m_body(body)
+    {
+        listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url() const
+    {
+        return QUrl(QString("http://127.0.0.1:%1/segmented.bin").arg(serverPort()));
+    }
+
+protected:
+    void incomingConnection(int socketDescriptor)
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->setSocketDescriptor(socketDescriptor);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+    }
+
+private slots:
+    void readRequest()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        QByteArray &request = m_requests[socket];
+        request += socket->readAll();
+        if (!request.contains("\r\n\r\n"))
+            return;
+
+        QRegExp range("Range: bytes=(\\d+)-(\\d*)");
+        if (m_mode == FailRanges && range.indexIn(QString::fromLatin1(request)) != -1) {
+            qint64 start = range.cap(1).toLongLong();
+            qint64 end = range.cap(2).isEmpty() ? m_body.size() : range.cap(2).toLongLong() + 1;
+            QByteArray part = m_body.mid(start, end - start);
+            socket->write(QString("HTTP/1.1 206 Partial Content\r\n"
+                                  "Content-Range: bytes %1-%2/%3\r\n"
+                                  "Content-Length: %4\r\n"
+                                  "Connection: close\r\n\r\n")
+                          .arg(start).arg(end - 1).arg(m_body.size()).arg(part.size()).toLatin1());
+            socket->write(part.left(part.size() / 2));
+        } else {
+            socket->write(QString("HTTP/1.1 200 OK\r\n"
+                                  "Accept-Ranges: bytes\r\n"
+                                  "Content-Length: %1\r\n"
+                                  "Connection: close\r\n\r\n").arg(m_body.size()).toLatin1());
+            socket->write(m_body);
+        }
+        socket->disconnectFromHost();
+    }
+
+private:
+    Mode m_mode;
+    QByteArray m_body;
+    QHash<QTcpSocket*, QByteArray> m_requests;
+};
+
+// Large enough to be split into two segments
+static QByteArray segmentedBody()
+{
+    QByteArray body;
+    for (int i = 0; body.size() < 2 * 1024 * 1024 + 512 * 1024; ++i)
+        body += QByteArray::number(i) + '\n';
+    return body;
+}
+
+static void waitForDownload(DownloadItem *item)
+{
+    for (int i = 0; i < 100; ++i) {
+        if (item->state() == DownloadItem::Finished || item->state() == DownloadItem::Failed)
+            return;
+        QTest::qWait(100);
+    }
+}
+
 // Subclass that exposes the protected functions.
 class SubDownloadManager : public DownloadManager
 {
@@ -246,6 +337,163 @@ void tst_DownloadManager::removePolicy()
     QCOMPARE(view->model()->rowCount(), removePolicy == DownloadManager::Never ? 1 : 0);
 }
 
+// Partial downloads keep what is needed to resume them across restarts
+void tst_DownloadManager::resumeInformation()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(QByteArray(1024, 'a'));
+    file.close();
+
+    QVariantList missing;
+    missing << qint64(100) << qint64(200) << qint64(600) << qint64(1024);
+    {
+        QSettings settings;
+        settings.beginGroup("downloadmanager");
+        settings.setValue("download_0_url", QUrl(BIGFILE));
+        settings.setValue("download_0_location", file.fileName());
+        settings.setValue("download_0_done", false);
+        settings.setValue("download_0_etag", QByteArray("\"abc\""));
+        settings.setValue("download_0_missing", missing);
+    }
+
+    {
+        SubDownloadManager manager;
+        QTableView *view = manager.findChild<QTableView*>();
+        QVERIFY(view);
+        QCOMPARE(view->model()->rowCount(), 1);
+        QCOMPARE(manager.activeDownloads(), 0);
+    }
+
+    QSettings settings;
+    settings.beginGroup("downloadmanager");
+    QCOMPARE(settings.value("download_0_etag").toByteArray(), QByteArray("\"abc\""));
+    QCOMPARE(settings.value("download_0_missing").toList(), missing);
+    QCOMPARE(settings.value("resume").toBool(), false);
+}
+
+// A download that was running when we quit but never wrote anything is
+// started again from the beginning into the same file
+void tst_DownloadManager::resumeActive()
+{
+    QString fileName = QDir::tempPath() + "/tst_downloadmanager_active";
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+
+    {
+        QSettings settings;
+        settings.beginGroup("downloadmanager");
+        settings.setValue("alwaysPromptForFileName", true);
+        settings.setValue("download_0_url", QUrl(BIGFILE));
+        settings.setValue("download_0_location", fileName);
+        settings.setValue("download_0_done", false);
+        settings.setValue("download_0_active", true);
+    }
+
+    SubDownloadManager manager;
+    QTableView *view = manager.findChild<QTableView*>();
+    QVERIFY(view);
+    QCOMPARE(view->model()->rowCount(), 1);
+    DownloadItem *item = qobject_cast<DownloadItem*>(view->indexWidget(view->model()->index(0, 0)));
+    QVERIFY(item);
+    // Restarted after the manager is constructed
+    QVERIFY(!item->stopButton->isEnabled());
+    QTest::qWait(50);
+    QVERIFY(item->m_reply);
+    QCOMPARE(item->m_output.fileName(), fileName);
+    QVERIFY(!manager.findChild<QFileDialog*>());
+    QFile::remove(fileName);
+}
+
+void tst_DownloadManager::scheduler()
+{
+    {
+        QSettings settings;
+        settings.beginGroup("downloadmanager");
+        settings.setValue("maximumDownloads", 2);
+        settings.setValue("maximumRate", 100);
+        settings.setValue("download_0_url", QUrl(BIGFILE));
+        settings.setValue("download_0_location", QDir::tempPath() + "/" BIGFILENAME);
+        settings.setValue("download_0_done", false);
+    }
+
+    SubDownloadManager manager;
+    QCOMPARE(manager.maximumDownloads(), 2);
+    QCOMPARE(manager.maximumRate(), qint64(100 * 1024));
+    QCOMPARE(manager.maximumDownloadRate(), qint64(0));
+    QCOMPARE(manager.yieldToPageLoads(), true);
+    manager.setMaximumDownloads(0);
+    QCOMPARE(manager.maximumDownloads(), 0);
+    manager.setMaximumDownloadRate(1024);
+    QCOMPARE(manager.maximumDownloadRate(), qint64(1024));
+    manager.setYieldToPageLoads(false);
+    QCOMPARE(manager.yieldToPageLoads(), false);
+
+    QTableView *view = manager.findChild<QTableView*>();
+    QVERIFY(view);
+    QAbstractItemModel *model = view->model();
+    QCOMPARE(model->rowCount(), 1);
+    QModelIndex index = model->index(0, 0);
+    QCOMPARE(model->data(index, DownloadModel::StateRole).toInt(), int(DownloadItem::Failed));
+    QCOMPARE(model->data(index, DownloadModel::PriorityRole).toInt(), 0);
+    QSignalSpy spy(model, SIGNAL(dataChanged(const QModelIndex &, const QModelIndex &)));
+    QVERIFY(model->setData(index, 5, DownloadModel::PriorityRole));
+    QCOMPARE(model->data(index, DownloadModel::PriorityRole).toInt(), 5);
+    QCOMPARE(spy.count(), 1);
+}
+
+// A server that answers a range request with the whole file
+void tst_DownloadManager::segmentsIgnored()
+{
+    QByteArray body = segmentedBody();
+    RangeServer server(RangeServer::IgnoreRanges, body);
+    QVERIFY(server.isListening());
+
+    SubDownloadManager manager;
+    manager.download(server.url());
+    QTableView *view = manager.findChild<QTableView*>();
+    QVERIFY(view);
+    DownloadItem *item = qobject_cast<DownloadItem*>(view->indexWidget(view->model()->index(0, 0)));
+    QVERIFY(item);
+    waitForDownload(item);
+    QCOMPARE(item->state(), DownloadItem::Finished);
+
+    QFile file(item->m_output.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), body);
+    file.remove();
+}
+
+// A segment that breaks off fails the download but keeps what arrived
+void tst_DownloadManager::segmentFailed()
+{
+    QByteArray body = segmentedBody();
+    RangeServer server(RangeServer::FailRanges, body);
+    QVERIFY(server.isListening());
+
+    QString fileName;
+    {
+        SubDownloadManager manager;
+        manager.download(server.url());
+        QTableView *view = manager.findChild<QTableView*>();
+        QVERIFY(view);
+        DownloadItem *item = qobject_cast<DownloadItem*>(view->indexWidget(view->model()->index(0, 0)));
+        QVERIFY(item);
+        waitForDownload(item);
+        QCOMPARE(item->state(), DownloadItem::Failed);
+        QVERIFY(item->tryAgainButton->isEnabled());
+        fileName = item->m_output.fileName();
+        QVERIFY(QFile::exists(fileName));
+    }
+
+    QSettings settings;
+    settings.beginGroup("downloadmanager");
+    QCOMPARE(settings.value("download_0_location").toString(), fileName);
+    QVERIFY(!settings.value("download_0_missing").toList().isEmpty());
+    QFile::remove(fileName);
+}
+
 QTEST_MAIN(tst_DownloadManager)
 #include "tst_downloadmanager.moc"
 
@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QtTest/QtTest>
+#include "qtest_arora.h"
+
+#include <downloadwriter.h>
+
+class tst_DownloadWriter : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void downloadwriter_data();
+    void downloadwriter();
+    void write_data();
+    void write();
+    void backpressure();
+    void flushedPosition();
+    void preallocate_data();
+    void preallocate();
+    void error();
+
+private:
+    QString m_fileName;
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_DownloadWriter::initTestCase()
+{
+    m_fileName = QDir::tempPath() + QLatin1String("/tst_downloadwriter");
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_DownloadWriter::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_DownloadWriter::init()
+{
+    QFile::remove(m_fileName);
+}
+
+// This will be called after every test function.
+void tst_DownloadWriter::cleanup()
+{
+    QFile::remove(m_fileName);
+}
+
+void tst_DownloadWriter::downloadwriter_data()
+{
+}
+
+void tst_DownloadWriter::downloadwriter()
+{
+    DownloadWriter writer;
+    QVERIFY(!writer.isFull());
+    QCOMPARE(writer.queuedSize(), qint64(0));
+    writer.setMaximumQueueSize(1024);
+    QCOMPARE(writer.maximumQueueSize(), qint64(1024));
+    writer.close();
+}
+
+void tst_DownloadWriter::write_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::addColumn<int>("streams");
+    QTest::newRow("small") << 100 << 1;
+    QTest::newRow("unaligned") << 10000 << 1;
+    QTest::newRow("large") << 200 * 1024 << 1;
+    QTest::newRow("ranges") << 10000 << 4;
+}
+
+// Interleaved writes to separate ranges end up in the right place
+void tst_DownloadWriter::write()
+{
+    QFETCH(int, chunkSize);
+    QFETCH(int, streams);
+
+    QByteArray expected;
+    for (int i = 0; i < 50 * streams; ++i)
+        expected += QByteArray(chunkSize, 'a' + i % 26);
+    qint64 rangeSize = expected.size() / streams;
+
+    DownloadWriter writer;
+    QSignalSpy spy(&writer, SIGNAL(bytesWritten(qint64)));
+    QVERIFY(writer.open(m_fileName, QIODevice::WriteOnly));
+    for (qint64 position = 0; position < rangeSize; position += chunkSize) {
+        for (int stream = 0; stream < streams; ++stream) {
+            qint64 offset = stream * rangeSize + position;
+            writer.write(offset, expected.mid(offset, chunkSize));
+        }
+    }
+    writer.close();
+    QCOMPARE(writer.queuedSize(), qint64(0));
+    QVERIFY(writer.errorString().isEmpty());
+
+    QFile file(m_fileName);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QCOMPARE(file.readAll(), expected);
+    QTRY_VERIFY(spy.count() > 0);
+}
+
+void tst_DownloadWriter::backpressure()
+{
+    DownloadWriter writer;
+    writer.setMaximumQueueSize(1024);
+    // Nothing drains the queue until the writer is opened
+    writer.write(0, QByteArray(512, 'a'));
+    QVERIFY(!writer.isFull());
+    writer.write(512, QByteArray(512, 'b'));
+    QVERIFY(writer.isFull());
+    QCOMPARE(writer.queuedSize(), qint64(1024));
+
+    QVERIFY(writer.open(m_fileName, QIODevice::WriteOnly));
+    QTRY_VERIFY(!writer.isFull());
+    writer.close();
+    QCOMPARE(QFileInfo(m_fileName).size(), qint64(1024));
+}
+
+void tst_DownloadWriter::flushedPosition()
+{
+    DownloadWriter writer;
+    writer.write(100, QByteArray(100, 'a'));
+    writer.write(200, QByteArray(100, 'b'));
+    writer.write(1000, QByteArray(100, 'c'));
+    QCOMPARE(writer.flushedPosition(300), qint64(100));
+    QCOMPARE(writer.flushedPosition(1100), qint64(1000));
+    QCOMPARE(writer.flushedPosition(50), qint64(50));
+
+    QVERIFY(writer.open(m_fileName, QIODevice::WriteOnly));
+    writer.close();
+    QCOMPARE(writer.flushedPosition(300), qint64(300));
+}
+
+void tst_DownloadWriter::preallocate_data()
+{
+    QTest::addColumn<bool>("keepSize");
+    QTest::newRow("grow") << false;
+    QTest::newRow("keep size") << true;
+}
+
+void tst_DownloadWriter::preallocate()
+{
+    QFETCH(bool, keepSize);
+
+    DownloadWriter writer;
+    QVERIFY(writer.open(m_fileName, QIODevice::WriteOnly));
+    writer.preallocate(1024 * 1024, keepSize);
+    writer.write(0, QByteArray(100, 'a'));
+    writer.close();
+    QVERIFY(writer.errorString().isEmpty());
+    QCOMPARE(QFileInfo(m_fileName).size(), keepSize ? qint64(100) : qint64(1024 * 1024));
+}
+
+void tst_DownloadWriter::error()
+{
+    DownloadWriter writer;
+    QVERIFY(!writer.open(QDir::tempPath() + QLatin1String("/tst_downloadwriter_dne/file"), QIODevice::WriteOnly));
+    QVERIFY(!writer.errorString().isEmpty());
+}
+
+QTEST_MAIN(tst_DownloadWriter)
+#include "tst_downloadwriter.moc"
+
@@ -0,0 +1,411 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QtTest/QtTest>
+#include "qtest_arora.h"
+
+#include <networkcachestore.h>
+
+class tst_NetworkCacheStore : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void networkcachestore_data();
+    void networkcachestore();
+    void insert_data();
+    void insert();
+    void updateMetaData();
+    void remove();
+    void reopen();
+    void rebuildIndex();
+    void expire();
+    void compact();
+    void backgroundCompaction();
+    void compress_data();
+    void compress();
+    void hits();
+    void clear();
+
+private:
+    QNetworkCacheMetaData metaData(const QString &url) const;
+    QString m_directory;
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_NetworkCacheStore::initTestCase()
+{
+    m_directory = QDir::tempPath() + QLatin1String("/tst_networkcachestore");
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_NetworkCacheStore::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_NetworkCacheStore::init()
+{
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    store.clear();
+}
+
+// This will be called after every test function.
+void tst_NetworkCacheStore::cleanup()
+{
+    init();
+}
+
+QNetworkCacheMetaData tst_NetworkCacheStore::metaData(const QString &url) const
+{
+    QNetworkCacheMetaData metaData;
+    metaData.setUrl(QUrl(url));
+    metaData.setSaveToDisk(true);
+    QNetworkCacheMetaData::RawHeaderList headers;
+    headers.append(qMakePair(QByteArray("Content-Type"), QByteArray("text/html")));
+    metaData.setRawHeaders(headers);
+    return metaData;
+}
+
+void tst_NetworkCacheStore::networkcachestore_data()
+{
+}
+
+void tst_NetworkCacheStore::networkcachestore()
+{
+    NetworkCacheStore store;
+    QVERIFY(store.shardCount() > 0);
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.size(), qint64(0));
+    QVERIFY(!store.metaData(QUrl("http://foo.com/")).isValid());
+    QVERIFY(store.data(QUrl("http://foo.com/")).isNull());
+    QVERIFY(!store.insert(metaData("http://foo.com/"), "foo"));
+    QVERIFY(!store.remove(QUrl("http://foo.com/")));
+    QVERIFY(store.saveIndex());
+    store.expire();
+    store.clear();
+}
+
+void tst_NetworkCacheStore::insert_data()
+{
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QString("http://foo.com/empty") << QByteArray();
+    QTest::newRow("small") << QString("http://foo.com/") << QByteArray("<html></html>");
+    QTest::newRow("large") << QString("http://foo.com/large") << QByteArray(1024 * 1024, 'x');
+}
+
+void tst_NetworkCacheStore::insert()
+{
+    QFETCH(QString, url);
+    QFETCH(QByteArray, data);
+
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData(url), data));
+    QCOMPARE(store.count(), 1);
+    QVERIFY(store.contains(QUrl(url)));
+    QCOMPARE(store.metaData(QUrl(url)).url(), QUrl(url));
+    QCOMPARE(store.metaData(QUrl(url)).rawHeaders(), metaData(url).rawHeaders());
+    QCOMPARE(store.data(QUrl(url)), data);
+    QCOMPARE(store.entry(QUrl(url)).bodySize, qint64(data.size()));
+    QVERIFY(store.size() > data.size());
+    QCOMPARE(store.liveSize(), store.size() - 8 * store.shardCount());
+
+    // Replacing an entry leaves the old one behind until compacted
+    QVERIFY(store.insert(metaData(url), "new"));
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.data(QUrl(url)), QByteArray("new"));
+    int shard = store.entry(QUrl(url)).shard;
+    QVERIFY(store.deadSize(shard) > data.size());
+
+    // A body in a file is copied over as it is
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(data), qint64(data.size()));
+    QVERIFY(store.insert(metaData(url), &file));
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.data(QUrl(url)), data);
+    QCOMPARE(store.entry(QUrl(url)).bodySize, qint64(data.size()));
+    QVERIFY(!store.entry(QUrl(url)).compressed);
+}
+
+void tst_NetworkCacheStore::updateMetaData()
+{
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    QVERIFY(!store.updateMetaData(metaData("http://foo.com/")));
+    QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+
+    QNetworkCacheMetaData updated = metaData("http://foo.com/");
+    QDateTime expires = QDateTime(QDate(2020, 1, 1), QTime(0, 0));
+    updated.setExpirationDate(expires);
+    QVERIFY(store.updateMetaData(updated));
+    QCOMPARE(store.metaData(QUrl("http://foo.com/")).expirationDate(), expires);
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).expires, expires.toTime_t());
+    QCOMPARE(store.data(QUrl("http://foo.com/")), QByteArray("foo"));
+}
+
+void tst_NetworkCacheStore::remove()
+{
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+    QVERIFY(store.insert(metaData("http://bar.com/"), "bar"));
+    QVERIFY(store.remove(QUrl("http://foo.com/")));
+    QVERIFY(!store.remove(QUrl("http://foo.com/")));
+    QCOMPARE(store.count(), 1);
+    QVERIFY(!store.contains(QUrl("http://foo.com/")));
+    QCOMPARE(store.data(QUrl("http://bar.com/")), QByteArray("bar"));
+}
+
+void tst_NetworkCacheStore::reopen()
+{
+    {
+        NetworkCacheStore store;
+        store.setDirectory(m_directory);
+        QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+        QVERIFY(store.insert(metaData("http://bar.com/"), "bar"));
+        QVERIFY(store.saveIndex());
+        QFile::remove(store.indexFileName() + QLatin1String(".saved"));
+        QVERIFY(QFile::copy(store.indexFileName(), store.indexFileName() + QLatin1String(".saved")));
+        // Appended after the index was saved
+        QVERIFY(store.insert(metaData("http://baz.com/"), "baz"));
+        QVERIFY(store.remove(QUrl("http://bar.com/")));
+    }
+
+    // Go back to the older index as if the browser had crashed
+    QString indexFileName = m_directory + QLatin1String("/index.dat");
+    QVERIFY(QFile::remove(indexFileName));
+    QVERIFY(QFile::rename(indexFileName + QLatin1String(".saved"), indexFileName));
+
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.data(QUrl("http://foo.com/")), QByteArray("foo"));
+    QCOMPARE(store.data(QUrl("http://baz.com/")), QByteArray("baz"));
+    QVERIFY(!store.contains(QUrl("http://bar.com/")));
+}
+
+void tst_NetworkCacheStore::rebuildIndex()
+{
+    qint64 size;
+    {
+        NetworkCacheStore store;
+        store.setDirectory(m_directory);
+        QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+        QVERIFY(store.insert(metaData("http://bar.com/"), "bar"));
+        QVERIFY(store.insert(metaData("http://foo.com/"), "foo2"));
+        QVERIFY(store.remove(QUrl("http://bar.com/")));
+        size = store.size();
+    }
+    QVERIFY(QFile::remove(m_directory + QLatin1String("/index.dat")));
+
+    // A record that was only partly written is dropped
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    int shard = store.entry(QUrl("http://foo.com/")).shard;
+    QFile file(store.shardFileName(shard));
+    QVERIFY(file.open(QFile::Append));
+    file.write("garbage");
+    file.close();
+
+    store.setDirectory(QString());
+    store.setDirectory(m_directory);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.data(QUrl("http://foo.com/")), QByteArray("foo2"));
+    QCOMPARE(store.size(), size);
+}
+
+void tst_NetworkCacheStore::expire()
+{
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    store.setMaximumSize(100 * 1024);
+    QByteArray data(10 * 1024, 'x');
+    for (int i = 0; i < 20; ++i) {
+        QVERIFY(store.insert(metaData(QString("http://foo.com/%1").arg(i)), data));
+        // Keep the first entry in use
+        QVERIFY(!store.data(QUrl("http://foo.com/0")).isEmpty());
+    }
+    QVERIFY(store.liveSize() <= store.maximumSize());
+    store.waitForCompaction();
+    QVERIFY(!store.isCompacting());
+    QVERIFY(store.size() <= store.maximumSize());
+    QVERIFY(store.count() < 20);
+    QVERIFY(store.contains(QUrl("http://foo.com/0")));
+    QVERIFY(store.contains(QUrl("http://foo.com/19")));
+    QVERIFY(!store.contains(QUrl("http://foo.com/1")));
+}
+
+void tst_NetworkCacheStore::compact()
+{
+    NetworkCacheStore store(1);
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData("http://foo.com/"), QByteArray(1024, 'a')));
+    QVERIFY(store.insert(metaData("http://bar.com/"), QByteArray(1024, 'b')));
+    QVERIFY(store.remove(QUrl("http://foo.com/")));
+    qint64 size = store.size();
+    QVERIFY(store.deadSize(0) > 1024);
+
+    QVERIFY(store.compact(0));
+    QVERIFY(store.size() < size - 1024);
+    QCOMPARE(store.deadSize(0), qint64(0));
+    QCOMPARE(store.data(QUrl("http://bar.com/")), QByteArray(1024, 'b'));
+
+    store.setDirectory(QString());
+    store.setDirectory(m_directory);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.data(QUrl("http://bar.com/")), QByteArray(1024, 'b'));
+}
+
+void tst_NetworkCacheStore::backgroundCompaction()
+{
+    NetworkCacheStore store(1);
+    store.setDirectory(m_directory);
+    store.setMaximumSize(64 * 1024);
+    QByteArray data(8 * 1024, 'x');
+    for (int i = 0; i < 8; ++i)
+        QVERIFY(store.insert(metaData(QString("http://foo.com/%1").arg(i)), data));
+    QVERIFY(store.isCompacting());
+
+    // Written while the shard is being compacted
+    QVERIFY(store.insert(metaData("http://bar.com/"), "bar"));
+    QNetworkCacheMetaData updated = metaData("http://foo.com/7");
+    updated.setExpirationDate(QDateTime(QDate(2020, 1, 1), QTime(0, 0)));
+    QVERIFY(store.updateMetaData(updated));
+    QVERIFY(store.remove(QUrl("http://foo.com/6")));
+
+    store.waitForCompaction();
+    QVERIFY(!store.isCompacting());
+    QVERIFY(store.size() <= store.maximumSize());
+    QCOMPARE(store.data(QUrl("http://bar.com/")), QByteArray("bar"));
+    QCOMPARE(store.data(QUrl("http://foo.com/7")), data);
+    QCOMPARE(store.metaData(QUrl("http://foo.com/7")).expirationDate(), updated.expirationDate());
+    QVERIFY(!store.contains(QUrl("http://foo.com/6")));
+
+    int count = store.count();
+    store.setDirectory(QString());
+    store.setDirectory(m_directory);
+    QCOMPARE(store.count(), count);
+    QCOMPARE(store.data(QUrl("http://bar.com/")), QByteArray("bar"));
+    QCOMPARE(store.data(QUrl("http://foo.com/7")), data);
+}
+
+void tst_NetworkCacheStore::compress_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("compress");
+    QTest::addColumn<bool>("compressed");
+
+    QByteArray html;
+    for (int i = 0; i < 100; ++i)
+        html += "<div class=\"item\"><a href=\"http://foo.com/\">foo</a></div>\n";
+    QByteArray random;
+    qsrand(1);
+    for (int i = 0; i < 4096; ++i)
+        random += char(qrand());
+
+    QTest::newRow("html") << html << true << true;
+    QTest::newRow("html not compressed") << html << false << false;
+    QTest::newRow("random") << random << true << false;
+    QTest::newRow("empty") << QByteArray() << true << false;
+}
+
+void tst_NetworkCacheStore::compress()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, compress);
+    QFETCH(bool, compressed);
+
+    NetworkCacheStore store(1);
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData("http://foo.com/"), data, compress));
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).compressed, compressed);
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).bodySize < data.size(), compressed);
+    QCOMPARE(store.data(QUrl("http://foo.com/")), data);
+
+    // The compressed body survives compaction and reopening
+    QVERIFY(store.insert(metaData("http://bar.com/"), "bar"));
+    QVERIFY(store.remove(QUrl("http://bar.com/")));
+    QVERIFY(store.compact(0));
+    store.setDirectory(QString());
+    store.setDirectory(m_directory);
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).compressed, compressed);
+    QCOMPARE(store.data(QUrl("http://foo.com/")), data);
+}
+
+void tst_NetworkCacheStore::hits()
+{
+    NetworkCacheStore store(1);
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).hits, quint32(0));
+    QCOMPARE(store.data(QUrl("http://foo.com/")), QByteArray("foo"));
+    store.recordHit(QUrl("http://foo.com/"));
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).hits, quint32(2));
+
+    // Reading the entry directly does not count
+    QFile shard(store.shardFileName(0));
+    QVERIFY(shard.open(QFile::ReadOnly));
+    QNetworkCacheMetaData entryMetaData;
+    QByteArray data;
+    QVERIFY(NetworkCacheStore::readEntry(&shard, store.entry(QUrl("http://foo.com/")), &entryMetaData, &data));
+    QCOMPARE(entryMetaData.url(), QUrl("http://foo.com/"));
+    QCOMPARE(data, QByteArray("foo"));
+
+    store.setDirectory(QString());
+    store.setDirectory(m_directory);
+    QCOMPARE(store.entry(QUrl("http://foo.com/")).hits, quint32(2));
+}
+
+void tst_NetworkCacheStore::clear()
+{
+    NetworkCacheStore store;
+    store.setDirectory(m_directory);
+    QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+    store.clear();
+    QCOMPARE(store.count(), 0);
+    QVERIFY(!QFile::exists(store.indexFileName()));
+    QVERIFY(store.insert(metaData("http://foo.com/"), "foo"));
+    QCOMPARE(store.count(), 1);
+}
+
+QTEST_MAIN(tst_NetworkCacheStore)
+#include "tst_networkcachestore.moc"
+
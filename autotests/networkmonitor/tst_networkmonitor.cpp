@@ -0,0 +1,277 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QtTest/QtTest>
+#include "qtest_arora.h"
+
+#include <networkmonitor.h>
+#include <webpageproxy.h>
+
+#include <qnetworkreply.h>
+
+class tst_NetworkMonitor : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void networkmonitor_data();
+    void networkmonitor();
+    void monitor_data();
+    void monitor();
+    void capacity();
+    void clear();
+    void pageDestroyed();
+    void toJson();
+};
+
+// Reply whose progress is driven by the test.
+class FakeReply : public QNetworkReply
+{
+    Q_OBJECT
+
+public:
+    FakeReply(const QUrl &url, void *page = 0)
+    {
+        QNetworkRequest request(url);
+        if (page)
+            request.setAttribute((QNetworkRequest::Attribute)(WebPageProxy::pageAttributeId()),
+                                 qVariantFromValue(page));
+        setRequest(request);
+        setUrl(url);
+        open(QIODevice::ReadOnly);
+    }
+
+    void abort() {}
+
+    void respond(qint64 size, bool fromCache = false, const QString &error = QString())
+    {
+        setAttribute(QNetworkRequest::SourceIsFromCacheAttribute, fromCache);
+        if (!error.isEmpty())
+            setError(QNetworkReply::ContentAccessDenied, error);
+        emit metaDataChanged();
+        if (size > 0)
+            emit downloadProgress(size, size);
+        emit finished();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_NetworkMonitor::initTestCase()
+{
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_NetworkMonitor::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_NetworkMonitor::init()
+{
+}
+
+// This will be called after every test function.
+void tst_NetworkMonitor::cleanup()
+{
+}
+
+void tst_NetworkMonitor::networkmonitor_data()
+{
+}
+
+void tst_NetworkMonitor::networkmonitor()
+{
+    NetworkMonitor monitor;
+    QVERIFY(monitor.capacity() > 0);
+    QVERIFY(monitor.requests().isEmpty());
+    QVERIFY(monitor.hostTotals().isEmpty());
+    QVERIFY(monitor.pageTotals().isEmpty());
+    monitor.monitor(0);
+    monitor.clear();
+    QVERIFY(!monitor.toJson().isEmpty());
+}
+
+void tst_NetworkMonitor::monitor_data()
+{
+    QTest::addColumn<QString>("handler");
+    QTest::addColumn<qint64>("size");
+    QTest::addColumn<bool>("fromCache");
+    QTest::addColumn<QString>("error");
+    QTest::addColumn<int>("cacheHits");
+    QTest::addColumn<int>("blocked");
+    QTest::addColumn<int>("errors");
+
+    QTest::newRow("network") << QString() << qint64(100) << false << QString() << 0 << 0 << 0;
+    QTest::newRow("cache") << QString() << qint64(100) << true << QString() << 1 << 0 << 0;
+    QTest::newRow("error") << QString() << qint64(0) << false << QString("error") << 0 << 0 << 1;
+    QTest::newRow("adblock") << QString("adblock") << qint64(0) << false
+        << QString("Blocked by AdBlockRule: ads") << 0 << 1 << 0;
+    QTest::newRow("scheme") << QString("file") << qint64(10) << false << QString() << 0 << 0 << 0;
+}
+
+void tst_NetworkMonitor::monitor()
+{
+    QFETCH(QString, handler);
+    QFETCH(qint64, size);
+    QFETCH(bool, fromCache);
+    QFETCH(QString, error);
+    QFETCH(int, cacheHits);
+    QFETCH(int, blocked);
+    QFETCH(int, errors);
+
+    NetworkMonitor monitor;
+    QSignalSpy spy(&monitor, SIGNAL(requestFinished()));
+    WebPageProxy page;
+    FakeReply reply(QUrl("http://www.example.com/index.html"), &page);
+    monitor.monitor(&reply, handler);
+    QCOMPARE(spy.count(), 0);
+    reply.respond(size, fromCache, error);
+    QCOMPARE(spy.count(), 1);
+
+    QList<NetworkMonitor::Request> requests = monitor.requests();
+    QCOMPARE(requests.count(), 1);
+    NetworkMonitor::Request request = requests.first();
+    QCOMPARE(request.url, QUrl("http://www.example.com/index.html"));
+    QCOMPARE(request.host, QString("www.example.com"));
+    QCOMPARE(request.page, quintptr(&page));
+    QCOMPARE(request.handler, handler);
+    QCOMPARE(request.error, error);
+    QCOMPARE(request.fromCache, fromCache);
+    QCOMPARE(request.size, size);
+    QVERIFY(request.headers >= 0);
+    QCOMPARE(request.firstByte >= 0, size > 0);
+    QVERIFY(request.finished >= 0);
+
+    NetworkMonitor::Totals host = monitor.hostTotals().value("www.example.com");
+    QCOMPARE(host.requests, 1);
+    QCOMPARE(host.cacheHits, cacheHits);
+    QCOMPARE(host.blocked, blocked);
+    QCOMPARE(host.errors, errors);
+    QCOMPARE(host.bytes, size);
+
+    NetworkMonitor::Totals pageTotals = monitor.pageTotals().value(quintptr(&page));
+    QCOMPARE(pageTotals.requests, 1);
+    QCOMPARE(pageTotals.bytes, size);
+}
+
+void tst_NetworkMonitor::capacity()
+{
+    NetworkMonitor monitor;
+    int count = monitor.capacity() + 10;
+    for (int i = 0; i < count; ++i) {
+        FakeReply reply(QUrl(QString("http://host%1.com/").arg(i)));
+        monitor.monitor(&reply);
+        reply.respond(1);
+    }
+    QList<NetworkMonitor::Request> requests = monitor.requests();
+    QCOMPARE(requests.count(), monitor.capacity());
+    QCOMPARE(requests.first().host, QString("host10.com"));
+    QCOMPARE(requests.last().host, QString("host%1.com").arg(count - 1));
+    QCOMPARE(monitor.hostTotals().count(), count);
+}
+
+void tst_NetworkMonitor::clear()
+{
+    NetworkMonitor monitor;
+    FakeReply reply(QUrl("http://www.example.com/"));
+    monitor.monitor(&reply);
+    reply.respond(1);
+    QCOMPARE(monitor.requests().count(), 1);
+    monitor.clear();
+    QVERIFY(monitor.requests().isEmpty());
+    QVERIFY(monitor.hostTotals().isEmpty());
+    QVERIFY(monitor.pageTotals().isEmpty());
+
+    // A reply destroyed before it finished is forgotten
+    FakeReply *pending = new FakeReply(QUrl("http://www.example.com/"));
+    monitor.monitor(pending);
+    delete pending;
+    QVERIFY(monitor.requests().isEmpty());
+}
+
+// The totals of a page go away with the page
+void tst_NetworkMonitor::pageDestroyed()
+{
+    NetworkMonitor monitor;
+    WebPageProxy *page = new WebPageProxy;
+    FakeReply reply(QUrl("http://www.example.com/"), page);
+    monitor.monitor(&reply);
+    reply.respond(1);
+    QCOMPARE(monitor.pageTotals().count(), 1);
+
+    FakeReply pending(QUrl("http://www.example.com/"), page);
+    monitor.monitor(&pending);
+    delete page;
+    QVERIFY(monitor.pageTotals().isEmpty());
+    pending.respond(1);
+    QVERIFY(monitor.pageTotals().isEmpty());
+    QCOMPARE(monitor.requests().count(), 2);
+    QCOMPARE(monitor.hostTotals().value("www.example.com").requests, 2);
+}
+
+void tst_NetworkMonitor::toJson()
+{
+    NetworkMonitor monitor;
+    FakeReply reply(QUrl("http://www.example.com/"));
+    monitor.monitor(&reply, QLatin1String("adblock"));
+    reply.respond(0, false, QLatin1String("Blocked by \"rule\"\n"));
+    QByteArray json = monitor.toJson();
+    QVERIFY(json.contains("\"host\": \"www.example.com\""));
+    QVERIFY(json.contains("\"handler\": \"adblock\""));
+    QVERIFY(json.contains("\"error\": \"Blocked by \\\"rule\\\"\\n\""));
+    QVERIFY(json.contains("\"blocked\": 1"));
+
+    // Percent encoding in the url and the error is written as it is
+    monitor.clear();
+    FakeReply encoded(QUrl::fromEncoded("http://www.example.com/?q=a%3Db%2Fc"));
+    monitor.monitor(&encoded);
+    encoded.respond(0, false, QLatin1String("Error %1 %2"));
+    json = monitor.toJson();
+    QVERIFY(json.contains("\"url\": \"http://www.example.com/?q=a%3Db%2Fc\", \"host\": \"www.example.com\""));
+    QVERIFY(json.contains("\"error\": \"Error %1 %2\", \"fromCache\": false"));
+}
+
+QTEST_MAIN(tst_NetworkMonitor)
+#include "tst_networkmonitor.moc"
+
@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <QtTest/QtTest>
+#include "qtest_arora.h"
+
+#include <sessionjournal.h>
+
+class tst_SessionJournal : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void sessionjournal_data();
+    void sessionjournal();
+    void replay();
+    void truncated_data();
+    void truncated();
+    void compact();
+    void compactFirstSave();
+    void interruptedCompact();
+
+private:
+    void writeSession(SessionJournal &journal);
+    void verifySession(const SessionJournal &journal);
+
+    QString m_fileName;
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_SessionJournal::initTestCase()
+{
+    m_fileName = QDir::tempPath() + QLatin1String("/tst_sessionjournal");
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_SessionJournal::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_SessionJournal::init()
+{
+    QFile::remove(m_fileName);
+    QFile::remove(m_fileName + QLatin1String(".new"));
+}
+
+// This will be called after every test function.
+void tst_SessionJournal::cleanup()
+{
+    init();
+}
+
+void tst_SessionJournal::writeSession(SessionJournal &journal)
+{
+    journal.setWindows(QList<quint32>() << 1 << 2);
+    journal.setWindowState(1, "one");
+    journal.setWindowState(2, "two");
+    journal.setTab(10, QUrl("http://a/"), "historyA");
+    journal.setTab(11, QUrl("http://b/"), "historyB");
+    journal.setTab(12, QUrl("http://c/"), "historyC");
+    journal.setTabs(1, QList<quint32>() << 10 << 11, 1);
+    journal.setTabs(2, QList<quint32>() << 12, 0);
+
+    // A navigation, a closed tab and a closed window
+    journal.setTab(10, QUrl("http://a/next"), "historyA2", "Next");
+    journal.setTabs(1, QList<quint32>() << 10, 0);
+    journal.setWindows(QList<quint32>() << 1);
+}
+
+void tst_SessionJournal::verifySession(const SessionJournal &journal)
+{
+    QCOMPARE(journal.windows(), QList<quint32>() << 1);
+    SessionJournal::Window window = journal.window(1);
+    QCOMPARE(window.state, QByteArray("one"));
+    QCOMPARE(window.tabs, QList<quint32>() << 10);
+    QCOMPARE(window.currentTab, 0);
+    QCOMPARE(journal.tab(10).url, QUrl("http://a/next"));
+    QCOMPARE(journal.tab(10).history, QByteArray("historyA2"));
+    QCOMPARE(journal.tab(10).title, QString("Next"));
+    QVERIFY(journal.window(2).tabs.isEmpty());
+    // The closed tabs are not kept around
+    QVERIFY(journal.tab(11).url.isEmpty());
+    QVERIFY(journal.tab(12).url.isEmpty());
+}
+
+void tst_SessionJournal::sessionjournal_data()
+{
+}
+
+void tst_SessionJournal::sessionjournal()
+{
+    SessionJournal journal;
+    QVERIFY(!journal.isOpen());
+    QVERIFY(!journal.read(m_fileName));
+    QVERIFY(journal.windows().isEmpty());
+    QVERIFY(journal.tab(1).url.isEmpty());
+
+    // Changes are kept in memory without a file
+    journal.setTab(1, QUrl("http://a/"), QByteArray());
+    QCOMPARE(journal.tab(1).url, QUrl("http://a/"));
+    QVERIFY(!QFile::exists(m_fileName));
+}
+
+void tst_SessionJournal::replay()
+{
+    {
+        SessionJournal journal;
+        QVERIFY(journal.open(m_fileName));
+        QVERIFY(journal.isOpen());
+        writeSession(journal);
+        verifySession(journal);
+    }
+    QVERIFY(QFile::exists(m_fileName));
+
+    SessionJournal journal;
+    QVERIFY(journal.read(m_fileName));
+    verifySession(journal);
+
+    // Opening starts over
+    journal.open(m_fileName);
+    QVERIFY(journal.windows().isEmpty());
+    journal.close();
+    QVERIFY(journal.read(m_fileName));
+    QVERIFY(journal.windows().isEmpty());
+}
+
+void tst_SessionJournal::truncated_data()
+{
+    QTest::addColumn<int>("cut");
+    QTest::newRow("end of record") << 3;
+    QTest::newRow("middle of record") << 20;
+}
+
+// A record that was only partly written is left out
+void tst_SessionJournal::truncated()
+{
+    QFETCH(int, cut);
+    {
+        SessionJournal journal;
+        journal.open(m_fileName);
+        writeSession(journal);
+        journal.setTab(10, QUrl("http://a/lost"), "historyA3");
+    }
+    QFile file(m_fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - cut));
+    file.close();
+
+    SessionJournal journal;
+    QVERIFY(journal.read(m_fileName));
+    verifySession(journal);
+
+    // Garbage at the end is ignored as well
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray(100, 'x'));
+    file.close();
+    QVERIFY(journal.read(m_fileName));
+    verifySession(journal);
+}
+
+// Repeated changes don't make the journal grow without bounds
+void tst_SessionJournal::compact()
+{
+    QByteArray history(10 * 1024, 'h');
+    {
+        SessionJournal journal;
+        journal.open(m_fileName);
+        writeSession(journal);
+        for (int i = 0; i < 1000; ++i) {
+            journal.setTab(10, QUrl(QString("http://a/%1").arg(i)), history);
+            journal.commit();
+        }
+    }
+    QVERIFY(QFileInfo(m_fileName).size() < 200 * 1024);
+    QVERIFY(!QFile::exists(m_fileName + QLatin1String(".new")));
+
+    SessionJournal journal;
+    QVERIFY(journal.read(m_fileName));
+    QCOMPARE(journal.windows(), QList<quint32>() << 1);
+    QCOMPARE(journal.tab(10).url, QUrl("http://a/999"));
+    QCOMPARE(journal.tab(10).history, history);
+    // Closed tabs are dropped
+    QVERIFY(journal.tab(11).url.isEmpty());
+}
+
+// A save that is big enough to be compacted keeps all of its records
+void tst_SessionJournal::compactFirstSave()
+{
+    QByteArray history(10 * 1024, 'h');
+    QList<quint32> tabs;
+    {
+        SessionJournal journal;
+        journal.open(m_fileName);
+        // In the order BrowserApplication::saveSession() writes them
+        journal.setWindowState(1, "one");
+        for (quint32 i = 1; i <= 20; ++i) {
+            journal.setTab(i, QUrl(QString("http://a/%1").arg(i)), history);
+            tabs.append(i);
+        }
+        journal.setTabs(1, tabs, 3);
+        journal.setWindows(QList<quint32>() << 1);
+        journal.commit();
+    }
+    QVERIFY(!QFile::exists(m_fileName + QLatin1String(".new")));
+
+    SessionJournal journal;
+    QVERIFY(journal.read(m_fileName));
+    QCOMPARE(journal.windows(), QList<quint32>() << 1);
+    QCOMPARE(journal.window(1).state, QByteArray("one"));
+    QCOMPARE(journal.window(1).tabs, tabs);
+    QCOMPARE(journal.window(1).currentTab, 3);
+    foreach (quint32 tab, tabs) {
+        QCOMPARE(journal.tab(tab).url, QUrl(QString("http://a/%1").arg(tab)));
+        QCOMPARE(journal.tab(tab).history, history);
+    }
+}
+
+// The new journal is used when the old one was already removed
+void tst_SessionJournal::interruptedCompact()
+{
+    {
+        SessionJournal journal;
+        journal.open(m_fileName);
+        writeSession(journal);
+    }
+    QVERIFY(QFile::rename(m_fileName, m_fileName + QLatin1String(".new")));
+
+    SessionJournal journal;
+    QVERIFY(journal.read(m_fileName));
+    verifySession(journal);
+}
+
+QTEST_MAIN(tst_SessionJournal)
+#include "tst_sessionjournal.moc"
+
@@ -22,8 +22,11 @@
 #include "qtest_arora.h"
 
 #include <tabwidget.h>
+#include <webpage.h>
 #include <webview.h>
 
+#include <qwebframe.h>
+
 class tst_TabWidget : public QObject
 {
     Q_OBJECT
@@ -69,6 +72,12 @@ private slots:
     void tabsChanged();
 
     void saveState();
+    void hibernateTab();
+    void urlsFromState();
+    void stateFromTabs();
+    void webViewIndex();
+    void updateTabs();
+    void backgroundTabs();
 };
 
 // Subclass that exposes the protected functions.
@@ -89,6 +98,9 @@ public:
 
     void call_tabsChanged()
         { return SubTabWidget::tabsChanged(); }
+
+    QTabBar *call_tabBar() const
+        { return SubTabWidget::tabBar(); }
 };
 
 // This will be called before the first test function is executed.
@@ -684,6 +696,44 @@ void tst_TabWidget::saveState()
     QCOMPARE(widget.count(), 2);
     QVERIFY(widget.webView(0));
     QCOMPARE(widget.webView(0)->url(), url);
+
+    // Tabs that are not current are only loaded when they are shown
+    QVERIFY(widget.isPendingTab(1));
+    QVERIFY(!widget.webView(1));
+    QCOMPARE(TabWidget::urlsFromState(widget.saveState()).value(1), url);
+    widget.setCurrentIndex(1);
+    QVERIFY(!widget.isPendingTab(1));
+    QVERIFY(widget.webView(1));
+    QCOMPARE(widget.webView(1)->url(), url);
+
+    widget.closeTab();
+    widget.closeTab();
+}
+
+void tst_TabWidget::hibernateTab()
+{
+    SubTabWidget widget;
+    widget.newTab();
+
+    QUrl url = QUrl("data:text/html;base32,Hello%20World");
+    widget.loadUrl(url, TabWidget::CurrentTab);
+    widget.loadUrl(url, TabWidget::NewTab);
+    QCOMPARE(widget.count(), 2);
+    QCOMPARE(widget.currentIndex(), 0);
+
+    // The current tab stays
+    QVERIFY(!widget.hibernateTab(0));
+    QVERIFY(widget.webView(0));
+
+    QVERIFY(widget.hibernateTab(1));
+    QCOMPARE(widget.count(), 2);
+    QVERIFY(widget.isPendingTab(1));
+    QVERIFY(!widget.webView(1));
+    QVERIFY(!widget.hibernateTab(1));
+    QCOMPARE(TabWidget::urlsFromState(widget.saveState()).value(1), url);
+
+    // and is loaded again when shown
+    widget.setCurrentIndex(1);
     QVERIFY(widget.webView(1));
     QCOMPARE(widget.webView(1)->url(), url);
 
@@ -691,6 +741,170 @@ void tst_TabWidget::saveState()
     widget.closeTab();
 }
 
+void tst_TabWidget::urlsFromState()
+{
+    SubTabWidget widget;
+    widget.newTab();
+
+    QUrl url = QUrl("data:text/html;base32,Hello%20World");
+    widget.loadUrl(url, TabWidget::CurrentTab);
+    widget.loadUrl(url, TabWidget::NewTab);
+    QCOMPARE(widget.count(), 2);
+
+    QList<QUrl> urls = TabWidget::urlsFromState(widget.saveState());
+    QCOMPARE(urls.count(), 2);
+    QCOMPARE(urls.at(0), url);
+    QCOMPARE(urls.at(1), url);
+
+    QVERIFY(TabWidget::urlsFromState(QByteArray()).isEmpty());
+    QVERIFY(TabWidget::urlsFromState(QByteArray("garbage")).isEmpty());
+
+    widget.closeTab();
+    widget.closeTab();
+}
+
+// public static QByteArray stateFromTabs(...)
+void tst_TabWidget::stateFromTabs()
+{
+    QList<QUrl> urls;
+    QList<QByteArray> histories;
+    for (int i = 0; i < 50; ++i) {
+        urls.append(QUrl(QString("http://www.example.com/%1").arg(i % 5)));
+        histories.append(QByteArray(2048, 'a' + i % 5));
+    }
+    histories[0] = QByteArray();
+
+    QByteArray state = TabWidget::stateFromTabs(urls, histories, 3);
+    QCOMPARE(TabWidget::urlsFromState(state), urls);
+
+    // Written the way sessions were before the tabs shared their urls and histories
+    QByteArray oldState;
+    {
+        QDataStream stream(&oldState, QIODevice::WriteOnly);
+        stream << qint32(0xaa) << qint32(1);
+        QStringList tabs;
+        foreach (const QUrl &url, urls)
+            tabs.append(QString::fromUtf8(url.toEncoded()));
+        stream << tabs << 3 << histories;
+    }
+    QCOMPARE(TabWidget::urlsFromState(oldState), urls);
+    QVERIFY(state.size() * 10 < oldState.size());
+
+    // A truncated state is not read
+    QVERIFY(TabWidget::urlsFromState(state.left(state.size() - 8)).isEmpty());
+
+    SubTabWidget widget;
+    widget.newTab();
+    QList<QUrl> restoredUrls;
+    restoredUrls << QUrl("data:text/html;base32,Hello%20World") << QUrl("data:text/html;base32,Bye");
+    QStringList titles;
+    titles << "Hello" << "Bye";
+    QVERIFY(widget.restoreState(TabWidget::stateFromTabs(restoredUrls, QList<QByteArray>(), 1, titles)));
+    QCOMPARE(widget.count(), 2);
+    QCOMPARE(widget.currentIndex(), 1);
+    QCOMPARE(TabWidget::urlsFromState(widget.saveState()), restoredUrls);
+
+    // The tab that waits to be loaded shows its saved title, and keeps it
+    // when the session is saved again
+    QCOMPARE(widget.tabText(0), QString("Hello"));
+    SubTabWidget other;
+    QVERIFY(other.restoreState(widget.saveState()));
+    QCOMPARE(other.tabText(0), QString("Hello"));
+
+    widget.closeTab();
+    widget.closeTab();
+}
+
+// public int webViewIndex(WebView *webView) const
+void tst_TabWidget::webViewIndex()
+{
+    SubTabWidget widget;
+    QCOMPARE(widget.webViewIndex(0), -1);
+
+    WebView *first = widget.makeNewTab();
+    WebView *second = widget.makeNewTab();
+    WebView *third = widget.makeNewTab();
+    QCOMPARE(widget.webViewIndex(first), 0);
+    QCOMPARE(widget.webViewIndex(second), 1);
+    QCOMPARE(widget.webViewIndex(third), 2);
+
+    widget.call_tabBar()->moveTab(0, 2);
+    QCOMPARE(widget.webView(2), first);
+    QCOMPARE(widget.webViewIndex(first), 2);
+    QCOMPARE(widget.webViewIndex(second), 0);
+    QCOMPARE(widget.webViewIndex(third), 1);
+
+    widget.closeTab(0);
+    QCOMPARE(widget.webViewIndex(second), -1);
+    QCOMPARE(widget.webViewIndex(third), 0);
+    QCOMPARE(widget.webViewIndex(first), 1);
+
+    QUrl url = QUrl("data:text/html;base32,Hello%20World");
+    widget.setCurrentIndex(0);
+    first->loadUrl(url);
+    QVERIFY(widget.hibernateTab(1));
+    QCOMPARE(widget.webViewIndex(first), -1);
+    widget.setCurrentIndex(1);
+    QCOMPARE(widget.webViewIndex(widget.webView(1)), 1);
+
+    widget.closeTab();
+    widget.closeTab();
+}
+
+// The tab bar is updated from the WebViews after their signals are handled
+void tst_TabWidget::updateTabs()
+{
+    SubTabWidget widget;
+    widget.newTab();
+
+    QUrl url = QUrl("data:text/html,<title>Hello</title>World");
+    widget.loadUrl(url, TabWidget::CurrentTab);
+    QTRY_COMPARE(widget.tabText(0), QString("Hello"));
+    QCOMPARE(widget.tabToolTip(0), QString("Hello"));
+    QCOMPARE(widget.call_tabBar()->tabData(0).toUrl(), widget.webView(0)->url());
+
+    widget.closeTab();
+}
+
+// Only the current tab of a shown window is in the foreground
+void tst_TabWidget::backgroundTabs()
+{
+    SubTabWidget widget;
+    widget.show();
+    QUrl url = QUrl("data:text/html,<title>Hello</title>World");
+    widget.newTab();
+    widget.loadUrl(url, TabWidget::CurrentTab);
+    widget.loadUrl(url, TabWidget::NewTab);
+    QCOMPARE(widget.currentIndex(), 0);
+    QVERIFY(!widget.webView(0)->webPage()->isBackground());
+    QVERIFY(widget.webView(1)->webPage()->isBackground());
+    QTRY_COMPARE(widget.tabText(1), QString("Hello"));
+
+    // Only the busy counter is left for the page to see and it is read only
+    QWebFrame *frame = widget.webView(1)->page()->mainFrame();
+    QCOMPARE(frame->evaluateJavaScript("typeof window.__aroraTimers").toString(), QString("undefined"));
+    QCOMPARE(frame->evaluateJavaScript("window.__aroraTimersBusy = -1; window.__aroraTimersBusy >= 0").toBool(), true);
+
+    // The interval does not tick before the background minimum...
+    frame->evaluateJavaScript("var ticks = 0; setInterval(function () { ticks++; }, 10);");
+    QTest::qWait(300);
+    QCOMPARE(frame->evaluateJavaScript("ticks").toInt(), 0);
+
+    // ...and picks up its own pace again once the tab is shown
+    widget.setCurrentIndex(1);
+    QVERIFY(widget.webView(0)->webPage()->isBackground());
+    QVERIFY(!widget.webView(1)->webPage()->isBackground());
+    QTRY_VERIFY(frame->evaluateJavaScript("ticks").toInt() > 1);
+    QVERIFY(widget.webView(1)->cpuTime() >= 0);
+
+    widget.hide();
+    QVERIFY(widget.webView(1)->webPage()->isBackground());
+    widget.show();
+    QVERIFY(!widget.webView(1)->webPage()->isBackground());
+
+    widget.closeTab();
+    widget.closeTab();
+}
 
 QTEST_MAIN(tst_TabWidget)
 #include "tst_tabwidget.moc"
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += .
+INCLUDEPATH += .
+
+include(../../autotests.pri)
+
+# Input
+SOURCES = tst_publicsuffix.cpp publicsuffix.cpp
+HEADERS = publicsuffix.h publicsuffix_p.h
+FORMS =
+RESOURCES =
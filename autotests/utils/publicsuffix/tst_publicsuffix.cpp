@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <qtest.h>
+
+#include <publicsuffix.h>
+
+class tst_PublicSuffix : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void publicSuffix_data();
+    void publicSuffix();
+    void registrableDomain_data();
+    void registrableDomain();
+    void isPublicSuffix_data();
+    void isPublicSuffix();
+    void registrableDomainIndexBenchmark();
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_PublicSuffix::initTestCase()
+{
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_PublicSuffix::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_PublicSuffix::init()
+{
+}
+
+// This will be called after every test function.
+void tst_PublicSuffix::cleanup()
+{
+}
+
+void tst_PublicSuffix::publicSuffix_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<QString>("publicSuffix");
+
+    QTest::newRow("null") << QString() << QString();
+    QTest::newRow("tld") << QString("com") << QString("com");
+    QTest::newRow("domain") << QString("example.com") << QString("com");
+    QTest::newRow("subdomain") << QString("www.example.com") << QString("com");
+    QTest::newRow("unlisted") << QString("www.example.example") << QString("example");
+    QTest::newRow("second-level") << QString("www.example.co.jp") << QString("co.jp");
+    QTest::newRow("wildcard") << QString("www.example.co.uk") << QString("co.uk");
+    QTest::newRow("wildcard-only") << QString("www.example.foo.ck") << QString("foo.ck");
+    QTest::newRow("exception") << QString("www.ck") << QString("ck");
+    QTest::newRow("exception-sub") << QString("foo.www.ck") << QString("ck");
+    QTest::newRow("exception-jp") << QString("city.kawasaki.jp") << QString("kawasaki.jp");
+    QTest::newRow("wildcard-jp") << QString("www.city2.kawasaki.jp") << QString("city2.kawasaki.jp");
+    QTest::newRow("case") << QString("www.Example.COM") << QString("COM");
+    QTest::newRow("fully-qualified") << QString("www.example.com.") << QString("com");
+}
+
+// public static QString publicSuffix(const QString &host)
+void tst_PublicSuffix::publicSuffix()
+{
+    QFETCH(QString, host);
+    QFETCH(QString, publicSuffix);
+
+    QCOMPARE(PublicSuffix::publicSuffix(host), publicSuffix);
+}
+
+void tst_PublicSuffix::registrableDomain_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<QString>("registrableDomain");
+
+    QTest::newRow("null") << QString() << QString();
+    QTest::newRow("tld") << QString("com") << QString();
+    QTest::newRow("domain") << QString("example.com") << QString("example.com");
+    QTest::newRow("subdomain") << QString("a.b.example.com") << QString("example.com");
+    QTest::newRow("localhost") << QString("localhost") << QString();
+    QTest::newRow("second-level") << QString("co.uk") << QString();
+    QTest::newRow("wildcard") << QString("www.example.co.uk") << QString("example.co.uk");
+    QTest::newRow("exception") << QString("www.parliament.uk") << QString("parliament.uk");
+    QTest::newRow("exception-sub") << QString("foo.www.ck") << QString("www.ck");
+    QTest::newRow("empty-label") << QString(".com") << QString();
+    QTest::newRow("fully-qualified") << QString("www.example.com.") << QString("example.com");
+}
+
+// public static QString registrableDomain(const QString &host)
+void tst_PublicSuffix::registrableDomain()
+{
+    QFETCH(QString, host);
+    QFETCH(QString, registrableDomain);
+
+    QCOMPARE(PublicSuffix::registrableDomain(host), registrableDomain);
+}
+
+void tst_PublicSuffix::isPublicSuffix_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<bool>("isPublicSuffix");
+
+    QTest::newRow("null") << QString() << false;
+    QTest::newRow("tld") << QString("com") << true;
+    QTest::newRow("domain") << QString("example.com") << false;
+    QTest::newRow("second-level") << QString("co.uk") << true;
+    QTest::newRow("wildcard") << QString("foo.ck") << true;
+    QTest::newRow("exception") << QString("www.ck") << false;
+}
+
+// public static bool isPublicSuffix(const QString &host)
+void tst_PublicSuffix::isPublicSuffix()
+{
+    QFETCH(QString, host);
+    QFETCH(bool, isPublicSuffix);
+
+    QCOMPARE(PublicSuffix::isPublicSuffix(host), isPublicSuffix);
+}
+
+void tst_PublicSuffix::registrableDomainIndexBenchmark()
+{
+    QString host = QLatin1String("static.images.www.example.co.uk");
+    QBENCHMARK {
+        QCOMPARE(PublicSuffix::registrableDomainIndex(host), 18);
+    }
+}
+
+QTEST_MAIN(tst_PublicSuffix)
+#include "tst_publicsuffix.moc"
+
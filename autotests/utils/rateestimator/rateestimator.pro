@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += .
+INCLUDEPATH += .
+
+include(../../autotests.pri)
+
+# Input
+SOURCES = tst_rateestimator.cpp rateestimator.cpp
+HEADERS = rateestimator.h
+FORMS =
+RESOURCES =
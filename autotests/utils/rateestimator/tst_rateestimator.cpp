@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <qtest.h>
+
+#include <rateestimator.h>
+
+class tst_RateEstimator : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+private slots:
+    void empty();
+    void steadyRate_data();
+    void steadyRate();
+    void rateChange();
+    void stall();
+    void remainingTime();
+    void start();
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_RateEstimator::initTestCase()
+{
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_RateEstimator::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_RateEstimator::init()
+{
+}
+
+// This will be called after every test function.
+void tst_RateEstimator::cleanup()
+{
+}
+
+// Adds \a rate bytes per second from \a from until \a to in steps of 50ms
+static void feed(RateEstimator &estimator, qint64 rate, qint64 from, qint64 to)
+{
+    for (qint64 time = from; time < to; time += 50)
+        estimator.addBytes(rate / 20, time);
+}
+
+// Nothing is known before the first bytes arrive
+void tst_RateEstimator::empty()
+{
+    RateEstimator estimator;
+    QCOMPARE(estimator.bytes(), qint64(0));
+    QCOMPARE(estimator.currentRate(0), -1.0);
+    QCOMPARE(estimator.averageRate(0), -1.0);
+    QCOMPARE(estimator.remainingTime(100, 0), -1.0);
+    QVERIFY(estimator.elapsed() >= 0);
+}
+
+void tst_RateEstimator::steadyRate_data()
+{
+    QTest::addColumn<qint64>("rate");
+    QTest::newRow("slow") << qint64(1000);
+    QTest::newRow("fast") << qint64(10 * 1024 * 1024);
+}
+
+// The estimate should settle on a constant rate
+void tst_RateEstimator::steadyRate()
+{
+    QFETCH(qint64, rate);
+
+    RateEstimator estimator;
+    feed(estimator, rate, 0, 5000);
+    QCOMPARE(estimator.bytes(), rate / 20 * 100);
+    QVERIFY(qAbs(estimator.currentRate(5000) - rate) < rate * 0.05);
+    QVERIFY(qAbs(estimator.averageRate(5000) - rate) < rate * 0.05);
+}
+
+// The current rate follows a change within a few seconds while the
+// average rate covers the whole window
+void tst_RateEstimator::rateChange()
+{
+    RateEstimator estimator(2000, 10000);
+    feed(estimator, 10000, 0, 5000);
+    feed(estimator, 40000, 5000, 10000);
+    QVERIFY(estimator.currentRate(10000) > 30000);
+    QVERIFY(qAbs(estimator.averageRate(10000) - 25000) < 2500);
+
+    // Only the last ten seconds count towards the average
+    feed(estimator, 40000, 10000, 20000);
+    QVERIFY(qAbs(estimator.averageRate(20000) - 40000) < 2000);
+}
+
+// Nothing arriving lowers the rate even without any new bytes
+void tst_RateEstimator::stall()
+{
+    RateEstimator estimator(2000, 10000);
+    feed(estimator, 10000, 0, 5000);
+    double before = estimator.currentRate(5000);
+    double after = estimator.currentRate(9000);
+    QVERIFY(after > 0);
+    QVERIFY(after < before / 2);
+    QVERIFY(estimator.averageRate(9000) < estimator.averageRate(5000));
+
+    // The bytes from before the stall leave the window as it slides on
+    QVERIFY(qAbs(estimator.averageRate(10000) - 5000) < 500);
+    QCOMPARE(estimator.averageRate(16000), 0.0);
+
+    // A long stall is skipped over
+    estimator.addBytes(0, 3600 * 1000);
+    QVERIFY(estimator.currentRate(3600 * 1000) < 1);
+    QCOMPARE(estimator.averageRate(3600 * 1000), 0.0);
+
+    // and the rate picks up again afterwards
+    feed(estimator, 10000, 3600 * 1000, 3610 * 1000);
+    QVERIFY(estimator.currentRate(3610 * 1000) > 9000);
+}
+
+void tst_RateEstimator::remainingTime()
+{
+    RateEstimator estimator;
+    feed(estimator, 10000, 0, 5000);
+    QVERIFY(qAbs(estimator.remainingTime(50000, 5000) - 5) < 0.5);
+    QCOMPARE(estimator.remainingTime(0, 5000), 0.0);
+}
+
+// Starting over forgets what came before
+void tst_RateEstimator::start()
+{
+    RateEstimator estimator;
+    feed(estimator, 10000, 0, 5000);
+    estimator.start();
+    QCOMPARE(estimator.bytes(), qint64(0));
+    QCOMPARE(estimator.currentRate(0), -1.0);
+    QCOMPARE(estimator.averageRate(0), -1.0);
+}
+
+QTEST_MAIN(tst_RateEstimator)
+#include "tst_rateestimator.moc"
+
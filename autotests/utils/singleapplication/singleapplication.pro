@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += .
+INCLUDEPATH += .
+
+include(../../autotests.pri)
+
+# Input
+SOURCES = tst_singleapplication.cpp singleapplication.cpp
+HEADERS = singleapplication.h
+FORMS =
+RESOURCES =
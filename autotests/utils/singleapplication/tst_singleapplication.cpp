@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <qtest.h>
+#include <qdatastream.h>
+#include <qlocalsocket.h>
+
+#include "qtry.h"
+
+#include <singleapplication.h>
+
+class tst_SingleApplication : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void messageReceived(QLocalSocket *socket, const QByteArray &message);
+
+private slots:
+    void sendMessages_data();
+    void sendMessages();
+    void partialMessage();
+    void invalidMessage();
+    void sendReply();
+
+private:
+    static QByteArray frame(const QByteArray &message);
+
+    SingleApplication *m_application;
+    QList<QByteArray> m_messages;
+};
+
+// This will be called before the first test function is executed.
+// It is only called once.
+void tst_SingleApplication::initTestCase()
+{
+    m_application = qobject_cast<SingleApplication*>(QCoreApplication::instance());
+    QVERIFY(m_application);
+    QVERIFY(m_application->startSingleServer());
+    connect(m_application, SIGNAL(messageReceived(QLocalSocket *, const QByteArray &)),
+            this, SLOT(messageReceived(QLocalSocket *, const QByteArray &)));
+}
+
+// This will be called after the last test function is executed.
+// It is only called once.
+void tst_SingleApplication::cleanupTestCase()
+{
+}
+
+// This will be called before each test function is executed.
+void tst_SingleApplication::init()
+{
+    m_messages.clear();
+}
+
+// This will be called after every test function.
+void tst_SingleApplication::cleanup()
+{
+}
+
+void tst_SingleApplication::messageReceived(QLocalSocket *socket, const QByteArray &message)
+{
+    m_messages.append(message);
+    if (message == "ping")
+        m_application->sendReply(socket, "pong");
+}
+
+QByteArray tst_SingleApplication::frame(const QByteArray &message)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(message.size());
+    return data + message;
+}
+
+typedef QList<QByteArray> ByteArrayList;
+Q_DECLARE_METATYPE(ByteArrayList)
+void tst_SingleApplication::sendMessages_data()
+{
+    QTest::addColumn<ByteArrayList>("messages");
+
+    QTest::newRow("one") << (ByteArrayList() << "http://www.example.com/");
+    QTest::newRow("several") << (ByteArrayList() << "a" << "http://www.example.com/\nhttp://www.example.org/" << "c");
+    QTest::newRow("empty") << (ByteArrayList() << QByteArray() << "a");
+
+    ByteArrayList many;
+    for (int i = 0; i < 500; ++i)
+        many.append(QString(QLatin1String("http://www.example.com/%1")).arg(i).toUtf8());
+    QTest::newRow("many") << many;
+}
+
+// public bool sendMessages(const QList<QByteArray> &messages, int waitMsecsForReply = 0)
+void tst_SingleApplication::sendMessages()
+{
+    QFETCH(ByteArrayList, messages);
+
+    QVERIFY(m_application->sendMessages(messages));
+    QTRY_COMPARE(m_messages.count(), messages.count());
+    QCOMPARE(m_messages, messages);
+}
+
+void tst_SingleApplication::partialMessage()
+{
+    QLocalSocket socket;
+    socket.connectToServer(m_application->serverName());
+    QVERIFY(socket.waitForConnected(1000));
+
+    QByteArray data = frame("http://www.example.com/");
+    socket.write(data.left(2));
+    socket.flush();
+    QTest::qWait(100);
+    socket.write(data.mid(2, 10));
+    socket.flush();
+    QTest::qWait(100);
+    QCOMPARE(m_messages.count(), 0);
+
+    socket.write(data.mid(12));
+    socket.flush();
+    QTRY_COMPARE(m_messages.count(), 1);
+    QCOMPARE(m_messages.first(), QByteArray("http://www.example.com/"));
+}
+
+void tst_SingleApplication::invalidMessage()
+{
+    QLocalSocket socket;
+    socket.connectToServer(m_application->serverName());
+    QVERIFY(socket.waitForConnected(1000));
+
+    socket.write(QByteArray("GET / HTTP/1.0\r\n\r\n"));
+    socket.flush();
+    QTRY_COMPARE(socket.state(), QLocalSocket::UnconnectedState);
+    QCOMPARE(m_messages.count(), 0);
+}
+
+// public void sendReply(QLocalSocket *socket, const QByteArray &message)
+void tst_SingleApplication::sendReply()
+{
+    QLocalSocket socket;
+    socket.connectToServer(m_application->serverName());
+    QVERIFY(socket.waitForConnected(1000));
+
+    socket.write(frame("ping"));
+    socket.flush();
+    QByteArray expected = frame("pong");
+    QTRY_COMPARE(socket.bytesAvailable(), qint64(expected.size()));
+    QCOMPARE(socket.readAll(), expected);
+}
+
+int main(int argc, char *argv[])
+{
+    SingleApplication application(argc, argv);
+    application.setApplicationName(QLatin1String("tst_singleapplication"));
+    tst_SingleApplication tc;
+    return QTest::qExec(&tc, argc, argv);
+}
+
+#include "tst_singleapplication.moc"
+
@@ -3,6 +3,9 @@ SUBDIRS  = \
     editlistview \
     edittreeview \
     languagemanager \
-    lineedit
+    lineedit \
+    publicsuffix \
+    rateestimator \
+    singleapplication
 
 CONFIG += ordered
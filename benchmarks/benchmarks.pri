@@ -0,0 +1,14 @@
+win32: CONFIG += console
+mac:CONFIG -= app_bundle
+
+include($$PWD/../src/src.pri)
+
+DEFINES += AUTOTESTS
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+RCC_DIR     = $$PWD/.rcc
+UI_DIR      = $$PWD/.ui
+MOC_DIR     = $$PWD/.moc
+OBJECTS_DIR = $$PWD/.obj
@@ -0,0 +1,489 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+    Measures how long Arora takes to start up and shut down with a profile
+    of a given size.
+
+    Run without arguments it seeds a fresh profile with synthetic history,
+    cookies, bookmarks, AdBlock rules and a saved session, then starts a
+    new process on that profile for every run and prints what each phase
+    took as JSON on stdout.  The profile is found through HOME and the XDG
+    directories, so the user's own profile is never touched.
+
+    Like the autotests it needs a display, use xvfb-run to run it headless.
+
+    Usage: startup [-history N] [-bookmarks N] [-cookies N] [-adblock N]
+                   [-tabs N] [-runs N] [-profile directory] [-keep]
+*/
+
+#include "adblockmanager.h"
+#include "adblockrule.h"
+#include "adblocksubscription.h"
+#include "bookmarknode.h"
+#include "bookmarksmanager.h"
+#include "browserapplication.h"
+#include "browsermainwindow.h"
+#include "cookiejar.h"
+#include "historymanager.h"
+#include "tabwidget.h"
+#include "toolbarsearch.h"
+#include "webview.h"
+
+#include <qdir.h>
+#include <qeventloop.h>
+#include <qfile.h>
+#include <qnetworkcookie.h>
+#include <qprocess.h>
+#include <qsettings.h>
+#include <qtextstream.h>
+#include <qtimer.h>
+
+#if QT_VERSION >= 0x040700
+#include <qelapsedtimer.h>
+#else
+#include <qdatetime.h>
+#endif
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+struct Options
+{
+    Options()
+        : history(10000)
+        , bookmarks(500)
+        , cookies(1000)
+        , adBlockRules(2000)
+        , tabs(20)
+        , runs(5)
+        , keep(false)
+    {}
+
+    QStringList arguments() const;
+
+    int history;
+    int bookmarks;
+    int cookies;
+    int adBlockRules;
+    int tabs;
+    int runs;
+    bool keep;
+    QString profile;
+};
+
+QStringList Options::arguments() const
+{
+    QStringList arguments;
+    arguments << QLatin1String("-history") << QString::number(history)
+              << QLatin1String("-bookmarks") << QString::number(bookmarks)
+              << QLatin1String("-cookies") << QString::number(cookies)
+              << QLatin1String("-adblock") << QString::number(adBlockRules)
+              << QLatin1String("-tabs") << QString::number(tabs)
+              << QLatin1String("-profile") << profile;
+    return arguments;
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        QString argument = QString::fromLocal8Bit(argv[i]);
+        if (argument == QLatin1String("-keep")) {
+            options.keep = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            break;
+        QString value = QString::fromLocal8Bit(argv[i + 1]);
+        if (argument == QLatin1String("-history"))
+            options.history = value.toInt();
+        else if (argument == QLatin1String("-bookmarks"))
+            options.bookmarks = value.toInt();
+        else if (argument == QLatin1String("-cookies"))
+            options.cookies = value.toInt();
+        else if (argument == QLatin1String("-adblock"))
+            options.adBlockRules = value.toInt();
+        else if (argument == QLatin1String("-tabs"))
+            options.tabs = value.toInt();
+        else if (argument == QLatin1String("-runs"))
+            options.runs = value.toInt();
+        else if (argument == QLatin1String("-profile"))
+            options.profile = value;
+        else
+            continue;
+        ++i;
+    }
+    return options;
+}
+
+class Clock
+{
+public:
+    void start() { m_time.start(); }
+    qint64 elapsed() const { return m_time.elapsed(); }
+
+private:
+#if QT_VERSION >= 0x040700
+    QElapsedTimer m_time;
+#else
+    QTime m_time;
+#endif
+};
+
+/*
+    Resident and peak resident memory of this process in kilobytes,
+    -1 where the platform doesn't tell.
+ */
+static qint64 residentMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile file(QLatin1String("/proc/self/statm"));
+    if (!file.open(QFile::ReadOnly))
+        return -1;
+    QList<QByteArray> fields = file.readAll().split(' ');
+    if (fields.count() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+#else
+    return -1;
+#endif
+}
+
+static qint64 peakResidentMemory()
+{
+#if defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_MAC)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+class Phases
+{
+public:
+    void start() { m_clock.start(); }
+    void finish(const char *name);
+    QString toJson() const { return QLatin1String("{ \"phases\": [ ") + m_phases.join(QLatin1String(", ")) + QLatin1String(" ] }"); }
+
+private:
+    Clock m_clock;
+    QStringList m_phases;
+};
+
+void Phases::finish(const char *name)
+{
+    qint64 msecs = m_clock.elapsed();
+    m_phases.append(QString(QLatin1String("{ \"name\": \"%1\", \"msecs\": %2, \"rss\": %3, \"peakRss\": %4 }"))
+                    .arg(QLatin1String(name))
+                    .arg(msecs)
+                    .arg(residentMemory())
+                    .arg(peakResidentMemory()));
+}
+
+class PaintWatcher : public QObject
+{
+public:
+    PaintWatcher() : painted(false) {}
+
+    bool eventFilter(QObject *object, QEvent *event)
+    {
+        if (event->type() == QEvent::Paint)
+            painted = true;
+        return QObject::eventFilter(object, event);
+    }
+
+    bool painted;
+};
+
+static void waitForPaint(QWidget *widget)
+{
+    PaintWatcher watcher;
+    widget->installEventFilter(&watcher);
+    Clock clock;
+    clock.start();
+    while (!watcher.painted && clock.elapsed() < 5000)
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    widget->removeEventFilter(&watcher);
+}
+
+static void waitForLoad(WebView *webView)
+{
+    if (!webView)
+        return;
+    QEventLoop loop;
+    QObject::connect(webView, SIGNAL(loadFinished(bool)), &loop, SLOT(quit()));
+    QTimer::singleShot(10000, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+/*
+    Fills the profile through the managers themselves so that every file
+    is written in the format the browser reads.
+ */
+static int seed(char **argv, const Options &options)
+{
+    int argc = 1;
+    BrowserApplication application(argc, argv);
+
+    const int hosts = 100;
+    QDateTime now = QDateTime::currentDateTime();
+
+    // Spread the visits over the days before history would expire them
+    QList<HistoryEntry> history;
+    int interval = 29 * 24 * 60 * 60 / qMax(1, options.history);
+    for (int i = 0; i < options.history; ++i) {
+        QString url = QString(QLatin1String("http://www%1.example.com/page%2.html")).arg(i % hosts).arg(i);
+        QString title = QString(QLatin1String("Page %1 of www%2")).arg(i).arg(i % hosts);
+        history.append(HistoryEntry(url, now.addSecs(-i * interval), title));
+    }
+    BrowserApplication::historyManager()->setHistory(history);
+
+    QList<QNetworkCookie> cookies;
+    for (int i = 0; i < options.cookies; ++i) {
+        QNetworkCookie cookie(QString(QLatin1String("cookie%1")).arg(i).toLatin1(), QByteArray(32, 'x'));
+        cookie.setDomain(QString(QLatin1String(".www%1.example.com")).arg(i % hosts));
+        cookie.setPath(QLatin1String("/"));
+        cookie.setExpirationDate(now.addYears(1));
+        cookies.append(cookie);
+    }
+    BrowserApplication::cookieJar()->setCookies(cookies);
+
+    // Folders of twenty bookmarks, alternating between the toolbar and the menu
+    BookmarksManager *bookmarksManager = BrowserApplication::bookmarksManager();
+    BookmarkNode *folder = 0;
+    for (int i = 0; i < options.bookmarks; ++i) {
+        if (i % 20 == 0) {
+            folder = new BookmarkNode(BookmarkNode::Folder);
+            folder->title = QString(QLatin1String("Folder %1")).arg(i / 20);
+            BookmarkNode *parent = (i / 20) % 2 ? bookmarksManager->menu() : bookmarksManager->toolbar();
+            bookmarksManager->addBookmark(parent, folder);
+        }
+        BookmarkNode *bookmark = new BookmarkNode(BookmarkNode::Bookmark);
+        bookmark->url = QString(QLatin1String("http://www%1.example.com/")).arg(i % hosts);
+        bookmark->title = QString(QLatin1String("Bookmark %1")).arg(i);
+        bookmarksManager->addBookmark(folder, bookmark);
+    }
+
+    AdBlockManager *adBlockManager = AdBlockManager::instance();
+    adBlockManager->load();
+    AdBlockSubscription *customRules = adBlockManager->customRules();
+    for (int i = 0; i < options.adBlockRules; ++i)
+        customRules->addRule(AdBlockRule(QString(QLatin1String("||ads%1.example.com^")).arg(i)));
+
+    // The tabs are local pages so restoring them doesn't wait on the network
+    QDir profile(options.profile);
+    profile.mkpath(QLatin1String("pages"));
+    QList<QUrl> urls;
+    QList<QByteArray> histories;
+    for (int i = 0; i < options.tabs; ++i) {
+        QFile page(profile.filePath(QString(QLatin1String("pages/tab%1.html")).arg(i)));
+        if (!page.open(QFile::WriteOnly))
+            return 1;
+        QTextStream stream(&page);
+        stream << "<html><head><title>Tab " << i << "</title></head>"
+               << "<body><p>Tab " << i << "</p></body></html>\n";
+        urls.append(QUrl::fromLocalFile(page.fileName()));
+        histories.append(QByteArray());
+    }
+    BrowserMainWindow *window = application.newMainWindow();
+    QByteArray tabState = TabWidget::stateFromTabs(urls, histories, 0);
+    window->restoreState(BrowserMainWindow::stateWithTabs(window->saveState(false), tabState));
+    application.saveSession();
+
+    // The session is restored as its own phase rather than in postLaunch()
+    QSettings settings;
+    settings.beginGroup(QLatin1String("MainWindow"));
+    settings.setValue(QLatin1String("startupBehavior"), 1);
+    return 0;
+}
+
+static int measure(char **argv)
+{
+    Phases phases;
+    int argc = 1;
+
+    phases.start();
+    BrowserApplication *application = new BrowserApplication(argc, argv);
+    phases.finish("construction");
+
+    phases.start();
+    BrowserMainWindow *window = application->newMainWindow();
+    waitForPaint(window);
+    phases.finish("firstWindowShown");
+
+    phases.start();
+    QMetaObject::invokeMethod(application, "postLaunch");
+    // postLaunch() leaves the rest for the next pass through the event loop
+    QCoreApplication::processEvents();
+    phases.finish("postLaunch");
+
+    phases.start();
+    application->restoreLastSession();
+    waitForLoad(window->currentTab());
+    phases.finish("sessionRestore");
+
+    // Whatever startup deferred is loaded the first time it is used
+    phases.start();
+    BrowserApplication::bookmarksManager()->bookmarks();
+    BrowserApplication::cookieJar()->cookies();
+    AdBlockManager::instance()->subscriptions();
+    ToolbarSearch::openSearchManager();
+    phases.finish("profileLoad");
+
+    phases.start();
+    application->saveSession();
+    delete application;
+    phases.finish("shutdown");
+
+    QTextStream out(stdout);
+    out << phases.toJson() << endl;
+    return 0;
+}
+
+static bool removeDirectory(const QString &path)
+{
+    QDir directory(path);
+    QFileInfoList entries = directory.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot);
+    foreach (const QFileInfo &entry, entries) {
+        if (entry.isDir() && !entry.isSymLink()) {
+            if (!removeDirectory(entry.filePath()))
+                return false;
+        } else if (!QFile::remove(entry.filePath())) {
+            return false;
+        }
+    }
+    return directory.rmdir(path);
+}
+
+static QStringList profileEnvironment(const QString &profile)
+{
+    QStringList environment;
+    QStringList variables;
+    variables << QLatin1String("HOME") << QLatin1String("XDG_DATA_HOME")
+              << QLatin1String("XDG_CONFIG_HOME") << QLatin1String("XDG_CACHE_HOME");
+    foreach (const QString &variable, QProcess::systemEnvironment()) {
+        if (!variables.contains(variable.section(QLatin1Char('='), 0, 0)))
+            environment.append(variable);
+    }
+    environment << QLatin1String("HOME=") + profile
+                << QLatin1String("XDG_DATA_HOME=") + profile + QLatin1String("/data")
+                << QLatin1String("XDG_CONFIG_HOME=") + profile + QLatin1String("/config")
+                << QLatin1String("XDG_CACHE_HOME=") + profile + QLatin1String("/cache");
+    return environment;
+}
+
+static bool runChild(const QStringList &arguments, const QStringList &environment, QByteArray *output)
+{
+    QProcess process;
+    process.setEnvironment(environment);
+    process.start(QCoreApplication::applicationFilePath(), arguments);
+    if (!process.waitForFinished(-1)
+        || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        QTextStream(stderr) << process.readAllStandardError();
+        return false;
+    }
+    if (output)
+        *output = process.readAllStandardOutput().trimmed();
+    return true;
+}
+
+static int benchmark(int argc, char **argv, Options options)
+{
+    QCoreApplication application(argc, argv);
+    QTextStream err(stderr);
+
+    bool temporary = options.profile.isEmpty();
+    if (temporary)
+        options.profile = QDir::tempPath() + QString(QLatin1String("/arora-benchmark-%1")).arg(QCoreApplication::applicationPid());
+    options.profile = QDir(options.profile).absolutePath();
+    if (!QDir().mkpath(options.profile)) {
+        err << "Unable to create the profile " << options.profile << endl;
+        return 1;
+    }
+
+    QStringList environment = profileEnvironment(options.profile);
+    if (!runChild(QStringList() << QLatin1String("-seed") << options.arguments(), environment, 0)) {
+        err << "Seeding the profile failed" << endl;
+        return 1;
+    }
+
+    QStringList runs;
+    for (int i = 0; i < options.runs; ++i) {
+        QByteArray output;
+        if (!runChild(QStringList() << QLatin1String("-measure"), environment, &output)) {
+            err << "Run " << i << " failed" << endl;
+            return 1;
+        }
+        runs.append(QString::fromUtf8(output));
+    }
+
+    QTextStream out(stdout);
+    out << "{" << endl
+        << "    \"profile\": { \"history\": " << options.history
+        << ", \"bookmarks\": " << options.bookmarks
+        << ", \"cookies\": " << options.cookies
+        << ", \"adblockRules\": " << options.adBlockRules
+        << ", \"tabs\": " << options.tabs << " }," << endl
+        << "    \"runs\": [" << endl;
+    for (int i = 0; i < runs.count(); ++i)
+        out << "        " << runs.at(i) << (i + 1 < runs.count() ? "," : "") << endl;
+    out << "    ]" << endl
+        << "}" << endl;
+
+    if (temporary && !options.keep)
+        removeDirectory(options.profile);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Q_INIT_RESOURCE(htmls);
+    Q_INIT_RESOURCE(data);
+#ifdef Q_WS_X11
+    QApplication::setGraphicsSystem(QString::fromLatin1("raster"));
+#endif
+    Options options = parseOptions(argc, argv);
+    QString mode = argc > 1 ? QString::fromLocal8Bit(argv[1]) : QString();
+    if (mode == QLatin1String("-seed"))
+        return seed(argv, options);
+    if (mode == QLatin1String("-measure"))
+        return measure(argv);
+    return benchmark(argc, argv, options);
+}
+
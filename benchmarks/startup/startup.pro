@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET =
+DEPENDPATH += .
+INCLUDEPATH += . ../
+
+include(../benchmarks.pri)
+
+# Input
+SOURCES += main_startup.cpp
+HEADERS +=
@@ -29,7 +29,6 @@
 #include <qplaintextedit.h>
 #include <qdebug.h>
 #include <qlocalsocket.h>
-#include <qtextstream.h>
 
 #include <singleapplication.h>
 
@@ -41,11 +40,9 @@ public:
         : QPlainTextEdit(parent) { }
 
 public slots:
-    void messageReceived(QLocalSocket *socket) {
-        QString message;
-        QTextStream stream(socket);
-        stream >> message;
-        appendPlainText(message);
+    void messageReceived(QLocalSocket *socket, const QByteArray &message) {
+        Q_UNUSED(socket);
+        appendPlainText(QString::fromUtf8(message));
     }
 
 };
@@ -54,16 +51,20 @@ int main(int argc, char **argv)
 {
     SingleApplication app(argc, argv);
     app.setApplicationName("testapp");
-    if (app.arguments().count() > 1
-        && app.sendMessage(app.arguments().last().toUtf8()))
-        return 0;
+    if (app.arguments().count() > 1) {
+        QList<QByteArray> messages;
+        foreach (const QString &argument, app.arguments().mid(1))
+            messages.append(argument.toUtf8());
+        if (app.sendMessages(messages))
+            return 0;
+    }
 
     PlainTextEdit plainTextEdit;
     plainTextEdit.show();
     if (!app.startSingleServer())
         qWarning() << "Error starting server";
-    app.connect(&app, SIGNAL(messageReceived(QLocalSocket *)),
-                &plainTextEdit, SLOT(messageReceived(QLocalSocket *)));
+    app.connect(&app, SIGNAL(messageReceived(QLocalSocket *, const QByteArray &)),
+                &plainTextEdit, SLOT(messageReceived(QLocalSocket *, const QByteArray &)));
     return app.exec();
 }
 
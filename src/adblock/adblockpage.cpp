@@ -47,6 +47,17 @@ AdBlockPage::AdBlockPage(QObject *parent)
 {
 }
 
+// Matches domain itself and any host below it, but not "badexample.com" for "example.com"
+static bool matchesDomain(const QString &host, const QString &domain)
+{
+    if (domain.isEmpty() || !host.endsWith(domain, Qt::CaseInsensitive))
+        return false;
+    int offset = host.length() - domain.length();
+    return offset == 0
+        || host.at(offset - 1) == QLatin1Char('.')
+        || domain.at(0) == QLatin1Char('.');
+}
+
 void AdBlockPage::checkRule(const AdBlockRule *rule, QWebPage *page, const QString &host)
 {
     if (!rule->isEnabled())
@@ -68,11 +79,11 @@ void AdBlockPage::checkRule(const AdBlockRule *rule, QWebPage *page, const QStri
             bool reverse = (domain[0] == QLatin1Char('~'));
             if (reverse) {
                 QString xdomain = domain.mid(1);
-                if (host.endsWith(xdomain))
+                if (matchesDomain(host, xdomain))
                     return;
                 match = true;
             }
-            if (host.endsWith(domain))
+            if (matchesDomain(host, domain))
                 match = true;
         }
         if (!match)
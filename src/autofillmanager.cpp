@@ -41,6 +41,9 @@
 #include <qsettings.h>
 #include <qurl.h>
 #include <qwebframe.h>
+#if QT_VERSION >= 0x040600 || defined(WEBKIT_TRUNK)
+#include <qwebelement.h>
+#endif
 #include <qwebpage.h>
 #include <qwebsettings.h>
 
@@ -120,30 +123,38 @@ void AutoFillManager::loadFormData()
     stream >> m_forms;
 }
 
-void AutoFillManager::post(const QNetworkRequest &request, const QByteArray &outgoingData)
+/*!
+    Returns the page that submitted \a request when the request could be
+    saving a login form, otherwise 0.  The post data is not needed for
+    this so it can be checked before the data is read.  The stripped url
+    of the form is put in \a url.
+ */
+QWebPage *AutoFillManager::loginFormPage(const QNetworkRequest &request, QUrl *url) const
 {
-#ifdef AUTOFILL_DEBUG
-    qDebug() << "AutoFillManager::" << __FUNCTION__ << outgoingData << request.url();
-#endif
-
     // Don't even give the options to save this site user name & password.
-    if (QWebSettings::globalSettings()->testAttribute(QWebSettings::PrivateBrowsingEnabled)) {
-        return;
-    }
+    if (QWebSettings::globalSettings()->testAttribute(QWebSettings::PrivateBrowsingEnabled))
+        return 0;
+
+    // Only forms with a password are ever saved
+    if (!allowedToAutoFill(true))
+        return 0;
+
+    QByteArray contentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+    if (!contentType.isEmpty() && !contentType.startsWith("application/x-www-form-urlencoded"))
+        return 0;
 
     // Determine the url
     QByteArray refererHeader = request.rawHeader("Referer");
     if (refererHeader.isEmpty()) {
         // XXX We could store the frame url in the request if this is a common problem
         qWarning() << "AutoFillManager:" << "Unable to determine the request Referer";
-        return;
+        return 0;
     }
-    QUrl url = QUrl::fromEncoded(refererHeader);
-    url = stripUrl(url);
+    QUrl strippedUrl = stripUrl(QUrl::fromEncoded(refererHeader));
 
     // Check that the url isn't in m_never
-    if (m_never.contains(url))
-        return;
+    if (m_never.contains(strippedUrl))
+        return 0;
 
     // Check the request type
     QVariant typeVariant = request.attribute((QNetworkRequest::Attribute)(WebPageProxy::pageAttributeId() + 1));
@@ -152,7 +163,7 @@ void AutoFillManager::post(const QNetworkRequest &request, const QByteArray &out
         // XXX Does this occur normally?
         qWarning() << "AutoFillManager:" << "Type is not FormSubmitted" << type
                    << "expected:" << QWebPage::NavigationTypeFormSubmitted;
-        return;
+        return 0;
     }
 
     // Determine the QWebView
@@ -160,16 +171,40 @@ void AutoFillManager::post(const QNetworkRequest &request, const QByteArray &out
     QWebPage *webPage = (QWebPage*)(v.value<void*>());
     if (!webPage) {
         qWarning() << "AutoFillManager:" << "QWebPage is not set in QNetworkRequest.";
-        return;
+        return 0;
     }
 #if 0
     // TODO CHECK reply ownership
     if (!NetworkAccessManagerProxy::exists(webPage)) {
         qWarning() << "AutoFillManager:" << "QWebPage no longer exists.";
-        return;
+        return 0;
     }
 #endif
 
+    // Without a password field there is no login form to save
+#if QT_VERSION >= 0x040600 || defined(WEBKIT_TRUNK)
+    if (webPage->mainFrame()->findFirstElement(QLatin1String("input[type=\"password\"]")).isNull())
+        return 0;
+#else
+    if (!webPage->mainFrame()->evaluateJavaScript(QLatin1String("document.querySelector('input[type=\"password\"]') != null")).toBool())
+        return 0;
+#endif
+
+    if (url)
+        *url = strippedUrl;
+    return webPage;
+}
+
+/*!
+    Saves the login form \a webPage posted with \a outgoingData, \a webPage
+    and \a url are the ones loginFormPage() returned for the request.
+ */
+void AutoFillManager::post(QWebPage *webPage, const QUrl &url, const QByteArray &outgoingData)
+{
+#ifdef AUTOFILL_DEBUG
+    qDebug() << "AutoFillManager::" << __FUNCTION__ << outgoingData << url;
+#endif
+
     // Find the matching form on the webpage
     Form form = findForm(webPage, outgoingData);
     if (!form.isValid()) {
@@ -61,7 +61,8 @@ public:
 
     void loadSettings();
 
-    void post(const QNetworkRequest &request, const QByteArray &outgoingData);
+    QWebPage *loginFormPage(const QNetworkRequest &request, QUrl *url = 0) const;
+    void post(QWebPage *webPage, const QUrl &url, const QByteArray &outgoingData);
     void fill(QWebPage *page) const;
 
     void setForms(const QList<Form> &forms);
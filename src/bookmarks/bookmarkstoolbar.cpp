@@ -29,14 +29,12 @@
 #include "modelmenu.h"
 
 #include <qevent.h>
+#include <qtimer.h>
 
 BookmarksToolBar::BookmarksToolBar(BookmarksModel *model, QWidget *parent)
     : ModelToolBar(parent)
     , m_bookmarksModel(model)
 {
-    setModel(model);
-    setRootIndex(model->index(BrowserApplication::bookmarksManager()->toolbar()));
-
     setContextMenuPolicy(Qt::CustomContextMenu);
     connect(this, SIGNAL(customContextMenuRequested(const QPoint &)),
             this, SLOT(contextMenuRequested(const QPoint &)));
@@ -47,6 +45,27 @@ BookmarksToolBar::BookmarksToolBar(BookmarksModel *model, QWidget *parent)
     setToolButtonStyle(Qt::ToolButtonTextOnly);
 }
 
+/*!
+    The bookmarks are only read once the toolbar is about to be visible
+    and the window around it has been painted.
+ */
+void BookmarksToolBar::showEvent(QShowEvent *event)
+{
+    ModelToolBar::showEvent(event);
+    if (!model())
+        QTimer::singleShot(0, this, SLOT(setupModel()));
+}
+
+void BookmarksToolBar::setupModel()
+{
+    if (model())
+        return;
+    setModel(m_bookmarksModel);
+    setRootIndex(m_bookmarksModel->index(BrowserApplication::bookmarksManager()->toolbar()));
+    if (isVisible())
+        build();
+}
+
 void BookmarksToolBar::contextMenuRequested(const QPoint &position)
 {
     QAction *action = actionAt(position);
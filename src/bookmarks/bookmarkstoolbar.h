@@ -43,8 +43,10 @@ public:
 
 protected:
     virtual ModelMenu *createMenu();
+    void showEvent(QShowEvent *event);
 
 private slots:
+    void setupModel();
     void contextMenuRequested(const QPoint &position);
 
 protected slots:
@@ -66,11 +66,15 @@
 #include "autofillmanager.h"
 #include "bookmarksmanager.h"
 #include "browsermainwindow.h"
+#include "closedtabstore.h"
 #include "cookiejar.h"
 #include "downloadmanager.h"
+#include "history.h"
 #include "historymanager.h"
 #include "languagemanager.h"
 #include "networkaccessmanager.h"
+#include "sessionjournal.h"
+#include "startuptrace.h"
 #include "tabwidget.h"
 #include "webview.h"
 
@@ -98,9 +102,11 @@ NetworkAccessManager *BrowserApplication::s_networkAccessManager = 0;
 BookmarksManager *BrowserApplication::s_bookmarksManager = 0;
 LanguageManager *BrowserApplication::s_languageManager = 0;
 AutoFillManager *BrowserApplication::s_autoFillManager = 0;
+ClosedTabStore *BrowserApplication::s_closedTabStore = 0;
 
 BrowserApplication::BrowserApplication(int &argc, char **argv)
     : SingleApplication(argc, argv)
+    , m_sessionJournal(new SessionJournal(this))
     , quitting(false)
 {
     QCoreApplication::setOrganizationDomain(QLatin1String("arora-browser.org"));
@@ -112,17 +118,22 @@ BrowserApplication::BrowserApplication(int &argc, char **argv)
     ));
 
 #ifndef AUTOTESTS
-    connect(this, SIGNAL(messageReceived(QLocalSocket *)),
-            this, SLOT(messageReceived(QLocalSocket *)));
+    connect(this, SIGNAL(messageReceived(QLocalSocket *, const QByteArray &)),
+            this, SLOT(messageReceived(QLocalSocket *, const QByteArray &)));
 
+    // Hand all of the urls to an Arora that is already running in one go
+    QList<QByteArray> messages;
     QStringList args = QCoreApplication::arguments();
     if (args.count() > 1) {
-        QString message = parseArgumentUrl(args.last());
-        sendMessage(message.toUtf8());
+        QStringList urls;
+        for (int i = 1; i < args.count(); ++i)
+            urls.append(parseArgumentUrl(args.at(i)));
+        messages.append(urls.join(QLatin1String("\n")).toUtf8());
     }
+    messages.append(QByteArray("aroramessage://getwinid"));
+
     // If we could connect to another Arora then exit
-    QString message = QString(QLatin1String("aroramessage://getwinid"));
-    if (sendMessage(message.toUtf8(), 500))
+    if (sendMessages(messages, 500))
         return;
 
 #ifdef BROWSERAPPLICATION_DEBUG
@@ -146,10 +157,14 @@ BrowserApplication::BrowserApplication(int &argc, char **argv)
     QWebSettings::globalSettings()->setFontSize(QWebSettings::DefaultFontSize, 16);
     QWebSettings::globalSettings()->setFontSize(QWebSettings::DefaultFixedFontSize, 16);
 
-    QSettings settings;
-    settings.beginGroup(QLatin1String("sessions"));
-    m_lastSession = settings.value(QLatin1String("lastSession")).toByteArray();
-    settings.endGroup();
+    if (m_sessionJournal->read(dataFilePath(QLatin1String("session.journal")))) {
+        m_lastSession = journaledSession();
+    } else {
+        QSettings settings;
+        settings.beginGroup(QLatin1String("sessions"));
+        m_lastSession = settings.value(QLatin1String("lastSession")).toByteArray();
+        settings.endGroup();
+    }
 
 #if defined(Q_WS_MAC)
     connect(this, SIGNAL(lastWindowClosed()),
@@ -164,6 +179,7 @@ BrowserApplication::BrowserApplication(int &argc, char **argv)
     QTimer::singleShot(0, this, SLOT(postLaunch()));
 #endif
     languageManager();
+    StartupTrace::mark(QLatin1String("application created"));
 }
 
 BrowserApplication::~BrowserApplication()
@@ -176,6 +192,7 @@ BrowserApplication::~BrowserApplication()
     delete s_languageManager;
     delete s_historyManager;
     delete s_autoFillManager;
+    delete s_closedTabStore;
 }
 
 #if defined(Q_WS_MAC)
@@ -210,29 +227,27 @@ QString BrowserApplication::parseArgumentUrl(const QString &string) const
     return string;
 }
 
-void BrowserApplication::messageReceived(QLocalSocket *socket)
+void BrowserApplication::messageReceived(QLocalSocket *socket, const QByteArray &data)
 {
-    QString message;
-    QTextStream stream(socket);
-    stream >> message;
+    QString message = QString::fromUtf8(data).trimmed();
 #ifdef BROWSERAPPLICATION_DEBUG
     qDebug() << "BrowserApplication::" << __FUNCTION__ << message;
 #endif
     if (message.isEmpty())
         return;
 
-    // Got a normal url
+    // Got normal urls, one per line
     if (!message.startsWith(QLatin1String("aroramessage://"))) {
-        QSettings settings;
-        settings.beginGroup(QLatin1String("tabs"));
-        TabWidget::OpenUrlIn tab = TabWidget::OpenUrlIn(settings.value(QLatin1String("openLinksFromAppsIn"), TabWidget::NewSelectedTab).toInt());
-        settings.endGroup();
-        if (QUrl(message) == m_lastAskedUrl
-                && m_lastAskedUrlDateTime.addSecs(10) > QDateTime::currentDateTime()) {
-            qWarning() << "Possible recursive openUrl called, ignoring url:" << m_lastAskedUrl;
-            return;
+        // With urls already pending openPendingUrls() is scheduled and
+        // picks these up with the rest, one batch per pass
+        bool scheduled = !m_pendingUrls.isEmpty();
+        foreach (const QString &url, message.split(QLatin1Char('\n'), QString::SkipEmptyParts)) {
+            QString trimmed = url.trimmed();
+            if (!trimmed.isEmpty())
+                m_pendingUrls.append(trimmed);
         }
-        mainWindow()->tabWidget()->loadString(message, tab);
+        if (!scheduled && !m_pendingUrls.isEmpty())
+            QTimer::singleShot(0, this, SLOT(openPendingUrls()));
         return;
     }
 
@@ -251,8 +266,7 @@ void BrowserApplication::messageReceived(QLocalSocket *socket)
         qDebug() << "BrowserApplication::" << __FUNCTION__ << "sending win id" << winid << mainWindow()->winId();
 #endif
         QString message = QLatin1String("aroramessage://winid/") + winid;
-        socket->write(message.toUtf8());
-        socket->waitForBytesWritten();
+        sendReply(socket, message.toUtf8());
         return;
     }
 
@@ -269,6 +283,35 @@ void BrowserApplication::messageReceived(QLocalSocket *socket)
     }
 }
 
+/*
+    Opens the urls other instances have sent a few at a time so that a
+    launcher passing in hundreds of them doesn't freeze the window.
+ */
+void BrowserApplication::openPendingUrls()
+{
+    if (m_pendingUrls.isEmpty())
+        return;
+
+    QSettings settings;
+    settings.beginGroup(QLatin1String("tabs"));
+    TabWidget::OpenUrlIn tab = TabWidget::OpenUrlIn(settings.value(QLatin1String("openLinksFromAppsIn"), TabWidget::NewSelectedTab).toInt());
+    settings.endGroup();
+
+    const int batchSize = 8;
+    for (int i = 0; i < batchSize && !m_pendingUrls.isEmpty(); ++i) {
+        QString url = m_pendingUrls.takeFirst();
+        if (QUrl(url) == m_lastAskedUrl
+                && m_lastAskedUrlDateTime.addSecs(10) > QDateTime::currentDateTime()) {
+            qWarning() << "Possible recursive openUrl called, ignoring url:" << m_lastAskedUrl;
+            continue;
+        }
+        mainWindow()->tabWidget()->loadString(url, tab);
+    }
+
+    if (!m_pendingUrls.isEmpty())
+        QTimer::singleShot(0, this, SLOT(openPendingUrls()));
+}
+
 void BrowserApplication::quitBrowser()
 {
     if (s_downloadManager && !downloadManager()->allowQuit())
@@ -309,8 +352,15 @@ void BrowserApplication::postLaunch()
     if (directory.isEmpty())
         directory = QDir::homePath() + QLatin1String("/.") + QCoreApplication::applicationName();
     QWebSettings::setIconDatabasePath(directory);
+    StartupTrace::mark(QLatin1String("icon database opened"));
 
     loadSettings();
+    StartupTrace::mark(QLatin1String("settings loaded"));
+
+    // History is only created here, after the window has been shown, but it
+    // has to exist before the first page is loaded so the visit is recorded.
+    historyManager();
+    StartupTrace::mark(QLatin1String("history loaded"));
 
     // newMainWindow() needs to be called in main() for this to happen
     if (m_mainWindows.count() > 0) {
@@ -344,7 +394,19 @@ void BrowserApplication::postLaunch()
             }
         }
     }
-    BrowserApplication::historyManager();
+    StartupTrace::mark(QLatin1String("session restored"));
+
+    // Everything below can wait until the first pages are on their way
+    QTimer::singleShot(0, this, SLOT(postLaunchIdle()));
+}
+
+void BrowserApplication::postLaunchIdle()
+{
+    // The download manager resumes the downloads that were interrupted
+    if (QSettings().value(QLatin1String("downloadmanager/resume"), false).toBool())
+        BrowserApplication::downloadManager();
+    networkAccessManager()->prefetchHosts(historyManager()->historyFilterModel()->mostFrecentHosts(10));
+    StartupTrace::mark(QLatin1String("idle tasks done"));
 }
 
 void BrowserApplication::loadSettings()
@@ -435,8 +497,35 @@ void BrowserApplication::saveSession()
 
     clean();
 
-    settings.beginGroup(QLatin1String("sessions"));
+    // Only what changed since the last time is written to the journal
+    if (!m_sessionJournal->isOpen()) {
+        m_sessionJournal->open(dataFilePath(QLatin1String("session.journal")));
+        settings.beginGroup(QLatin1String("sessions"));
+        settings.remove(QLatin1String("lastSession"));
+        settings.endGroup();
+    }
+
+    QList<quint32> windows;
+    for (int i = 0; i < m_mainWindows.count(); ++i) {
+        BrowserMainWindow *window = m_mainWindows.at(i);
+        quint32 id = window->m_sessionId;
+        windows.append(id);
+        QByteArray state = window->saveState(false);
+        if (state != m_sessionJournal->window(id).state)
+            m_sessionJournal->setWindowState(id, state);
+        window->tabWidget()->journalSession(m_sessionJournal, id);
+    }
+    if (windows != m_sessionJournal->windows())
+        m_sessionJournal->setWindows(windows);
+    m_sessionJournal->commit();
+}
 
+/*
+    Returns the session that was read from the journal in the format
+    restoreLastSession() expects.
+ */
+QByteArray BrowserApplication::journaledSession() const
+{
     int version = 2;
 
     QByteArray data;
@@ -447,11 +536,23 @@ void BrowserApplication::saveSession()
     stream << qint32(BrowserApplicationMagic);
     stream << qint32(version);
 
-    stream << qint32(m_mainWindows.count());
-    for (int i = 0; i < m_mainWindows.count(); ++i)
-        stream << m_mainWindows.at(i)->saveState();
-    settings.setValue(QLatin1String("lastSession"), data);
-    settings.endGroup();
+    QList<quint32> windows = m_sessionJournal->windows();
+    stream << qint32(windows.count());
+    foreach (quint32 id, windows) {
+        SessionJournal::Window window = m_sessionJournal->window(id);
+        QList<QUrl> urls;
+        QStringList titles;
+        QList<QByteArray> histories;
+        foreach (quint32 tabId, window.tabs) {
+            SessionJournal::Tab tab = m_sessionJournal->tab(tabId);
+            urls.append(tab.url);
+            titles.append(tab.title);
+            histories.append(tab.history);
+        }
+        QByteArray tabState = TabWidget::stateFromTabs(urls, histories, window.currentTab, titles);
+        stream << BrowserMainWindow::stateWithTabs(window.state, tabState);
+    }
+    return data;
 }
 
 bool BrowserApplication::canRestoreSession() const
@@ -494,6 +595,17 @@ bool BrowserApplication::restoreLastSession()
         stream >> windowState;
         windows.append(windowState);
     }
+
+    // Resolve the hosts of all the tabs in parallel before they start loading
+    QStringList hosts;
+    for (int i = 0; i < windows.count(); ++i) {
+        foreach (const QUrl &url, BrowserMainWindow::urlsFromState(windows.at(i))) {
+            if (url.scheme() == QLatin1String("http") || url.scheme() == QLatin1String("https"))
+                hosts.append(url.host());
+        }
+    }
+    networkAccessManager()->prefetchHosts(hosts);
+
     for (int i = 0; i < windows.count(); ++i) {
         BrowserMainWindow *newWindow = 0;
         if (i == 0 && m_mainWindows.count() >= 1) {
@@ -555,6 +667,7 @@ BrowserMainWindow *BrowserApplication::newMainWindow()
     m_mainWindows.prepend(browser);
     connect(this, SIGNAL(privacyChanged(bool)),
             browser, SLOT(privacyChanged(bool)));
+    StartupTrace::markFirstPaint(browser);
     browser->show();
     return browser;
 }
@@ -597,11 +710,26 @@ NetworkAccessManager *BrowserApplication::networkAccessManager()
 
 HistoryManager *BrowserApplication::historyManager()
 {
-    if (!s_historyManager)
+    if (!s_historyManager) {
         s_historyManager = new HistoryManager();
+        BrowserApplication *application = qobject_cast<BrowserApplication*>(QCoreApplication::instance());
+        if (application)
+            emit application->historyManagerCreated();
+    }
     return s_historyManager;
 }
 
+/*!
+    Returns true if the history has already been loaded.
+
+    Use this together with historyManagerCreated() to avoid loading
+    the history from code that runs at startup.
+ */
+bool BrowserApplication::hasHistoryManager()
+{
+    return s_historyManager != 0;
+}
+
 BookmarksManager *BrowserApplication::bookmarksManager()
 {
     if (!s_bookmarksManager)
@@ -631,6 +759,13 @@ AutoFillManager *BrowserApplication::autoFillManager()
     return s_autoFillManager;
 }
 
+ClosedTabStore *BrowserApplication::closedTabStore()
+{
+    if (!s_closedTabStore)
+        s_closedTabStore = new ClosedTabStore(dataFilePath(QLatin1String("closedtabs")));
+    return s_closedTabStore;
+}
+
 QIcon BrowserApplication::icon(const QUrl &url)
 {
     QIcon icon = QWebSettings::iconForUrl(url);
@@ -72,12 +72,14 @@
 class AutoFillManager;
 class BookmarksManager;
 class BrowserMainWindow;
+class ClosedTabStore;
 class CookieJar;
 class DownloadManager;
 class HistoryManager;
 class NetworkAccessManager;
 class LanguageManager;
 class QLocalSocket;
+class SessionJournal;
 class BrowserApplication : public SingleApplication
 {
     Q_OBJECT
@@ -98,12 +100,14 @@ public:
     bool canRestoreSession() const;
 
     static HistoryManager *historyManager();
+    static bool hasHistoryManager();
     static CookieJar *cookieJar();
     static DownloadManager *downloadManager();
     static NetworkAccessManager *networkAccessManager();
     static BookmarksManager *bookmarksManager();
     static LanguageManager *languageManager();
     static AutoFillManager *autoFillManager();
+    static ClosedTabStore *closedTabStore();
 
     static QString installedDataDirectory();
     static QString dataFilePath(const QString &fileName);
@@ -136,17 +140,21 @@ public slots:
 
 private slots:
     void retranslate();
-    void messageReceived(QLocalSocket *socket);
+    void messageReceived(QLocalSocket *socket, const QByteArray &message);
+    void openPendingUrls();
     void postLaunch();
+    void postLaunchIdle();
     void openUrl(const QUrl &url);
 
 signals:
     void zoomTextOnlyChanged(bool textOnly);
     void privacyChanged(bool isPrivate);
+    void historyManagerCreated();
 
 private:
     QString parseArgumentUrl(const QString &string) const;
     void clean();
+    QByteArray journaledSession() const;
 
     static HistoryManager *s_historyManager;
     static DownloadManager *s_downloadManager;
@@ -154,14 +162,17 @@ private:
     static BookmarksManager *s_bookmarksManager;
     static LanguageManager *s_languageManager;
     static AutoFillManager *s_autoFillManager;
+    static ClosedTabStore *s_closedTabStore;
 
     QList<QPointer<BrowserMainWindow> > m_mainWindows;
     QByteArray m_lastSession;
+    SessionJournal *m_sessionJournal;
     bool quitting;
 
     Qt::MouseButtons m_eventMouseButtons;
     Qt::KeyboardModifiers m_eventKeyboardModifiers;
 
+    QStringList m_pendingUrls;
     QUrl m_lastAskedUrl;
     QDateTime m_lastAskedUrlDateTime;
 };
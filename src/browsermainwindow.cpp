@@ -79,6 +79,7 @@
 #include "history.h"
 #include "languagemanager.h"
 #include "networkaccessmanager.h"
+#include "networkmonitordialog.h"
 #include "opensearchdialog.h"
 #include "settings.h"
 #include "sourceviewer.h"
@@ -122,6 +123,9 @@ BrowserMainWindow::BrowserMainWindow(QWidget *parent, Qt::WindowFlags flags)
     , m_tabWidget(new TabWidget(this))
     , m_autoSaver(new AutoSaver(this))
 {
+    static quint32 lastSessionId = 0;
+    m_sessionId = ++lastSessionId;
+
     setAttribute(Qt::WA_DeleteOnClose, true);
     statusBar()->setSizeGripEnabled(true);
     // fixes https://bugzilla.mozilla.org/show_bug.cgi?id=219070
@@ -432,6 +436,74 @@ bool BrowserMainWindow::restoreState(const QByteArray &state)
     return true;
 }
 
+/*!
+    Returns the urls of the tabs in \a state without restoring the window.
+ */
+QList<QUrl> BrowserMainWindow::urlsFromState(const QByteArray &state)
+{
+    QDataStream stream(state);
+    if (stream.atEnd())
+        return QList<QUrl>();
+
+    qint32 marker;
+    qint32 version;
+    stream >> marker;
+    stream >> version;
+    if (marker != BrowserMainWindowMagic || !(version == 2 || version == 3))
+        return QList<QUrl>();
+
+    QSize size;
+    bool showToolbarDEAD;
+    bool showBookmarksBarDEAD;
+    bool showStatusbar;
+    QByteArray tabState;
+    stream >> size;
+    stream >> showToolbarDEAD;
+    stream >> showBookmarksBarDEAD;
+    stream >> showStatusbar;
+    stream >> tabState;
+    return TabWidget::urlsFromState(tabState);
+}
+
+/*!
+    Returns \a state, which was saved without the tabs, with \a tabState
+    as the state of the tabs.
+ */
+QByteArray BrowserMainWindow::stateWithTabs(const QByteArray &state, const QByteArray &tabState)
+{
+    QDataStream stream(state);
+    qint32 marker;
+    qint32 version;
+    stream >> marker;
+    stream >> version;
+    if (marker != BrowserMainWindowMagic || !(version == 2 || version == 3))
+        return state;
+
+    QSize size;
+    bool showToolbarDEAD;
+    bool showBookmarksBarDEAD;
+    bool showStatusbar;
+    QByteArray oldTabState;
+    stream >> size;
+    stream >> showToolbarDEAD;
+    stream >> showBookmarksBarDEAD;
+    stream >> showStatusbar;
+    stream >> oldTabState;
+
+    QByteArray data;
+    QDataStream newStream(&data, QIODevice::WriteOnly);
+    newStream << marker;
+    newStream << version;
+    newStream << size;
+    newStream << showToolbarDEAD;
+    newStream << showBookmarksBarDEAD;
+    newStream << showStatusbar;
+    newStream << tabState;
+    // The rest stays as it is
+    data += state.mid(stream.device()->pos());
+    return data;
+}
+
 void BrowserMainWindow::lastTabClosed()
 {
     QSettings settings;
@@ -844,6 +916,11 @@ void BrowserMainWindow::setupMenu()
             AdBlockManager::instance(), SLOT(showDialog()));
     m_toolsMenu->addAction(m_adBlockDialogAction);
 
+    m_toolsNetworkMonitorAction = new QAction(m_toolsMenu);
+    connect(m_toolsNetworkMonitorAction, SIGNAL(triggered()),
+            this, SLOT(showNetworkMonitor()));
+    m_toolsMenu->addAction(m_toolsNetworkMonitorAction);
+
     m_toolsMenu->addSeparator();
     m_toolsPreferencesAction = new QAction(m_toolsMenu);
     m_toolsPreferencesAction->setMenuRole(QAction::PreferencesRole);
@@ -1001,6 +1078,7 @@ void BrowserMainWindow::retranslate()
     m_toolsSearchManagerAction->setText(tr("Configure Search Engines..."));
     m_toolsUserAgentMenu->setTitle(tr("User Agent"));
     m_adBlockDialogAction->setText(tr("&Ad Block..."));
+    m_toolsNetworkMonitorAction->setText(tr("Network &Monitor..."));
 
     m_helpMenu->setTitle(tr("&Help"));
     m_helpChangeLanguageAction->setText(tr("Switch application language "));
@@ -1498,6 +1576,13 @@ void BrowserMainWindow::showSearchDialog()
     dialog.exec();
 }
 
+void BrowserMainWindow::showNetworkMonitor()
+{
+    NetworkMonitorDialog *dialog = new NetworkMonitorDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
 void BrowserMainWindow::aboutToShowBackMenu()
 {
     m_historyBackMenu->clear();
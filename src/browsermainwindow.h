@@ -64,6 +64,7 @@
 #define BROWSERMAINWINDOW_H
 
 #include <qmainwindow.h>
+#include <qurl.h>
 
 class AutoSaver;
 class BookmarksToolBar;
@@ -99,6 +100,8 @@ public:
     ToolbarSearch *toolbarSearch() const;
     QByteArray saveState(bool withTabs = true) const;
     bool restoreState(const QByteArray &state);
+    static QList<QUrl> urlsFromState(const QByteArray &state);
+    static QByteArray stateWithTabs(const QByteArray &state, const QByteArray &tabState);
     QAction *showMenuBarAction() const;
     QAction *searchManagerAction() const { return m_toolsSearchManagerAction; }
 
@@ -161,6 +164,7 @@ private slots:
     void aboutToShowTextEncodingMenu();
     void openActionUrl(QAction *action);
     void showSearchDialog();
+    void showNetworkMonitor();
     void showWindow();
     void swapFocus();
 
@@ -236,6 +240,7 @@ private:
     QAction *m_toolsSearchManagerAction;
     UserAgentMenu *m_toolsUserAgentMenu;
     QAction *m_adBlockDialogAction;
+    QAction *m_toolsNetworkMonitorAction;
 
     QMenu *m_helpMenu;
     QAction *m_helpChangeLanguageAction;
@@ -259,6 +264,7 @@ private:
     TabWidget *m_tabWidget;
 
     AutoSaver *m_autoSaver;
+    quint32 m_sessionId;
 
     // These store if the user requested the menu/status bars visible. They are
     // used to determine if these bars should be reshown when leaving fullscreen.
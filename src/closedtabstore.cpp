@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "closedtabstore.h"
+
+#include "autosaver.h"
+#include "browserapplication.h"
+
+#include <qdatastream.h>
+
+#include <qdebug.h>
+
+static const qint32 ClosedTabStoreMagic = 0xc7;
+
+ClosedTabStore::ClosedTabStore(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_autoSaver(new AutoSaver(this))
+    , m_fileName(fileName)
+    , m_dataFile(fileName + QLatin1String(".data"))
+    , m_nextId(1)
+    , m_maximumCount(10)
+    , m_memoryBudget(512 * 1024)
+    , m_memoryUsage(0)
+{
+    connect(this, SIGNAL(changed()),
+            m_autoSaver, SLOT(changeOccurred()));
+    connect(BrowserApplication::instance(), SIGNAL(privacyChanged(bool)),
+            this, SLOT(privacyChanged(bool)));
+    load();
+}
+
+ClosedTabStore::~ClosedTabStore()
+{
+    m_autoSaver->saveIfNeccessary();
+}
+
+int ClosedTabStore::maximumCount() const
+{
+    return m_maximumCount;
+}
+
+void ClosedTabStore::setMaximumCount(int count)
+{
+    m_maximumCount = qMax(0, count);
+    if (m_entries.count() > m_maximumCount) {
+        trim();
+        emit changed();
+    }
+}
+
+int ClosedTabStore::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+/*!
+    Sets how many bytes of compressed history are kept in memory before
+    the oldest are moved to the data file.
+ */
+void ClosedTabStore::setMemoryBudget(int bytes)
+{
+    m_memoryBudget = qMax(0, bytes);
+    trim();
+}
+
+int ClosedTabStore::memoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+bool ClosedTabStore::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+int ClosedTabStore::count() const
+{
+    return m_entries.count();
+}
+
+QUrl ClosedTabStore::url(int index) const
+{
+    if (index < 0 || index >= m_entries.count())
+        return QUrl();
+    return m_entries.at(index).url;
+}
+
+/*!
+    Returns an id for the tab at \a index that doesn't change when other
+    tabs are added or taken.
+ */
+quint32 ClosedTabStore::id(int index) const
+{
+    if (index < 0 || index >= m_entries.count())
+        return 0;
+    return m_entries.at(index).id;
+}
+
+int ClosedTabStore::indexOf(quint32 id) const
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).id == id)
+            return i;
+    }
+    return -1;
+}
+
+void ClosedTabStore::prepend(const QUrl &url, const QByteArray &history)
+{
+    Entry entry;
+    entry.id = m_nextId++;
+    entry.url = url;
+    entry.isPrivate = BrowserApplication::isPrivate();
+    if (!history.isEmpty()) {
+        entry.data = qCompress(history);
+        entry.size = entry.data.size();
+        m_memoryUsage += entry.size;
+    }
+    m_entries.prepend(entry);
+    trim();
+    emit changed();
+}
+
+/*!
+    Removes the tab at \a index and returns it with its history, reading
+    the history back from the data file if it was moved there.
+ */
+ClosedTabStore::Tab ClosedTabStore::take(int index)
+{
+    Tab tab;
+    if (index < 0 || index >= m_entries.count())
+        return tab;
+
+    Entry entry = m_entries.takeAt(index);
+    m_memoryUsage -= entry.data.size();
+    tab.url = entry.url;
+
+    QByteArray data = entry.data;
+    if (data.isEmpty() && entry.offset >= 0
+        && openDataFile() && m_dataFile.seek(entry.offset)) {
+        data = m_dataFile.read(entry.size);
+        if (data.size() != entry.size)
+            data.clear();
+    }
+    if (!data.isEmpty())
+        tab.history = qUncompress(data);
+
+    emit changed();
+    return tab;
+}
+
+void ClosedTabStore::clear()
+{
+    m_entries.clear();
+    m_memoryUsage = 0;
+    m_dataFile.close();
+    QFile::remove(m_dataFile.fileName());
+    QFile::remove(m_fileName);
+    emit changed();
+}
+
+/*!
+    Writes the histories that are only in memory to the data file and
+    the urls with where to find their histories to the store.
+
+    Tabs closed while browsing privately are left out.
+ */
+void ClosedTabStore::save()
+{
+    int count = 0;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        Entry &entry = m_entries[i];
+        if (entry.isPrivate)
+            continue;
+        if (entry.offset < 0 && !entry.data.isEmpty())
+            writeToDataFile(entry);
+        ++count;
+    }
+    compactDataFile();
+    m_dataFile.flush();
+
+    QFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "ClosedTabStore: Unable to open" << m_fileName << file.errorString();
+        return;
+    }
+    QDataStream stream(&file);
+    stream << ClosedTabStoreMagic;
+    stream << qint32(1);
+    stream << qint32(count);
+    foreach (const Entry &entry, m_entries) {
+        if (!entry.isPrivate)
+            stream << entry.url << entry.offset << entry.size;
+    }
+}
+
+/*
+    The tabs closed while browsing privately are forgotten once private
+    browsing is turned off.
+ */
+void ClosedTabStore::privacyChanged(bool isPrivate)
+{
+    if (isPrivate)
+        return;
+    bool removed = false;
+    for (int i = m_entries.count() - 1; i >= 0; --i) {
+        if (!m_entries.at(i).isPrivate)
+            continue;
+        m_memoryUsage -= m_entries.takeAt(i).data.size();
+        removed = true;
+    }
+    if (removed)
+        emit changed();
+}
+
+void ClosedTabStore::load()
+{
+    QFile file(m_fileName);
+    if (!file.open(QFile::ReadOnly))
+        return;
+    QDataStream stream(&file);
+    qint32 magic;
+    qint32 version;
+    qint32 count;
+    stream >> magic;
+    stream >> version;
+    stream >> count;
+    if (magic != ClosedTabStoreMagic || version != 1)
+        return;
+
+    for (int i = 0; i < count && !stream.atEnd(); ++i) {
+        Entry entry;
+        stream >> entry.url >> entry.offset >> entry.size;
+        if (stream.status() != QDataStream::Ok)
+            break;
+        entry.id = m_nextId++;
+        m_entries.append(entry);
+    }
+    trim();
+}
+
+/*
+    Drops the tabs over the maximum count and moves the oldest histories
+    out of memory until the rest fit in the budget.
+ */
+void ClosedTabStore::trim()
+{
+    while (m_entries.count() > m_maximumCount)
+        m_memoryUsage -= m_entries.takeLast().data.size();
+
+    for (int i = m_entries.count() - 1; i >= 0 && m_memoryUsage > m_memoryBudget; --i) {
+        Entry &entry = m_entries[i];
+        if (entry.data.isEmpty())
+            continue;
+        // The history of a tab closed while browsing privately is dropped
+        // rather than written out, the tab can still be opened from its url
+        if (entry.offset < 0 && !entry.isPrivate)
+            writeToDataFile(entry);
+        m_memoryUsage -= entry.data.size();
+        entry.data = QByteArray();
+    }
+}
+
+bool ClosedTabStore::openDataFile()
+{
+    if (m_dataFile.isOpen())
+        return true;
+    if (!m_dataFile.open(QFile::ReadWrite | QFile::Unbuffered)) {
+        qWarning() << "ClosedTabStore: Unable to open" << m_dataFile.fileName() << m_dataFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ClosedTabStore::writeToDataFile(Entry &entry)
+{
+    if (!openDataFile())
+        return false;
+    qint64 offset = m_dataFile.size();
+    if (!m_dataFile.seek(offset)
+        || m_dataFile.write(entry.data) != entry.data.size())
+        return false;
+    entry.offset = offset;
+    entry.size = entry.data.size();
+    return true;
+}
+
+/*
+    The histories of tabs that were taken or dropped stay in the data
+    file until they take up more room than the ones that are still in
+    the store.
+ */
+void ClosedTabStore::compactDataFile()
+{
+    qint64 live = 0;
+    foreach (const Entry &entry, m_entries) {
+        if (entry.offset >= 0)
+            live += entry.size;
+    }
+    qint64 garbage = m_dataFile.size() - live;
+    if (garbage < 64 * 1024 || garbage < live)
+        return;
+    if (!openDataFile())
+        return;
+
+    QList<QByteArray> histories;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        const Entry &entry = m_entries.at(i);
+        QByteArray data;
+        if (entry.offset >= 0 && m_dataFile.seek(entry.offset))
+            data = m_dataFile.read(entry.size);
+        histories.append(data);
+    }
+
+    m_dataFile.resize(0);
+    for (int i = 0; i < m_entries.count(); ++i) {
+        Entry &entry = m_entries[i];
+        if (entry.offset < 0)
+            continue;
+        entry.offset = -1;
+        if (histories.at(i).size() != entry.size)
+            continue;
+        qint64 offset = m_dataFile.size();
+        if (m_dataFile.seek(offset) && m_dataFile.write(histories.at(i)) == entry.size)
+            entry.offset = offset;
+    }
+}
+
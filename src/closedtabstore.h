@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef CLOSEDTABSTORE_H
+#define CLOSEDTABSTORE_H
+
+#include <qobject.h>
+
+#include <qfile.h>
+#include <qlist.h>
+#include <qurl.h>
+
+/*
+    Remembers the tabs that were closed so they can be opened again.
+
+    The history of every tab is kept compressed.  Once the histories in
+    memory add up to more than the memory budget the oldest ones are
+    moved to a data file next to the store and only read back when their
+    tab is opened again.  The store is saved with all of the histories in
+    the data file, so after a restart the store reads only the urls.
+*/
+class AutoSaver;
+class ClosedTabStore : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void changed();
+
+public:
+    struct Tab {
+        QUrl url;
+        QByteArray history;
+    };
+
+    ClosedTabStore(const QString &fileName, QObject *parent = 0);
+    ~ClosedTabStore();
+
+    int maximumCount() const;
+    void setMaximumCount(int count);
+    int memoryBudget() const;
+    void setMemoryBudget(int bytes);
+    int memoryUsage() const;
+
+    bool isEmpty() const;
+    int count() const;
+    QUrl url(int index) const;
+    quint32 id(int index) const;
+    int indexOf(quint32 id) const;
+
+    void prepend(const QUrl &url, const QByteArray &history);
+    Tab take(int index);
+
+public slots:
+    void clear();
+    void save();
+
+private slots:
+    void privacyChanged(bool isPrivate);
+
+private:
+    struct Entry {
+        Entry() : id(0), offset(-1), size(0), isPrivate(false) {}
+        quint32 id;
+        QUrl url;
+        QByteArray data;
+        qint64 offset;
+        qint32 size;
+        bool isPrivate;
+    };
+
+    void load();
+    void trim();
+    bool writeToDataFile(Entry &entry);
+    bool openDataFile();
+    void compactDataFile();
+
+    AutoSaver *m_autoSaver;
+    QString m_fileName;
+    QFile m_dataFile;
+    QList<Entry> m_entries;
+    quint32 m_nextId;
+    int m_maximumCount;
+    int m_memoryBudget;
+    int m_memoryUsage;
+};
+
+#endif // CLOSEDTABSTORE_H
+
@@ -0,0 +1,76 @@
+(function (){
+    if ('__aroraTimersBusy' in window)
+        return;
+    // The page's control object is only reachable from this closure,
+    // content sees nothing but the read only busy counter
+    var control = window.__aroraTimers;
+    delete window.__aroraTimers;
+    var busy = 0;
+    var intervals = {};
+    var nextInterval = 0x40000000;
+    var setTimeout = window.setTimeout;
+    var clearTimeout = window.clearTimeout;
+    var clearInterval = window.clearInterval;
+    window.__defineGetter__('__aroraTimersBusy', function () { return busy; });
+
+    function minimum() {
+        return control ? control.minimum : 0;
+    }
+
+    function delayFor(delay) {
+        return Math.max(Number(delay) || 0, minimum());
+    }
+
+    function callable(handler) {
+        return typeof handler == 'function' ? handler : new Function(handler);
+    }
+
+    function run(handler, self, args) {
+        var start = new Date().getTime();
+        try {
+            return handler.apply(self, args);
+        } finally {
+            busy += new Date().getTime() - start;
+        }
+    }
+
+    window.setTimeout = function (handler, delay) {
+        var args = Array.prototype.slice.call(arguments, 2);
+        handler = callable(handler);
+        return setTimeout.call(window, function () { return run(handler, window, args); },
+                               delayFor(delay));
+    };
+
+    // Intervals are a chain of timeouts so every tick is re-armed with
+    // the minimum in effect at that time
+    window.setInterval = function (handler, delay) {
+        var args = Array.prototype.slice.call(arguments, 2);
+        var id = nextInterval++;
+        handler = callable(handler);
+        function tick() {
+            intervals[id] = setTimeout.call(window, tick, delayFor(delay));
+            run(handler, window, args);
+        }
+        intervals[id] = setTimeout.call(window, tick, delayFor(delay));
+        return id;
+    };
+
+    function clear(id) {
+        if (id in intervals) {
+            clearTimeout.call(window, intervals[id]);
+            delete intervals[id];
+            return true;
+        }
+        return false;
+    }
+
+    window.clearInterval = function (id) {
+        if (!clear(id))
+            clearInterval.call(window, id);
+    };
+
+    window.clearTimeout = function (id) {
+        if (!clear(id))
+            clearTimeout.call(window, id);
+    };
+})();
@@ -65,7 +65,10 @@
 
 #include "autosaver.h"
 #include "browserapplication.h"
+#include "browsermainwindow.h"
+#include "downloadwriter.h"
 #include "networkaccessmanager.h"
+#include "webview.h"
 
 #include <math.h>
 
@@ -78,6 +81,7 @@
 #include <qmimedata.h>
 #include <qprocess.h>
 #include <qsettings.h>
+#include <qtimer.h>
 
 #include <qdebug.h>
 
@@ -85,6 +89,25 @@
 
 //#define DOWNLOADMANAGER_DEBUG
 
+// Smallest range worth a connection of its own
+static const qint64 minimumSegmentSize = 1024 * 1024;
+
+// What a reply may buffer while the writer catches up with the disk
+static const qint64 readBufferSize = 512 * 1024;
+
+// How often the scheduler hands out bandwidth, in milliseconds
+static const int scheduleInterval = 100;
+
+// Downloads stop yielding to a page that takes longer than this to load
+static const int maximumYieldTime = 10 * 1000;
+
+static bool preallocateDownloads()
+{
+    QSettings settings;
+    settings.beginGroup(QLatin1String("downloadmanager"));
+    return settings.value(QLatin1String("preallocate"), true).toBool();
+}
+
 /*!
     DownloadItem is a widget that is displayed in the download manager list.
     It moves the data from the QNetworkReply into the QFile as well
@@ -93,12 +116,22 @@
 DownloadItem::DownloadItem(QNetworkReply *reply, bool requestFileName, QWidget *parent)
     : QWidget(parent)
     , m_reply(reply)
+    , m_writer(0)
+    , m_writePosition(0)
     , m_requestFileName(requestFileName)
+    , m_keepFileName(false)
     , m_bytesReceived(0)
     , m_startedSaving(false)
     , m_finishedDownloading(false)
     , m_gettingFileName(false)
     , m_canceledFileSelect(false)
+    , m_lastProgressUpdate(-1)
+    , m_useRanges(true)
+    , m_resuming(false)
+    , m_resumeOffset(0)
+    , m_priority(0)
+    , m_scheduleState(Downloading)
+    , m_tokens(-1)
 {
     setupUi(this);
     QPalette p = downloadInfoLabel->palette();
@@ -132,6 +165,7 @@ void DownloadItem::init()
     // attach to the m_reply
     m_url = m_reply->url();
     m_reply->setParent(this);
+    m_reply->setReadBufferSize(readBufferSize);
     connect(m_reply, SIGNAL(readyRead()), this, SLOT(downloadReadyRead()));
     connect(m_reply, SIGNAL(error(QNetworkReply::NetworkError)),
             this, SLOT(error(QNetworkReply::NetworkError)));
@@ -145,20 +179,26 @@ void DownloadItem::init()
     // reset info
     downloadInfoLabel->clear();
     progressBar->setValue(0);
-    getFileName();
+    if (!m_resuming)
+        getFileName();
 
-    // start timer for the download estimation
-    m_downloadTime.start();
+    // Only count what this request transfers towards the speed
+    m_rateEstimator.start();
+    m_lastProgressUpdate = -1;
 
     if (m_reply->error() != QNetworkReply::NoError) {
         error(m_reply->error());
         finished();
+    } else if (m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid()) {
+        readValidators();
+        startSegments();
     }
 }
 
 void DownloadItem::getFileName()
 {
-    if (m_gettingFileName)
+    // Downloads restored from the last session keep where they were saved
+    if (m_gettingFileName || m_keepFileName)
         return;
 
     QString downloadDirectory = BrowserApplication::downloadManager()->downloadDirectory();
@@ -249,7 +289,13 @@ void DownloadItem::stop()
     tryAgainButton->setEnabled(true);
     tryAgainButton->show();
     setUpdatesEnabled(true);
-    m_reply->abort();
+    if (!m_segments.isEmpty()) {
+        abortSegments();
+        closeOutput();
+        downloadInfoLabel->setText(tr("Network Error: %1").arg(m_reply->errorString()));
+    } else {
+        m_reply->abort();
+    }
     emit downloadFinished();
 }
 
@@ -270,12 +316,45 @@ void DownloadItem::tryAgain()
     stopButton->setEnabled(true);
     stopButton->setVisible(true);
     progressBar->setVisible(true);
+    restart();
+}
 
-    QNetworkReply *r = BrowserApplication::networkAccessManager()->get(QNetworkRequest(m_url));
+/*!
+    Starts the download again, picking up where it left off when the server
+    told us enough about the file to ask for the missing ranges of it.
+ */
+void DownloadItem::restart()
+{
+    QList<Range> missing;
+    if (canResume())
+        missing = missingRanges();
+    abortSegments();
+    closeOutput();
+    m_missing.clear();
+    m_resumeOffset = 0;
+    m_resuming = (!missing.isEmpty() && missing.first().first > 0) || missing.count() > 1;
+
+    QNetworkRequest request(m_url);
+    if (m_resuming) {
+        m_missing = missing;
+        m_resumeOffset = missing.first().first;
+        QByteArray range = "bytes=" + QByteArray::number(m_resumeOffset) + '-';
+        if (missing.first().second != -1)
+            range += QByteArray::number(missing.first().second - 1);
+        request.setRawHeader("Range", range);
+        request.setRawHeader("If-Range", validator());
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+#ifdef DOWNLOADMANAGER_DEBUG
+        qDebug() << "DownloadItem::" << __FUNCTION__ << "resuming" << m_url << missing;
+#endif
+    } else if (m_output.exists()) {
+        m_output.remove();
+    }
+
+    QNetworkReply *r = BrowserApplication::networkAccessManager()->get(request);
     if (m_reply)
         m_reply->deleteLater();
-    if (m_output.exists())
-        m_output.remove();
     m_reply = r;
     init();
     emit statusChanged();
@@ -285,28 +364,396 @@ void DownloadItem::downloadReadyRead()
 {
     if (m_requestFileName && m_output.fileName().isEmpty())
         return;
-    if (!m_output.isOpen()) {
-        // in case someone else has already put a file there
-        if (!m_requestFileName)
-            getFileName();
-        if (!m_output.open(QIODevice::WriteOnly)) {
-            downloadInfoLabel->setText(tr("Error opening output file: %1")
-                    .arg(m_output.errorString()));
-            stop();
-            emit statusChanged();
+    if (!m_writer && !openOutput())
+        return;
+    // Carries on once the writer has caught up or the scheduler allows it
+    qint64 limit = m_reply->bytesAvailable();
+    if (!m_finishedDownloading) {
+        limit = qMin(limit, readAllowance());
+        if (m_writer->isFull() || limit == 0)
             return;
-        }
+    }
+    QByteArray data = m_reply->read(limit);
+    consumeAllowance(data.size());
+    m_rateEstimator.addBytes(data.size());
+    m_writer->write(m_writePosition, data);
+    m_writePosition += data.size();
+    m_startedSaving = true;
+    if (m_finishedDownloading)
+        finished();
+}
+
+bool DownloadItem::openOutput()
+{
+    // in case someone else has already put a file there
+    if (!m_requestFileName && !m_resuming)
+        getFileName();
+    m_writer = new DownloadWriter(this);
+    connect(m_writer, SIGNAL(bytesWritten(qint64)), this, SLOT(writerBytesWritten()));
+    connect(m_writer, SIGNAL(error(const QString &)), this, SLOT(writerError(const QString &)));
+    QIODevice::OpenMode mode = m_resuming ? QIODevice::ReadWrite : QIODevice::WriteOnly;
+    if (!m_writer->open(m_output.fileName(), mode)) {
+        downloadInfoLabel->setText(tr("Error opening output file: %1")
+                .arg(m_writer->errorString()));
+        delete m_writer;
+        m_writer = 0;
+        stop();
         emit statusChanged();
+        return false;
+    }
+    m_writePosition = m_resuming ? m_resumeOffset : 0;
+    qint64 total = bytesTotal();
+    if (total > m_writePosition && preallocateDownloads())
+        m_writer->preallocate(total, true);
+    emit statusChanged();
+    return true;
+}
+
+void DownloadItem::closeOutput()
+{
+    delete m_writer;
+    m_writer = 0;
+}
+
+void DownloadItem::writerBytesWritten()
+{
+    readAvailable();
+}
+
+/*
+    Picks up the data that was left in the replies while the writer was
+    busy or the scheduler held the download back.
+ */
+void DownloadItem::readAvailable()
+{
+    if (m_writer && m_writer->isFull())
+        return;
+
+    if (m_segments.isEmpty()) {
+        if (m_reply && m_reply->bytesAvailable() > 0)
+            downloadReadyRead();
+        return;
     }
-    if (-1 == m_output.write(m_reply->readAll())) {
-        downloadInfoLabel->setText(tr("Error saving: %1")
-                .arg(m_output.errorString()));
+    for (int i = 0; i < m_segments.count(); ++i) {
+        if (m_segments.at(i).reply && m_segments.at(i).reply->bytesAvailable() > 0)
+            readSegment(i);
+    }
+}
+
+void DownloadItem::writerError(const QString &errorString)
+{
+    downloadInfoLabel->setText(tr("Error saving: %1").arg(errorString));
+    if (stopButton->isEnabled())
         stopButton->click();
+}
+
+/*!
+    Remembers what identifies this version of the file so that a later
+    range request can be checked against it with If-Range.
+ */
+void DownloadItem::readValidators()
+{
+    int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (m_resuming && status != 206) {
+        // The file changed on the server, start from the beginning
+        m_resuming = false;
+        m_resumeOffset = 0;
+        m_missing.clear();
+        closeOutput();
+        m_output.remove();
+    }
+    if (status == 200) {
+        m_etag = m_reply->rawHeader("ETag");
+        m_lastModified = m_reply->rawHeader("Last-Modified");
+    }
+}
+
+QByteArray DownloadItem::validator() const
+{
+    // If-Range only works with strong entity tags
+    if (!m_etag.isEmpty() && !m_etag.startsWith("W/"))
+        return m_etag;
+    return m_lastModified;
+}
+
+bool DownloadItem::canResume() const
+{
+    if (!m_useRanges || validator().isEmpty() || !m_output.exists())
+        return false;
+    return m_url.scheme() == QLatin1String("http") || m_url.scheme() == QLatin1String("https");
+}
+
+/*!
+    Returns the byte ranges of the file that are not on the disk yet.  A
+    range that runs to the end of the file has an end of -1.
+ */
+QList<DownloadItem::Range> DownloadItem::missingRanges() const
+{
+    QList<Range> missing;
+    if (!m_segments.isEmpty()) {
+        foreach (const Segment &segment, m_segments) {
+            // Only count what made it to the disk
+            qint64 position = m_writer ? m_writer->flushedPosition(segment.position) : segment.position;
+            if (position < segment.end)
+                missing.append(Range(position, segment.end));
+        }
+    } else if (!m_missing.isEmpty() && m_missing.first().second != -1) {
+        missing = m_missing;
+    } else if (!downloadedSuccessfully()) {
+        missing.append(Range(m_output.size(), -1));
+    }
+    return missing;
+}
+
+/*!
+    Splits what is left of the download into byte ranges that are fetched
+    in parallel and written at their offsets into the output file.  This is
+    only done when the server accepts ranges and the file is large enough,
+    or when resuming a download that was split before.
+    The original request carries on with the first range.
+ */
+void DownloadItem::startSegments()
+{
+    if (!m_useRanges || !m_segments.isEmpty() || m_finishedDownloading
+        || m_canceledFileSelect || m_output.fileName().isEmpty())
+        return;
+    if (m_url.scheme() != QLatin1String("http") && m_url.scheme() != QLatin1String("https"))
+        return;
+    if (!m_reply->rawHeader("Content-Encoding").isEmpty())
+        return;
+
+    int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qint64 total = bytesTotal();
+    QList<Range> ranges;
+    if (m_resuming && status == 206 && m_missing.first().second != -1) {
+        ranges = m_missing;
     } else {
+        if (status != 200 || !m_reply->rawHeader("Accept-Ranges").contains("bytes"))
+            return;
+        QSettings settings;
+        settings.beginGroup(QLatin1String("downloadmanager"));
+        int count = settings.value(QLatin1String("segments"), 4).toInt();
+        qint64 offset = m_writer ? m_writePosition : 0;
+        count = int(qMin(qint64(count), (total - offset) / minimumSegmentSize));
+        if (count < 2)
+            return;
+        qint64 segmentSize = (total - offset) / count;
+        for (int i = 0; i < count; ++i) {
+            qint64 start = offset + i * segmentSize;
+            ranges.append(Range(start, (i == count - 1) ? total : start + segmentSize));
+        }
+    }
+
+    if (!m_writer && !openOutput())
+        return;
+    if (preallocateDownloads())
+        m_writer->preallocate(total, false);
+
+#ifdef DOWNLOADMANAGER_DEBUG
+    qDebug() << "DownloadItem::" << __FUNCTION__ << m_url << ranges;
+#endif
+
+    disconnect(m_reply, 0, this, 0);
+    m_missing.clear();
+    for (int i = 0; i < ranges.count(); ++i) {
+        Segment segment;
+        segment.position = ranges.at(i).first;
+        segment.end = ranges.at(i).second;
+        if (i == 0) {
+            segment.reply = m_reply;
+        } else {
+            QNetworkRequest request(m_url);
+            request.setRawHeader("Range", "bytes=" + QByteArray::number(segment.position)
+                                 + '-' + QByteArray::number(segment.end - 1));
+            // Only take ranges of the same version of the file
+            if (!validator().isEmpty())
+                request.setRawHeader("If-Range", validator());
+            request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+            request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+            segment.reply = BrowserApplication::networkAccessManager()->get(request);
+            segment.reply->setParent(this);
+            segment.reply->setReadBufferSize(readBufferSize);
+        }
+        connect(segment.reply, SIGNAL(readyRead()), this, SLOT(segmentReadyRead()));
+        connect(segment.reply, SIGNAL(finished()), this, SLOT(segmentFinished()));
+        m_segments.append(segment);
+    }
+
+    // The original request might already have data waiting
+    readSegment(0);
+}
+
+void DownloadItem::readSegment(int index, bool force)
+{
+    Segment &segment = m_segments[index];
+    if (!segment.reply
+        || (!force && (m_writer->isFull() || readAllowance() == 0)))
+        return;
+
+    if (segment.reply != m_reply) {
+        QVariant status = segment.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+        int code = status.toInt();
+        if (status.isValid() && code >= 200 && code < 300 && code != 206) {
+            // The server ignored the range, start over with a single request
+            m_useRanges = false;
+            restart();
+            return;
+        }
+        // Errors and refused connections are left for segmentFinished()
+        // to fail the download keeping what is missing
+        if (code != 206)
+            return;
+    }
+
+    qint64 limit = segment.end - segment.position;
+    if (!force)
+        limit = qMin(limit, readAllowance());
+    QByteArray data = segment.reply->read(qMin(limit, segment.reply->bytesAvailable()));
+    consumeAllowance(data.size());
+    m_rateEstimator.addBytes(data.size());
+    if (!data.isEmpty()) {
+        m_writer->write(segment.position, data);
+        segment.position += data.size();
         m_startedSaving = true;
-        if (m_finishedDownloading)
-            finished();
     }
+
+    if (segment.position >= segment.end) {
+        // The original request would carry on to the end of the file
+        disconnect(segment.reply, 0, this, 0);
+        segment.reply->abort();
+        if (segment.reply != m_reply)
+            segment.reply->deleteLater();
+        segment.reply = 0;
+    }
+
+    qint64 total = bytesTotal();
+    qint64 received = total;
+    bool done = true;
+    foreach (const Segment &range, m_segments) {
+        received -= range.end - range.position;
+        if (range.reply)
+            done = false;
+    }
+    m_bytesReceived = received;
+    downloadProgress(received, total);
+    if (done) {
+        progressBar->setMaximum(100);
+        progressBar->setValue(100);
+        finished();
+    }
+}
+
+void DownloadItem::segmentReadyRead()
+{
+    for (int i = 0; i < m_segments.count(); ++i) {
+        if (m_segments.at(i).reply == sender()) {
+            readSegment(i);
+            return;
+        }
+    }
+}
+
+void DownloadItem::segmentFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    for (int i = 0; i < m_segments.count(); ++i) {
+        if (m_segments.at(i).reply != reply)
+            continue;
+        // Reading what is left completes the segment if all of it arrived
+        readSegment(i, true);
+        if (i < m_segments.count() && m_segments.at(i).reply == reply)
+            segmentFailed(reply->error() != QNetworkReply::NoError
+                          ? reply->errorString() : tr("Connection closed"));
+        return;
+    }
+}
+
+void DownloadItem::segmentFailed(const QString &errorString)
+{
+#ifdef DOWNLOADMANAGER_DEBUG
+    qDebug() << "DownloadItem::" << __FUNCTION__ << errorString << m_url;
+#endif
+
+    abortSegments();
+    downloadInfoLabel->setText(tr("Network Error: %1").arg(errorString));
+    tryAgainButton->setEnabled(true);
+    tryAgainButton->setVisible(true);
+    emit downloadFinished();
+    finished();
+}
+
+void DownloadItem::abortSegments()
+{
+    // Keep what is missing so the download can be resumed
+    if (!m_segments.isEmpty())
+        m_missing = missingRanges();
+    foreach (const Segment &segment, m_segments) {
+        if (!segment.reply)
+            continue;
+        disconnect(segment.reply, 0, this, 0);
+        segment.reply->abort();
+        if (segment.reply != m_reply)
+            segment.reply->deleteLater();
+    }
+    m_segments.clear();
+}
+
+DownloadItem::State DownloadItem::state() const
+{
+    if (downloadedSuccessfully())
+        return Finished;
+    if (tryAgainButton->isEnabled())
+        return Failed;
+    return m_scheduleState;
+}
+
+int DownloadItem::priority() const
+{
+    return m_priority;
+}
+
+void DownloadItem::setPriority(int priority)
+{
+    m_priority = priority;
+}
+
+/*!
+    Called by the scheduler of the download manager every \a interval
+    milliseconds.  A Downloading item may read \a rate bytes a second,
+    -1 meaning no limit, and can save up to a second of it.
+ */
+void DownloadItem::schedule(State state, qint64 rate, int interval)
+{
+    if (rate < 0)
+        m_tokens = -1;
+    else
+        m_tokens = qMin(qMax(m_tokens, qint64(0)) + rate * interval / 1000, rate);
+
+    if (state != m_scheduleState) {
+        m_scheduleState = state;
+        if (state == Queued)
+            downloadInfoLabel->setText(tr("Queued"));
+        else if (state == Waiting)
+            downloadInfoLabel->setText(tr("Waiting for the page to load"));
+        emit statusChanged();
+    }
+    if (state == Downloading)
+        readAvailable();
+}
+
+qint64 DownloadItem::readAllowance() const
+{
+    if (m_scheduleState != Downloading)
+        return 0;
+    if (m_tokens < 0)
+        return Q_INT64_C(0x7fffffffffffffff);
+    return m_tokens;
+}
+
+void DownloadItem::consumeAllowance(qint64 bytes)
+{
+    if (m_tokens > 0)
+        m_tokens = qMax(qint64(0), m_tokens - bytes);
 }
 
 void DownloadItem::error(QNetworkReply::NetworkError)
@@ -332,18 +779,24 @@ void DownloadItem::metaDataChanged()
         return;
     }
 
-#ifdef DOWNLOADMANAGER_DEBUG
-    qDebug() << "DownloadItem::" << __FUNCTION__ << "not handled.";
-#endif
+    readValidators();
+    startSegments();
 }
 
 void DownloadItem::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
-    QTime now = QTime::currentTime();
-    if (m_lastProgressTime.msecsTo(now) < 200)
+    qint64 now = m_rateEstimator.elapsed();
+    if (m_lastProgressUpdate != -1 && now - m_lastProgressUpdate < 200)
         return;
 
-    m_lastProgressTime = now;
+    m_lastProgressUpdate = now;
+
+    // A resumed request only reports on the rest of the file
+    if (m_resuming && m_segments.isEmpty()) {
+        bytesReceived += m_resumeOffset;
+        if (bytesTotal > 0)
+            bytesTotal += m_resumeOffset;
+    }
 
     m_bytesReceived = bytesReceived;
     qint64 currentValue = 0;
@@ -361,6 +814,15 @@ void DownloadItem::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 
 qint64 DownloadItem::bytesTotal() const
 {
+    // The answer to a range request has the size of the whole file after the '/'
+    QByteArray contentRange = m_reply->rawHeader("Content-Range");
+    int slash = contentRange.lastIndexOf('/');
+    if (slash != -1) {
+        bool ok;
+        qint64 total = contentRange.mid(slash + 1).toLongLong(&ok);
+        if (ok)
+            return total;
+    }
     return m_reply->header(QNetworkRequest::ContentLengthHeader).toULongLong();
 }
 
@@ -374,10 +836,12 @@ double DownloadItem::remainingTime() const
     if (!downloading())
         return -1.0;
 
-    double timeRemaining = ((double)(bytesTotal() - bytesReceived())) / currentSpeed();
+    double timeRemaining = m_rateEstimator.remainingTime(bytesTotal() - bytesReceived());
+    if (timeRemaining < 0)
+        return -1.0;
 
     // When downloading the eta should never be 0
-    if (timeRemaining == 0)
+    if (timeRemaining < 1)
         timeRemaining = 1;
 
     return timeRemaining;
@@ -388,15 +852,24 @@ double DownloadItem::currentSpeed() const
     if (!downloading())
         return -1.0;
 
-    return m_bytesReceived * 1000.0 / m_downloadTime.elapsed();
+    return m_rateEstimator.currentRate();
+}
+
+double DownloadItem::averageSpeed() const
+{
+    if (!downloading())
+        return -1.0;
+
+    return m_rateEstimator.averageRate();
 }
 
 void DownloadItem::updateInfoLabel()
 {
-    if (m_reply->error() != QNetworkReply::NoError)
+    // The requests of a segmented download are aborted once their range is in
+    if (m_segments.isEmpty() && m_reply->error() != QNetworkReply::NoError)
         return;
 
-    qint64 bytesTotal = m_reply->header(QNetworkRequest::ContentLengthHeader).toULongLong();
+    qint64 bytesTotal = this->bytesTotal();
     bool running = !downloadedSuccessfully();
 
     // update info label
@@ -407,14 +880,14 @@ void DownloadItem::updateInfoLabel()
     if (running) {
         QString remaining;
 
-        if (bytesTotal != 0) {
+        if (bytesTotal != 0 && timeRemaining >= 0) {
             remaining = DownloadManager::timeString(timeRemaining);
         }
 
         info = QString(tr("%1 of %2 (%3/sec) - %4"))
             .arg(DownloadManager::dataString(m_bytesReceived))
             .arg(bytesTotal == 0 ? tr("?") : DownloadManager::dataString(bytesTotal))
-            .arg(DownloadManager::dataString((int)speed))
+            .arg(speed < 0 ? tr("?") : DownloadManager::dataString(qint64(speed)))
             .arg(remaining);
     } else {
         if (m_bytesReceived == bytesTotal)
@@ -440,6 +913,11 @@ bool DownloadItem::downloadedSuccessfully() const
 void DownloadItem::finished()
 {
     m_finishedDownloading = true;
+    if (m_segments.isEmpty() && m_reply->bytesAvailable() > 0) {
+        // Data that was held back while the writer was busy, this calls finished() again
+        downloadReadyRead();
+        return;
+    }
     if (!m_startedSaving) {
         return;
     }
@@ -447,7 +925,7 @@ void DownloadItem::finished()
     stopButton->setEnabled(false);
     stopButton->hide();
     openButton->setEnabled(true);
-    m_output.close();
+    closeOutput();
     updateInfoLabel();
     emit statusChanged();
     emit downloadFinished();
@@ -473,6 +951,11 @@ DownloadManager::DownloadManager(QWidget *parent)
     settings.beginGroup(QLatin1String("downloadmanager"));
     QString defaultLocation = QDesktopServices::storageLocation(QDesktopServices::DesktopLocation);
     setDownloadDirectory(settings.value(QLatin1String("downloadDirectory"), defaultLocation).toString());
+    m_maximumDownloads = settings.value(QLatin1String("maximumDownloads"), 3).toInt();
+    // The rates are stored in kB/s
+    m_maximumRate = settings.value(QLatin1String("maximumRate"), 0).toLongLong() * 1024;
+    m_maximumDownloadRate = settings.value(QLatin1String("maximumDownloadRate"), 0).toLongLong() * 1024;
+    m_yieldToPageLoads = settings.value(QLatin1String("yieldToPageLoads"), true).toBool();
 
     downloadsView->setShowGrid(false);
     downloadsView->verticalHeader()->hide();
@@ -584,6 +1067,8 @@ void DownloadManager::addItem(DownloadItem *item)
 {
     connect(item, SIGNAL(statusChanged()), this, SLOT(updateRow()));
     connect(item, SIGNAL(downloadFinished()), this, SLOT(finished()));
+    // Keeps the resume information current in case of a crash
+    connect(item, SIGNAL(progress(qint64, qint64)), m_autoSaver, SLOT(changeOccurred()));
     int row = m_downloads.count();
     m_model->beginInsertRows(QModelIndex(), row, row);
     m_downloads.append(item);
@@ -595,6 +1080,140 @@ void DownloadManager::addItem(DownloadItem *item)
     downloadsView->setRowHeight(row, item->sizeHint().height());
     updateRow(item); //incase download finishes before the constructor returns
     updateActiveItemCount();
+    schedule();
+}
+
+/*!
+    The maximum number of downloads that are transfering at the same time,
+    the others are queued by priority and then in the order they were added.
+    0 means no limit.
+ */
+int DownloadManager::maximumDownloads() const
+{
+    return m_maximumDownloads;
+}
+
+void DownloadManager::setMaximumDownloads(int maximum)
+{
+    m_maximumDownloads = maximum;
+    schedule();
+}
+
+/*!
+    The maximum number of bytes a second all downloads together may read,
+    0 means no limit.
+ */
+qint64 DownloadManager::maximumRate() const
+{
+    return m_maximumRate;
+}
+
+void DownloadManager::setMaximumRate(qint64 rate)
+{
+    m_maximumRate = rate;
+    schedule();
+}
+
+/*!
+    The maximum number of bytes a second a single download may read,
+    0 means no limit.
+ */
+qint64 DownloadManager::maximumDownloadRate() const
+{
+    return m_maximumDownloadRate;
+}
+
+void DownloadManager::setMaximumDownloadRate(qint64 rate)
+{
+    m_maximumDownloadRate = rate;
+    schedule();
+}
+
+/*!
+    When true downloads stop reading while the current tab of the active
+    window is loading, for at most ten seconds.
+ */
+bool DownloadManager::yieldToPageLoads() const
+{
+    return m_yieldToPageLoads;
+}
+
+void DownloadManager::setYieldToPageLoads(bool yield)
+{
+    m_yieldToPageLoads = yield;
+    schedule();
+}
+
+static bool higherPriority(const DownloadItem *item1, const DownloadItem *item2)
+{
+    return item1->priority() > item2->priority();
+}
+
+bool DownloadManager::foregroundPageLoading()
+{
+    BrowserMainWindow *window = qobject_cast<BrowserMainWindow*>(QApplication::activeWindow());
+    WebView *webView = window ? window->currentTab() : 0;
+    bool loading = webView && webView->progress() > 0 && webView->progress() < 100;
+    if (!loading) {
+        m_yieldTime = QTime();
+        return false;
+    }
+    if (m_yieldTime.isNull())
+        m_yieldTime.start();
+    return m_yieldTime.elapsed() < maximumYieldTime;
+}
+
+/*
+    Decides which downloads may transfer and hands out the bandwidth they
+    may use until the next call.
+ */
+void DownloadManager::schedule()
+{
+    QList<DownloadItem*> active;
+    foreach (DownloadItem *item, m_downloads) {
+        if (item->stopButton->isEnabled())
+            active.append(item);
+    }
+    if (active.isEmpty()) {
+        m_scheduleTimer.stop();
+        m_lastSchedule = QTime();
+        return;
+    }
+    if (!m_scheduleTimer.isActive())
+        m_scheduleTimer.start(scheduleInterval, this);
+    int interval = m_lastSchedule.isNull() ? scheduleInterval : m_lastSchedule.elapsed();
+    m_lastSchedule.start();
+
+    // A stable sort keeps the downloads with the same priority in order
+    qStableSort(active.begin(), active.end(), higherPriority);
+    int running = active.count();
+    if (m_maximumDownloads > 0)
+        running = qMin(running, m_maximumDownloads);
+    bool yield = m_yieldToPageLoads && foregroundPageLoading();
+
+    qint64 rate = m_maximumDownloadRate > 0 ? m_maximumDownloadRate : -1;
+    if (m_maximumRate > 0) {
+        qint64 share = m_maximumRate / running;
+        rate = rate < 0 ? share : qMin(rate, share);
+    }
+    for (int i = 0; i < active.count(); ++i) {
+        DownloadItem *item = active.at(i);
+        if (i >= running)
+            item->schedule(DownloadItem::Queued, 0, interval);
+        else if (yield)
+            item->schedule(DownloadItem::Waiting, 0, interval);
+        else
+            item->schedule(DownloadItem::Downloading, rate, interval);
+    }
+}
+
+void DownloadManager::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_scheduleTimer.timerId()) {
+        schedule();
+        return;
+    }
+    QDialog::timerEvent(event);
 }
 
 void DownloadManager::updateActiveItemCount()
@@ -609,6 +1228,7 @@ void DownloadManager::updateActiveItemCount()
 
 void DownloadManager::finished()
 {
+    schedule();
     updateActiveItemCount();
     if (isVisible()) {
         QApplication::alert(this);
@@ -634,6 +1254,12 @@ void DownloadManager::updateRow(DownloadItem *item)
         icon = style()->standardIcon(QStyle::SP_FileIcon);
     item->fileIcon->setPixmap(icon.pixmap(48, 48));
 
+    QModelIndex index = m_model->index(row, 0);
+    emit m_model->dataChanged(index, index);
+    // A download that is tried again needs the scheduler
+    if (!m_scheduleTimer.isActive() && item->stopButton->isEnabled())
+        m_scheduleTimer.start(scheduleInterval, this);
+
     int oldHeight = downloadsView->rowHeight(row);
     downloadsView->setRowHeight(row, qMax(oldHeight, item->minimumSizeHint().height()));
 
@@ -676,18 +1302,41 @@ void DownloadManager::save() const
     if (m_removePolicy == Exit)
         return;
 
+    bool resume = false;
     for (int i = 0; i < m_downloads.count(); ++i) {
+        DownloadItem *item = m_downloads.at(i);
         QString key = QString(QLatin1String("download_%1_")).arg(i);
-        settings.setValue(key + QLatin1String("url"), m_downloads[i]->m_url);
-        settings.setValue(key + QLatin1String("location"), QFileInfo(m_downloads[i]->m_output).filePath());
-        settings.setValue(key + QLatin1String("done"), m_downloads[i]->downloadedSuccessfully());
+        settings.setValue(key + QLatin1String("url"), item->m_url);
+        settings.setValue(key + QLatin1String("location"), QFileInfo(item->m_output).filePath());
+        bool done = item->downloadedSuccessfully();
+        settings.setValue(key + QLatin1String("done"), done);
+        if (!done && item->canResume()) {
+            settings.setValue(key + QLatin1String("active"), item->downloading());
+            settings.setValue(key + QLatin1String("etag"), item->m_etag);
+            settings.setValue(key + QLatin1String("lastModified"), item->m_lastModified);
+            QVariantList ranges;
+            foreach (const DownloadItem::Range &range, item->missingRanges())
+                ranges << range.first << range.second;
+            settings.setValue(key + QLatin1String("missing"), ranges);
+            resume |= item->downloading();
+        } else {
+            settings.remove(key + QLatin1String("active"));
+            settings.remove(key + QLatin1String("etag"));
+            settings.remove(key + QLatin1String("lastModified"));
+            settings.remove(key + QLatin1String("missing"));
+        }
     }
+    settings.setValue(QLatin1String("resume"), resume);
     int i = m_downloads.count();
     QString key = QString(QLatin1String("download_%1_")).arg(i);
     while (settings.contains(key + QLatin1String("url"))) {
         settings.remove(key + QLatin1String("url"));
         settings.remove(key + QLatin1String("location"));
         settings.remove(key + QLatin1String("done"));
+        settings.remove(key + QLatin1String("active"));
+        settings.remove(key + QLatin1String("etag"));
+        settings.remove(key + QLatin1String("lastModified"));
+        settings.remove(key + QLatin1String("missing"));
         key = QString(QLatin1String("download_%1_")).arg(++i);
     }
 }
@@ -712,7 +1361,8 @@ void DownloadManager::load()
         QString fileName = settings.value(key + QLatin1String("location")).toString();
         bool done = settings.value(key + QLatin1String("done"), true).toBool();
         if (!url.isEmpty() && !fileName.isEmpty()) {
-            DownloadItem *item = new DownloadItem(0, this);
+            DownloadItem *item = new DownloadItem(0, false, this);
+            item->m_keepFileName = true;
             item->m_output.setFileName(fileName);
             item->fileNameLabel->setText(QFileInfo(item->m_output.fileName()).fileName());
             item->m_url = url;
@@ -721,12 +1371,35 @@ void DownloadManager::load()
             item->tryAgainButton->setVisible(!done);
             item->tryAgainButton->setEnabled(!done);
             item->progressBar->setVisible(false);
+            item->m_etag = settings.value(key + QLatin1String("etag")).toByteArray();
+            item->m_lastModified = settings.value(key + QLatin1String("lastModified")).toByteArray();
+            QVariantList ranges = settings.value(key + QLatin1String("missing")).toList();
+            for (int j = 0; j + 1 < ranges.count(); j += 2)
+                item->m_missing.append(DownloadItem::Range(ranges.at(j).toLongLong(), ranges.at(j + 1).toLongLong()));
             addItem(item);
+            if (!done && settings.value(key + QLatin1String("active"), false).toBool())
+                m_resumeDownloads.append(item);
         }
         key = QString(QLatin1String("download_%1_")).arg(++i);
     }
     cleanupButton->setEnabled(m_downloads.count() - activeDownloads() > 0);
     updateActiveItemCount();
+    // Not from the constructor, restarting asks for the download manager
+    if (!m_resumeDownloads.isEmpty())
+        QTimer::singleShot(0, this, SLOT(resumeDownloads()));
+}
+
+/*
+    Carries on with the downloads that were running when we quit or crashed.
+ */
+void DownloadManager::resumeDownloads()
+{
+    QList<QPointer<DownloadItem> > items = m_resumeDownloads;
+    m_resumeDownloads.clear();
+    foreach (DownloadItem *item, items) {
+        if (item)
+            item->tryAgain();
+    }
 }
 
 void DownloadManager::cleanup()
@@ -810,12 +1483,32 @@ QVariant DownloadModel::data(const QModelIndex &index, int role) const
 {
     if (index.row() < 0 || index.row() >= rowCount(index.parent()))
         return QVariant();
-    if (role == Qt::ToolTipRole)
-        if (!m_downloadManager->m_downloads.at(index.row())->downloadedSuccessfully())
-            return m_downloadManager->m_downloads.at(index.row())->downloadInfoLabel->text();
+    DownloadItem *item = m_downloadManager->m_downloads.at(index.row());
+    switch (role) {
+    case Qt::ToolTipRole:
+        if (!item->downloadedSuccessfully())
+            return item->downloadInfoLabel->text();
+        break;
+    case StateRole:
+        return item->state();
+    case PriorityRole:
+        return item->priority();
+    default:
+        break;
+    }
     return QVariant();
 }
 
+bool DownloadModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (index.row() < 0 || index.row() >= rowCount(index.parent()) || role != PriorityRole)
+        return false;
+    m_downloadManager->m_downloads.at(index.row())->setPriority(value.toInt());
+    m_downloadManager->schedule();
+    emit dataChanged(index, index);
+    return true;
+}
+
 int DownloadModel::rowCount(const QModelIndex &parent) const
 {
     return (parent.isValid()) ? 0 : m_downloadManager->m_downloads.count();
@@ -67,14 +67,24 @@
 #include "ui_downloads.h"
 #include "ui_downloaditem.h"
 
+#include "rateestimator.h"
+
 #include <qnetworkreply.h>
 
+#include <qbasictimer.h>
 #include <qfile.h>
 #include <qdatetime.h>
+#include <qpointer.h>
 
+class DownloadWriter;
 class DownloadItem : public QWidget, public Ui_DownloadItem
 {
     Q_OBJECT
+    Q_PROPERTY(qint64 bytesReceived READ bytesReceived)
+    Q_PROPERTY(qint64 bytesTotal READ bytesTotal)
+    Q_PROPERTY(double currentSpeed READ currentSpeed)
+    Q_PROPERTY(double averageSpeed READ averageSpeed)
+    Q_PROPERTY(double remainingTime READ remainingTime)
 
 signals:
     void statusChanged();
@@ -82,19 +92,34 @@ signals:
     void downloadFinished();
 
 public:
+    enum State {
+        Queued,
+        Waiting,
+        Downloading,
+        Finished,
+        Failed
+    };
+
     DownloadItem(QNetworkReply *reply = 0, bool requestFileName = false, QWidget *parent = 0);
     bool downloading() const;
     bool downloadedSuccessfully() const;
+    State state() const;
+
+    int priority() const;
+    void setPriority(int priority);
 
     qint64 bytesTotal() const;
     qint64 bytesReceived() const;
     double remainingTime() const;
     double currentSpeed() const;
+    double averageSpeed() const;
 
     QUrl m_url;
 
     QFile m_output;
     QNetworkReply *m_reply;
+    DownloadWriter *m_writer;
+    qint64 m_writePosition;
 
 private slots:
     void stop();
@@ -107,21 +132,65 @@ private slots:
     void metaDataChanged();
     void finished();
 
+    void segmentReadyRead();
+    void segmentFinished();
+
+    void writerBytesWritten();
+    void writerError(const QString &errorString);
+
 private:
     void getFileName();
     void init();
+    void restart();
+    bool openOutput();
+    void closeOutput();
+    void readAvailable();
     void updateInfoLabel();
 
+    void readValidators();
+    QByteArray validator() const;
+    bool canResume() const;
+    typedef QPair<qint64, qint64> Range;
+    QList<Range> missingRanges() const;
+
+    void schedule(State state, qint64 rate, int interval);
+    qint64 readAllowance() const;
+    void consumeAllowance(qint64 bytes);
+
+    void startSegments();
+    void readSegment(int index, bool force = false);
+    void abortSegments();
+    void segmentFailed(const QString &errorString);
+
     QString saveFileName(const QString &directory) const;
 
     bool m_requestFileName;
+    bool m_keepFileName;
     qint64 m_bytesReceived;
-    QTime m_downloadTime;
+    RateEstimator m_rateEstimator;
     bool m_startedSaving;
     bool m_finishedDownloading;
     bool m_gettingFileName;
     bool m_canceledFileSelect;
-    QTime m_lastProgressTime;
+    qint64 m_lastProgressUpdate;
+
+    struct Segment {
+        QNetworkReply *reply;
+        qint64 position;
+        qint64 end;
+    };
+    QList<Segment> m_segments;
+    bool m_useRanges;
+
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+    bool m_resuming;
+    qint64 m_resumeOffset;
+    QList<Range> m_missing;
+
+    int m_priority;
+    State m_scheduleState;
+    qint64 m_tokens;
 
     friend class DownloadManager;
 };
@@ -160,6 +229,15 @@ public:
     void setDownloadDirectory(const QString &directory);
     QString downloadDirectory();
 
+    int maximumDownloads() const;
+    void setMaximumDownloads(int maximum);
+    qint64 maximumRate() const;
+    void setMaximumRate(qint64 rate);
+    qint64 maximumDownloadRate() const;
+    void setMaximumDownloadRate(qint64 rate);
+    bool yieldToPageLoads() const;
+    void setYieldToPageLoads(bool yield);
+
 public slots:
     void download(const QNetworkRequest &request, bool requestFileName = false);
     inline void download(const QUrl &url, bool requestFileName = false)
@@ -172,9 +250,15 @@ private slots:
     void updateRow(DownloadItem *item);
     void updateRow();
     void finished();
+    void resumeDownloads();
+
+protected:
+    void timerEvent(QTimerEvent *event);
 
 private:
     void addItem(DownloadItem *item);
+    void schedule();
+    bool foregroundPageLoading();
     void updateItemCount();
     void load();
     bool externalDownload(const QUrl &url);
@@ -185,9 +269,18 @@ private:
     QNetworkAccessManager *m_manager;
     QFileIconProvider *m_iconProvider;
     QList<DownloadItem*> m_downloads;
+    QList<QPointer<DownloadItem> > m_resumeDownloads;
     RemovePolicy m_removePolicy;
     QString m_downloadDirectory;
 
+    QBasicTimer m_scheduleTimer;
+    QTime m_lastSchedule;
+    QTime m_yieldTime;
+    int m_maximumDownloads;
+    qint64 m_maximumRate;
+    qint64 m_maximumDownloadRate;
+    bool m_yieldToPageLoads;
+
     friend class DownloadModel;
 };
 
@@ -197,8 +290,14 @@ class DownloadModel : public QAbstractListModel
     Q_OBJECT
 
 public:
+    enum Roles {
+        StateRole = Qt::UserRole + 1,
+        PriorityRole
+    };
+
     DownloadModel(DownloadManager *downloadManager, QObject *parent = 0);
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
     Qt::ItemFlags flags(const QModelIndex &index) const;
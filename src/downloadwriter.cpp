@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "downloadwriter.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+// #define DOWNLOADWRITER_DEBUG
+
+#ifdef DOWNLOADWRITER_DEBUG
+#include <qdebug.h>
+#endif
+
+// Writes are made in multiples of this, starting at a multiple of it
+static const qint64 blockSize = 64 * 1024;
+
+DownloadWriter::DownloadWriter(QObject *parent)
+    : QThread(parent)
+    , m_queuedSize(0)
+    , m_maximumQueueSize(4 * 1024 * 1024)
+    , m_preallocateSize(-1)
+    , m_keepSize(false)
+    , m_closing(false)
+{
+}
+
+DownloadWriter::~DownloadWriter()
+{
+    close();
+}
+
+/*!
+    Opens \a fileName with \a mode and starts the writer thread.
+ */
+bool DownloadWriter::open(const QString &fileName, QIODevice::OpenMode mode)
+{
+    close();
+    m_file.setFileName(fileName);
+    // The chunks are already large, there is no need for QFile to buffer them
+    if (!m_file.open(mode | QIODevice::Unbuffered)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_errorString.clear();
+    m_closing = false;
+    start();
+    return true;
+}
+
+/*!
+    Writes out everything that is queued, stops the thread and closes the file.
+ */
+void DownloadWriter::close()
+{
+    if (!isRunning()) {
+        m_file.close();
+        return;
+    }
+    m_mutex.lock();
+    m_closing = true;
+    m_waitCondition.wakeAll();
+    m_mutex.unlock();
+    wait();
+    m_file.close();
+}
+
+QString DownloadWriter::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errorString;
+}
+
+/*!
+    Reserves \a size bytes on the disk for the file before it is written so
+    that it ends up in one piece.  When \a keepSize is true the size of the
+    file does not change, which is only possible on Linux.  Otherwise the
+    file is made \a size bytes long.
+ */
+void DownloadWriter::preallocate(qint64 size, bool keepSize)
+{
+    QMutexLocker locker(&m_mutex);
+    m_preallocateSize = size;
+    m_keepSize = keepSize;
+    m_waitCondition.wakeAll();
+}
+
+/*!
+    Queues \a data to be written at \a offset.
+ */
+void DownloadWriter::write(qint64 offset, const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    if (data.isEmpty() || !m_errorString.isEmpty())
+        return;
+    m_queuedSize += data.size();
+    m_waitCondition.wakeAll();
+    for (int i = m_chunks.count() - 1; i >= 0; --i) {
+        Chunk &chunk = m_chunks[i];
+        if (chunk.offset + chunk.data.size() == offset) {
+            chunk.data += data;
+            return;
+        }
+    }
+    Chunk chunk;
+    chunk.offset = offset;
+    chunk.data = data;
+    m_chunks.append(chunk);
+}
+
+/*!
+    Returns where the data that was queued up to \a position is on the disk
+    up to, that is \a position minus the part that still has to be written.
+ */
+qint64 DownloadWriter::flushedPosition(qint64 position) const
+{
+    QMutexLocker locker(&m_mutex);
+    bool found;
+    do {
+        found = false;
+        if (m_writing.offset != -1 && m_writing.offset + m_writing.data.size() == position) {
+            position = m_writing.offset;
+            found = true;
+        }
+        foreach (const Chunk &chunk, m_chunks) {
+            if (chunk.offset + chunk.data.size() == position) {
+                position = chunk.offset;
+                found = true;
+            }
+        }
+    } while (found);
+    return position;
+}
+
+qint64 DownloadWriter::queuedSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuedSize;
+}
+
+qint64 DownloadWriter::maximumQueueSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maximumQueueSize;
+}
+
+void DownloadWriter::setMaximumQueueSize(qint64 size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maximumQueueSize = size;
+    m_waitCondition.wakeAll();
+}
+
+bool DownloadWriter::isFull() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuedSize >= m_maximumQueueSize;
+}
+
+/*
+    Returns the chunk that has data ready to be written or -1.
+ */
+int DownloadWriter::nextChunk() const
+{
+    bool flush = m_closing || m_queuedSize >= m_maximumQueueSize;
+    for (int i = 0; i < m_chunks.count(); ++i) {
+        const Chunk &chunk = m_chunks.at(i);
+        if (flush || chunk.offset / blockSize != (chunk.offset + chunk.data.size()) / blockSize)
+            return i;
+    }
+    return -1;
+}
+
+bool DownloadWriter::allocate(qint64 size, bool keepSize)
+{
+#ifdef Q_OS_LINUX
+    if (keepSize) {
+#ifdef FALLOC_FL_KEEP_SIZE
+        // Not being able to do this is not an error, the file is just not preallocated
+        fallocate(m_file.handle(), FALLOC_FL_KEEP_SIZE, 0, size);
+#endif
+        return true;
+    }
+    if (m_file.size() < size && posix_fallocate(m_file.handle(), 0, size) == 0)
+        return true;
+#endif
+    if (keepSize)
+        return true;
+    return m_file.size() >= size || m_file.resize(size);
+}
+
+void DownloadWriter::run()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        if (m_preallocateSize != -1) {
+            qint64 size = m_preallocateSize;
+            m_preallocateSize = -1;
+            if (!m_errorString.isEmpty())
+                continue;
+            // This can take a while on file systems that don't support it
+            bool keepSize = m_keepSize;
+            locker.unlock();
+            bool ok = allocate(size, keepSize);
+            locker.relock();
+            if (!ok && m_errorString.isEmpty()) {
+                m_errorString = m_file.errorString();
+                emit error(m_errorString);
+            }
+            continue;
+        }
+
+        int index = nextChunk();
+        if (index == -1) {
+            if (m_closing)
+                break;
+            m_waitCondition.wait(&m_mutex);
+            continue;
+        }
+
+        // Write whole blocks unless everything has to go out
+        Chunk &chunk = m_chunks[index];
+        qint64 length = chunk.data.size();
+        if (!m_closing && m_queuedSize < m_maximumQueueSize)
+            length = (chunk.offset + length) / blockSize * blockSize - chunk.offset;
+        m_writing.offset = chunk.offset;
+        m_writing.data = chunk.data.left(length);
+        if (length == chunk.data.size()) {
+            m_chunks.removeAt(index);
+        } else {
+            chunk.offset += length;
+            chunk.data = chunk.data.mid(length);
+        }
+
+        locker.unlock();
+        bool ok = m_file.seek(m_writing.offset)
+                  && m_file.write(m_writing.data) == m_writing.data.size();
+        locker.relock();
+
+#ifdef DOWNLOADWRITER_DEBUG
+        qDebug() << "DownloadWriter::" << __FUNCTION__ << m_writing.offset << length << ok;
+#endif
+
+        m_writing = Chunk();
+        m_queuedSize -= length;
+        if (ok) {
+            emit bytesWritten(length);
+        } else if (m_errorString.isEmpty()) {
+            // There is no point in writing the rest
+            m_errorString = m_file.errorString();
+            m_chunks.clear();
+            m_queuedSize = 0;
+            emit error(m_errorString);
+        }
+    }
+}
+
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef DOWNLOADWRITER_H
+#define DOWNLOADWRITER_H
+
+#include <qthread.h>
+
+#include <qfile.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qwaitcondition.h>
+
+/*
+    Writes the data of a download to its file on a thread of its own so
+    that a slow disk doesn't block the user interface.
+
+    Data is queued with an offset and data that continues a queued chunk
+    is appended to it, which lets a segmented download keep one chunk per
+    range.  Chunks are written out in whole blocks and only once the queue
+    is full or the writer is closed are the partial blocks written.
+
+    The queue is bounded; when isFull() returns true the caller should
+    stop reading from the network until bytesWritten() is emitted.
+*/
+class DownloadWriter : public QThread
+{
+    Q_OBJECT
+
+signals:
+    void bytesWritten(qint64 bytes);
+    void error(const QString &errorString);
+
+public:
+    DownloadWriter(QObject *parent = 0);
+    ~DownloadWriter();
+
+    bool open(const QString &fileName, QIODevice::OpenMode mode);
+    void close();
+    QString errorString() const;
+
+    void preallocate(qint64 size, bool keepSize);
+    void write(qint64 offset, const QByteArray &data);
+    qint64 flushedPosition(qint64 position) const;
+
+    qint64 queuedSize() const;
+    qint64 maximumQueueSize() const;
+    void setMaximumQueueSize(qint64 size);
+    bool isFull() const;
+
+protected:
+    void run();
+
+private:
+    struct Chunk {
+        Chunk() : offset(-1) {}
+        qint64 offset;
+        QByteArray data;
+    };
+
+    int nextChunk() const;
+    bool allocate(qint64 size, bool keepSize);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_waitCondition;
+    QFile m_file;
+    QList<Chunk> m_chunks;
+    Chunk m_writing;
+    qint64 m_queuedSize;
+    qint64 m_maximumQueueSize;
+    qint64 m_preallocateSize;
+    bool m_keepSize;
+    bool m_closing;
+    QString m_errorString;
+};
+
+#endif // DOWNLOADWRITER_H
+
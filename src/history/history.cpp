@@ -482,6 +482,36 @@ int HistoryFilterModel::historyLocation(const QString &url) const
     return sourceModel()->rowCount() - m_historyHash.value(url);
 }
 
+/*!
+    Returns up to \a count hosts of the http and https urls in the history
+    ordered by the combined frecency of their urls.
+ */
+QStringList HistoryFilterModel::mostFrecentHosts(int count) const
+{
+    load();
+    QHash<QString, int> hostFrecency;
+    for (int i = 0; i < m_filteredRows.count(); ++i) {
+        QUrl url = index(i, 0).data(HistoryModel::UrlRole).toUrl();
+        if (url.scheme() != QLatin1String("http")
+            && url.scheme() != QLatin1String("https"))
+            continue;
+        hostFrecency[url.host()] += m_filteredRows.at(i).frecency;
+    }
+
+    QMultiMap<int, QString> ordered;
+    QHash<QString, int>::const_iterator it = hostFrecency.constBegin();
+    for (; it != hostFrecency.constEnd(); ++it)
+        ordered.insert(it.value(), it.key());
+
+    QStringList hosts;
+    QMultiMap<int, QString>::const_iterator i = ordered.constEnd();
+    while (i != ordered.constBegin() && hosts.count() < count) {
+        --i;
+        hosts.append(i.value());
+    }
+    return hosts;
+}
+
 QVariant HistoryFilterModel::data(const QModelIndex &index, int role) const
 {
     if (role == FrecencyRole && index.isValid()) {
@@ -120,6 +120,7 @@ public:
     inline bool historyContains(const QString &url) const
         { load(); return m_historyHash.contains(url); }
     int historyLocation(const QString &url) const;
+    QStringList mostFrecentHosts(int count) const;
 
     enum Roles {
         FrecencyRole = HistoryModel::MaxRole + 1,
@@ -21,6 +21,7 @@
 #define LOCATIONBARSITEICON_H
 
 #include <qlabel.h>
+#include <qpointer.h>
 
 class WebView;
 class LocationBarSiteIcon : public QLabel
@@ -39,7 +40,7 @@ private slots:
     void webViewSiteIconChanged();
 
 private:
-    WebView *m_webView;
+    QPointer<WebView> m_webView;
     QPoint m_dragStartPos;
 
 };
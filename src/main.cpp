@@ -18,6 +18,7 @@
  */
 
 #include "browserapplication.h"
+#include "startuptrace.h"
 
 #ifdef Q_OS_WIN
 #include "explorerstyle.h"
@@ -25,6 +26,7 @@
 
 int main(int argc, char **argv)
 {
+    StartupTrace::start();
     Q_INIT_RESOURCE(htmls);
     Q_INIT_RESOURCE(data);
 #ifdef Q_WS_X11
@@ -37,6 +39,7 @@ int main(int argc, char **argv)
     application.setStyle(new ExplorerStyle);
 #endif
     application.newMainWindow();
+    StartupTrace::mark(QLatin1String("main window created"));
     return application.exec();
 }
 
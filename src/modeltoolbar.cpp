@@ -190,7 +190,7 @@ void ModelToolBar::hideEvent(QHideEvent *event)
 
 void ModelToolBar::showEvent(QShowEvent *event)
 {
-    if (actions().isEmpty())
+    if (m_model && actions().isEmpty())
         build();
     QToolBar::showEvent(event);
 }
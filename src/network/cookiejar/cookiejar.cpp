@@ -161,6 +161,7 @@ void CookieJar::load()
     qSort(m_exceptions_block.begin(), m_exceptions_block.end());
     qSort(m_exceptions_allow.begin(), m_exceptions_allow.end());
     qSort(m_exceptions_allowForSession.begin(), m_exceptions_allowForSession.end());
+    updateExceptionRules();
 
     loadSettings();
 }
@@ -254,10 +255,10 @@ bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const
     if (!m_loaded)
         load();
 
-    QString host = url.host();
-    bool eBlock = isOnDomainList(m_exceptions_block, host);
-    bool eAllow = !eBlock && isOnDomainList(m_exceptions_allow, host);
-    bool eAllowSession = !eBlock && !eAllow && isOnDomainList(m_exceptions_allowForSession, host);
+    QList<CookieRule> rules = exceptionRules(url.host());
+    bool eBlock = rules.contains(Block);
+    bool eAllow = !eBlock && rules.contains(Allow);
+    bool eAllowSession = !eBlock && !eAllow && rules.contains(AllowForSession);
 
     bool addedCookies = false;
     // pass exceptions
@@ -349,29 +350,51 @@ void CookieJar::setCookies(const QList<QNetworkCookie> &cookies)
 
 bool CookieJar::isOnDomainList(const QStringList &rules, const QString &domain)
 {
-    // Either the rule matches the domain exactly
-    // or the domain ends with ".rule"
-    foreach (const QString &rule, rules) {
-        if (rule.startsWith(QLatin1String("."))) {
-            if (domain.endsWith(rule))
-                return true;
-
-            QStringRef withoutDot = rule.rightRef(rule.size() - 1);
-            if (domain == withoutDot)
-                return true;
-        } else {
-            QStringRef domainEnding = domain.rightRef(rule.size() + 1);
-            if (!domainEnding.isEmpty()
-                && domainEnding.at(0) == QLatin1Char('.')
-                && domain.endsWith(rule)) {
-                return true;
-            }
+    Trie<CookieRule> trie;
+    addExceptionRules(trie, rules, Block);
+    return !trie.findAlongPath(domainKey(domain)).isEmpty();
+}
 
-            if (rule == domain)
-                return true;
-        }
+/*
+    Returns the rules of every exception that matches domain.
+
+    The exceptions are stored in a trie keyed on the domain labels so the
+    lookup only depends on the number of labels in the domain and not on
+    the number of exceptions.
+ */
+QList<CookieJar::CookieRule> CookieJar::exceptionRules(const QString &domain) const
+{
+    if (m_exceptionRules.isEmpty())
+        return QList<CookieRule>();
+    return m_exceptionRules.findAlongPath(domainKey(domain));
+}
+
+QStringList CookieJar::domainKey(const QString &domain)
+{
+    return domain.split(QLatin1Char('.'));
+}
+
+void CookieJar::addExceptionRules(Trie<CookieRule> &trie, const QStringList &rules, CookieRule rule)
+{
+    // Either the rule matches the domain exactly
+    // or the domain ends with ".rule" so "foo.com" and ".foo.com" are
+    // both stored at the node for foo.com
+    foreach (const QString &exception, rules) {
+        QString domain = exception;
+        if (domain.startsWith(QLatin1Char('.')))
+            domain = domain.mid(1);
+        if (domain.isEmpty())
+            continue;
+        trie.insert(domainKey(domain), rule);
     }
-    return false;
+}
+
+void CookieJar::updateExceptionRules()
+{
+    m_exceptionRules.clear();
+    addExceptionRules(m_exceptionRules, m_exceptions_block, Block);
+    addExceptionRules(m_exceptionRules, m_exceptions_allow, Allow);
+    addExceptionRules(m_exceptionRules, m_exceptions_allowForSession, AllowForSession);
 }
 
 CookieJar::AcceptPolicy CookieJar::acceptPolicy() const
@@ -435,6 +458,7 @@ void CookieJar::setBlockedCookies(const QStringList &list)
         load();
     m_exceptions_block = list;
     qSort(m_exceptions_block.begin(), m_exceptions_block.end());
+    updateExceptionRules();
     applyRules();
     m_saveTimer->changeOccurred();
 }
@@ -445,6 +469,7 @@ void CookieJar::setAllowedCookies(const QStringList &list)
         load();
     m_exceptions_allow = list;
     qSort(m_exceptions_allow.begin(), m_exceptions_allow.end());
+    updateExceptionRules();
     applyRules();
     m_saveTimer->changeOccurred();
 }
@@ -455,6 +480,7 @@ void CookieJar::setAllowForSessionCookies(const QStringList &list)
         load();
     m_exceptions_allowForSession = list;
     qSort(m_exceptions_allowForSession.begin(), m_exceptions_allowForSession.end());
+    updateExceptionRules();
     applyRules();
     m_saveTimer->changeOccurred();
 }
@@ -465,10 +491,11 @@ void CookieJar::applyRules()
     bool changed = false;
     for (int i = cookies.count() - 1; i >= 0; --i) {
         const QNetworkCookie &cookie = cookies.at(i);
-        if (isOnDomainList(m_exceptions_block, cookie.domain())) {
+        QList<CookieRule> rules = exceptionRules(cookie.domain());
+        if (rules.contains(Block)) {
             cookies.removeAt(i);
             changed = true;
-        } else if (isOnDomainList(m_exceptions_allowForSession, cookie.domain())) {
+        } else if (rules.contains(AllowForSession)) {
             const_cast<QNetworkCookie&>(cookie).setExpirationDate(QDateTime());
             changed = true;
         }
@@ -64,6 +64,7 @@
 #define COOKIEJAR_H
 
 #include "networkcookiejar.h"
+#include "trie_p.h"
 
 #include <qstringlist.h>
 
@@ -140,8 +141,12 @@ private slots:
 
 protected:
     static bool isOnDomainList(const QStringList &rules, const QString &domain);
+    QList<CookieRule> exceptionRules(const QString &domain) const;
 
 private:
+    static QStringList domainKey(const QString &domain);
+    static void addExceptionRules(Trie<CookieRule> &trie, const QStringList &rules, CookieRule rule);
+    void updateExceptionRules();
     void applyRules();
     void purgeOldCookies();
     void load();
@@ -155,6 +160,7 @@ private:
     QStringList m_exceptions_block;
     QStringList m_exceptions_allow;
     QStringList m_exceptions_allowForSession;
+    Trie<CookieRule> m_exceptionRules;
     bool m_isPrivate;
     int m_sessionLength;
 };
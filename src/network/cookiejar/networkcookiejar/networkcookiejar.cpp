@@ -36,7 +36,7 @@
 
 #include "networkcookiejar.h"
 #include "networkcookiejar_p.h"
-#include "twoleveldomains_p.h"
+#include "publicsuffix.h"
 
 //#define NETWORKCOOKIEJAR_DEBUG
 
@@ -94,10 +94,12 @@ QList<QNetworkCookie> NetworkCookieJar::cookiesForUrl(const QUrl &url) const
 
     // Get all the cookies for url
     QList<QNetworkCookie> cookies = d->tree.find(urlHost);
-    if (urlHost.count() > 2) {
-        int top = 2;
-        if (d->matchesBlacklist(urlHost.last()))
-            top = 3;
+
+    // Walk up to the registrable domain, cookies are never set
+    // on a public suffix such as "com" or "co.uk"
+    int registrable = PublicSuffix::registrableDomainIndex(host);
+    if (registrable > 0) {
+        int top = urlHost.count() - host.left(registrable).count(QLatin1Char('.'));
 
         urlHost.removeFirst();
         while (urlHost.count() >= top) {
@@ -316,20 +318,6 @@ bool NetworkCookieJarPrivate::matchingPath(const QNetworkCookie &cookie, const Q
     return urlPath.startsWith(cookiePath);
 }
 
-bool NetworkCookieJarPrivate::matchesBlacklist(const QString &string) const
-{
-    if (!setSecondLevelDomain) {
-        // Alternatively to save a little bit of ram we could just
-        // use bsearch on twoLevelDomains in place
-        for (int j = 0; twoLevelDomains[j]; ++j)
-            secondLevelDomains += QLatin1String(twoLevelDomains[j]);
-        setSecondLevelDomain = true;
-    }
-    QStringList::const_iterator i =
-         qBinaryFind(secondLevelDomains.constBegin(), secondLevelDomains.constEnd(), string);
-        return (i != secondLevelDomains.constEnd());
-}
-
 bool NetworkCookieJarPrivate::matchingDomain(const QNetworkCookie &cookie, const QUrl &url) const
 {
     QString domain = cookie.domain().simplified().toLower();
@@ -347,8 +335,8 @@ bool NetworkCookieJarPrivate::matchingDomain(const QNetworkCookie &cookie, const
             return true;
     }
 
-    // Check for blacklist
-    if (parts.count() == 2 && matchesBlacklist(parts.last()))
+    // Cookies for a whole public suffix such as "co.uk" are not allowed
+    if (parts.count() > 1 && PublicSuffix::isPublicSuffix(parts.join(QLatin1String("."))))
         return false;
 
     QStringList urlParts = url.host().toLower().split(QLatin1Char('.'), QString::SkipEmptyParts);
@@ -366,10 +354,3 @@ bool NetworkCookieJarPrivate::matchingDomain(const QNetworkCookie &cookie, const
     return true;
 }
 
-void NetworkCookieJar::setSecondLevelDomains(const QStringList &secondLevelDomains)
-{
-    d->setSecondLevelDomain = true;
-    d->secondLevelDomains = secondLevelDomains;
-    qSort(d->secondLevelDomains);
-}
-
@@ -56,7 +56,6 @@ protected:
 
     QList<QNetworkCookie> allCookies() const;
     void setAllCookies(const QList<QNetworkCookie> &cookieList);
-    void setSecondLevelDomains(const QStringList &secondLevelDomains);
 
 private:
     NetworkCookieJarPrivate *d;
@@ -1,5 +1,5 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
-HEADERS += trie_p.h networkcookiejar.h twoleveldomains_p.h networkcookiejar_p.h
+HEADERS += trie_p.h networkcookiejar.h networkcookiejar_p.h
 SOURCES += networkcookiejar.cpp
@@ -59,15 +59,8 @@ QT_END_NAMESPACE
 
 class NetworkCookieJarPrivate {
 public:
-    NetworkCookieJarPrivate()
-        : setSecondLevelDomain(false)
-    {}
-
     Trie<QNetworkCookie> tree;
-    mutable bool setSecondLevelDomain;
-    mutable QStringList secondLevelDomains;
 
-    bool matchesBlacklist(const QString &string) const;
     bool matchingDomain(const QNetworkCookie &cookie, const QUrl &url) const;
     QString urlPath(const QUrl &url) const;
     bool matchingPath(const QNetworkCookie &cookie, const QString &urlPath) const;
@@ -69,6 +69,7 @@ public:
     void insert(const QStringList &key, const T &value);
     bool remove(const QStringList &key, const T &value);
     QList<T> find(const QStringList &key) const;
+    QList<T> findAlongPath(const QStringList &key) const;
     QList<T> all() const;
 
     inline bool contains(const QStringList &key) const;
@@ -168,6 +169,37 @@ QList<T> Trie<T>::find(const QStringList &key) const {
     return QList<T>();
 }
 
+/*
+    Returns the values of every node passed while walking to key,
+    ordered from the shortest sub key to key itself.
+
+    With domain labels as the key this returns the values stored for
+    the domain and for each of its parent domains.
+*/
+template<class T>
+QList<T> Trie<T>::findAlongPath(const QStringList &key) const {
+#if defined(TRIE_DEBUG)
+    qDebug() << "Trie::" << __FUNCTION__ << key;
+#endif
+    QList<T> found = values;
+    const Trie<T> *node = this;
+    QStringList::const_iterator childIterator;
+    QStringList::const_iterator begin, end;
+
+    int depth = key.count() - 1;
+    while (depth >= 0) {
+        const QString &currentLevelKey = key.at(depth--);
+        begin = node->childrenKeys.constBegin();
+        end = node->childrenKeys.constEnd();
+        childIterator = qBinaryFind(begin, end, currentLevelKey);
+        if (childIterator == end)
+            break;
+        node = &node->children.at(childIterator - begin);
+        found += node->values;
+    }
+    return found;
+}
+
 template<class T>
 QList<T> Trie<T>::all() const {
 #if defined(TRIE_DEBUG)
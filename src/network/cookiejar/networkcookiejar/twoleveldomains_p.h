@@ -1,103 +0,0 @@
-/*
-   Copyright (C) 2009, Torch Mobile Inc. and Linden Research, Inc. All rights reserved.
-*/
-
-/* ***** BEGIN LICENSE BLOCK *****
- * Version: MPL 1.1/GPL 2.0/LGPL 2.1
- *
- * The contents of this file are subject to the Mozilla Public License Version
- * 1.1 (the "License"); you may not use this file except in compliance with
- * the License. You may obtain a copy of the License at
- * http://www.mozilla.org/MPL/
- *
- * Software distributed under the License is distributed on an "AS IS" basis,
- * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
- * for the specific language governing rights and limitations under the
- * License.
- *
- * The Original Code is Torch Mobile Inc. (http://www.torchmobile.com/) code
- *
- * The Initial Developer of the Original Code is:
- *   Benjamin Meyer (benjamin.meyer@torchmobile.com)
- *
- * Alternatively, the contents of this file may be used under the terms of
- * either the GNU General Public License Version 2 or later (the "GPL"), or
- * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
- * in which case the provisions of the GPL or the LGPL are applicable instead
- * of those above. If you wish to allow use of your version of this file only
- * under the terms of either the GPL or the LGPL, and not to allow others to
- * use your version of this file under the terms of the MPL, indicate your
- * decision by deleting the provisions above and replace them with the notice
- * and other provisions required by the GPL or the LGPL. If you do not delete
- * the provisions above, a recipient may use your version of this file under
- * the terms of any one of the MPL, the GPL or the LGPL.
- *
- * ***** END LICENSE BLOCK ***** */
-
-// Updated from https://wiki.mozilla.org/TLD_List#External_Links
-// To set a custom list use NetworkCookieJar::setSecondLevelDomains()
-static const char *const twoLevelDomains[] = {
-    "ao",
-    "ar",
-    "arpa",
-    "bd",
-    "bn",
-    "br",
-    "co",
-    "cr",
-    "cy",
-    "do",
-    "eg",
-    "et",
-    "fj",
-    "fk",
-    "gh",
-    "gn",
-    "gu",
-    "id",
-    "il",
-    "jm",
-    "ke",
-    "kh",
-    "ki",
-    "kw",
-    "kz",
-    "lb",
-    "lc",
-    "lr",
-    "ls",
-    "ml",
-    "mm",
-    "mv",
-    "mw",
-    "mx",
-    "my",
-    "ng",
-    "ni",
-    "np",
-    "nz",
-    "om",
-    "pa",
-    "pe",
-    "pg",
-    "pw",
-    "py",
-    "qa",
-    "sa",
-    "sb",
-    "sv",
-    "sy",
-    "th",
-    "tn",
-    "tz",
-    "uk",
-    "uy",
-    "va",
-    "ve",
-    "ye",
-    "yu",
-    "za",
-    "zm",
-    "zw",
-    0
-};
@@ -8,14 +8,20 @@ FORMS += \
 HEADERS += \
     fileaccesshandler.h \
     networkaccessmanager.h \
+    networkcachestore.h \
     networkdiskcache.h \
+    networkmonitor.h \
+    networkmonitordialog.h \
     networkproxyfactory.h \
     schemeaccesshandler.h
 
 SOURCES += \
     fileaccesshandler.cpp \
     networkaccessmanager.cpp \
+    networkcachestore.cpp \
     networkdiskcache.cpp \
+    networkmonitor.cpp \
+    networkmonitordialog.cpp \
     networkproxyfactory.cpp \
     schemeaccesshandler.cpp
 
@@ -74,6 +74,7 @@
 #include "fileaccesshandler.h"
 #include "networkproxyfactory.h"
 #include "networkdiskcache.h"
+#include "networkmonitor.h"
 #include "ui_passworddialog.h"
 #include "ui_proxy.h"
 
@@ -82,8 +83,10 @@
 #include <qsettings.h>
 #include <qstyle.h>
 #include <qtextdocument.h>
+#include <qtimer.h>
 
 #include <qauthenticator.h>
+#include <qhostinfo.h>
 #include <qsslconfiguration.h>
 #include <qsslerror.h>
 #include <qdatetime.h>
@@ -93,7 +96,15 @@
 NetworkAccessManager::NetworkAccessManager(QObject *parent)
     : NetworkAccessManagerProxy(parent)
     , m_adblockNetwork(0)
+    , m_prefetchEnabled(true)
+    , m_prefetchedHostCount(0)
+    , m_prefetchHitCount(0)
+    , m_prefetchSavedTime(0)
+    , m_networkMonitor(0)
 {
+    for (int i = 0; i < OtherScheme; ++i)
+        m_schemeHandlers[i] = 0;
+
     connect(this, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator*)),
             SLOT(authenticationRequired(QNetworkReply*, QAuthenticator*)));
     connect(this, SIGNAL(proxyAuthenticationRequired(const QNetworkProxy&, QAuthenticator*)),
@@ -126,9 +137,165 @@ void NetworkAccessManager::privacyChanged(bool isPrivate)
     }
 }
 
+/*!
+    Maps the schemes WebKit commonly requests to a Scheme without hashing.
+ */
+NetworkAccessManager::Scheme NetworkAccessManager::scheme(const QString &scheme)
+{
+    switch (scheme.length()) {
+    case 3:
+        if (scheme == QLatin1String("ftp"))
+            return FtpScheme;
+        if (scheme == QLatin1String("qrc"))
+            return QrcScheme;
+        if (scheme == QLatin1String("abp"))
+            return AbpScheme;
+        break;
+    case 4:
+        if (scheme == QLatin1String("http"))
+            return HttpScheme;
+        if (scheme == QLatin1String("file"))
+            return FileScheme;
+        if (scheme == QLatin1String("data"))
+            return DataScheme;
+        break;
+    case 5:
+        if (scheme == QLatin1String("https"))
+            return HttpsScheme;
+        break;
+    default:
+        break;
+    }
+    return OtherScheme;
+}
+
 void NetworkAccessManager::setSchemeHandler(const QString &scheme, SchemeAccessHandler *handler)
 {
-    m_schemeHandlers.insert(scheme, handler);
+    Scheme id = NetworkAccessManager::scheme(scheme);
+    if (id == OtherScheme)
+        m_otherSchemeHandlers.insert(scheme, handler);
+    else
+        m_schemeHandlers[id] = handler;
+}
+
+/*!
+    Returns the monitor recording the replies or 0 when monitoring is disabled.
+ */
+NetworkMonitor *NetworkAccessManager::networkMonitor() const
+{
+    return m_networkMonitor;
+}
+
+void NetworkAccessManager::setNetworkMonitorEnabled(bool enabled)
+{
+    if (enabled == (m_networkMonitor != 0))
+        return;
+    if (enabled) {
+        m_networkMonitor = new NetworkMonitor(this);
+    } else {
+        delete m_networkMonitor;
+        m_networkMonitor = 0;
+    }
+}
+
+static const int maxHostPrefetches = 100;
+static const int hostPrefetchLifetime = 60 * 1000;
+
+/*!
+    Starts resolving the names of \a hosts in parallel so that the
+    requests that follow, such as the tabs of a restored session, find them
+    in the host lookup cache instead of waiting for the lookup themselves.
+ */
+void NetworkAccessManager::prefetchHosts(const QStringList &hosts)
+{
+#if QT_VERSION >= 0x040600
+    if (!m_prefetchEnabled || BrowserApplication::isPrivate())
+        return;
+
+    bool started = false;
+    foreach (const QString &host, hosts) {
+        if (m_hostPrefetches.count() >= maxHostPrefetches)
+            break;
+        QString key = host.toLower();
+        if (key.isEmpty() || m_hostPrefetches.contains(key))
+            continue;
+        m_hostPrefetches[key].started.start();
+        int id = QHostInfo::lookupHost(key, this, SLOT(hostPrefetched(const QHostInfo &)));
+        m_hostPrefetchLookups.insert(id, key);
+        ++m_prefetchedHostCount;
+        started = true;
+    }
+    if (started)
+        QTimer::singleShot(hostPrefetchLifetime, this, SLOT(expireHostPrefetches()));
+#else
+    Q_UNUSED(hosts);
+#endif
+}
+
+/*!
+    The number of hosts that have been prefetched.
+ */
+int NetworkAccessManager::prefetchedHostCount() const
+{
+    return m_prefetchedHostCount;
+}
+
+/*!
+    The number of requests that were made to a prefetched host.
+ */
+int NetworkAccessManager::prefetchHitCount() const
+{
+    return m_prefetchHitCount;
+}
+
+/*!
+    The time in milliseconds that requests to prefetched hosts did not
+    have to spend waiting on a host lookup.
+ */
+int NetworkAccessManager::prefetchSavedTime() const
+{
+    return m_prefetchSavedTime;
+}
+
+void NetworkAccessManager::hostPrefetched(const QHostInfo &info)
+{
+    QString host = m_hostPrefetchLookups.take(info.lookupId());
+    QHash<QString, HostPrefetch>::iterator it = m_hostPrefetches.find(host);
+    if (it == m_hostPrefetches.end())
+        return;
+    if (info.error() != QHostInfo::NoError) {
+        m_hostPrefetches.erase(it);
+        return;
+    }
+    it->lookupTime = it->started.elapsed();
+}
+
+void NetworkAccessManager::hostRequested(const QString &host)
+{
+    QHash<QString, HostPrefetch>::iterator it = m_hostPrefetches.find(host.toLower());
+    if (it == m_hostPrefetches.end())
+        return;
+
+    // A lookup that is still running has at least given the request a head start
+    int saved = it->lookupTime != -1 ? it->lookupTime : it->started.elapsed();
+    ++m_prefetchHitCount;
+    m_prefetchSavedTime += saved;
+    m_hostPrefetches.erase(it);
+#ifdef NETWORKACCESSMANAGER_DEBUG
+    qDebug() << __FUNCTION__ << host << "saved" << saved << "ms, total" << m_prefetchSavedTime
+             << "ms for" << m_prefetchHitCount << "of" << m_prefetchedHostCount << "hosts";
+#endif
+}
+
+void NetworkAccessManager::expireHostPrefetches()
+{
+    QHash<QString, HostPrefetch>::iterator it = m_hostPrefetches.begin();
+    while (it != m_hostPrefetches.end()) {
+        if (it->started.elapsed() >= hostPrefetchLifetime)
+            it = m_hostPrefetches.erase(it);
+        else
+            ++it;
+    }
 }
 
 void NetworkAccessManager::loadSettings()
@@ -162,6 +329,10 @@ void NetworkAccessManager::loadSettings()
     setProxyFactory(proxyFactory);
     settings.endGroup();
 
+    // With a proxy the host names are resolved by the proxy
+    m_prefetchEnabled = proxy.type() == QNetworkProxy::NoProxy
+                        || proxy.type() == QNetworkProxy::DefaultProxy;
+
 #ifndef QT_NO_OPENSSL
     QSslConfiguration sslCfg = QSslConfiguration::defaultConfiguration();
     QList<QSslCertificate> ca_list = sslCfg.caCertificates();
@@ -176,6 +347,9 @@ void NetworkAccessManager::loadSettings()
     QStringList acceptList = settings.value(QLatin1String("acceptLanguages"),
             AcceptLanguageDialog::defaultAcceptList()).toStringList();
     m_acceptLanguage = AcceptLanguageDialog::httpString(acceptList);
+    if (!settings.value(QLatin1String("prefetchHosts"), true).toBool())
+        m_prefetchEnabled = false;
+    setNetworkMonitorEnabled(settings.value(QLatin1String("monitorRequests"), false).toBool());
 
     bool cacheEnabled = settings.value(QLatin1String("cacheEnabled"), true).toBool();
     if (QLatin1String(qVersion()) == QLatin1String("4.5.1"))
@@ -343,19 +517,37 @@ void NetworkAccessManager::sslErrors(QNetworkReply *reply, const QList<QSslError
 }
 #endif
 
+// Login forms are small, anything bigger is not worth copying for autofill
+static const qint64 maxAutoFillPostSize = 64 * 1024;
+
 QNetworkReply *NetworkAccessManager::createRequest(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
 {
     if (op == PostOperation && outgoingData) {
-        QByteArray outgoingDataByteArray = outgoingData->peek(1024 * 1024);
-        BrowserApplication::autoFillManager()->post(request, outgoingDataByteArray);
+        // Only login forms are stored so leave other posts, like uploads, alone
+        AutoFillManager *autoFillManager = BrowserApplication::autoFillManager();
+        if (outgoingData->size() <= maxAutoFillPostSize) {
+            QUrl url;
+            if (QWebPage *webPage = autoFillManager->loginFormPage(request, &url)) {
+                QByteArray outgoingDataByteArray = outgoingData->peek(maxAutoFillPostSize);
+                autoFillManager->post(webPage, url, outgoingDataByteArray);
+            }
+        }
     }
 
     QNetworkReply *reply = 0;
     // Check if there is a valid handler registered for the requested URL scheme
-    if (m_schemeHandlers.contains(request.url().scheme()))
-        reply = m_schemeHandlers[request.url().scheme()]->createRequest(op, request, outgoingData);
-    if (reply)
+    const QString schemeName = request.url().scheme();
+    Scheme id = scheme(schemeName);
+    SchemeAccessHandler *handler = (id == OtherScheme)
+                                   ? m_otherSchemeHandlers.value(schemeName)
+                                   : m_schemeHandlers[id];
+    if (handler)
+        reply = handler->createRequest(op, request, outgoingData);
+    if (reply) {
+        if (m_networkMonitor)
+            m_networkMonitor->monitor(reply, schemeName);
         return reply;
+    }
 
     QNetworkRequest req = request;
 #if QT_VERSION >= 0x040600
@@ -369,11 +561,19 @@ QNetworkReply *NetworkAccessManager::createRequest(QNetworkAccessManager::Operat
         if (!m_adblockNetwork)
             m_adblockNetwork = AdBlockManager::instance()->network();
         reply = m_adblockNetwork->block(req);
-        if (reply)
+        if (reply) {
+            if (m_networkMonitor)
+                m_networkMonitor->monitor(reply, QLatin1String("adblock"));
             return reply;
+        }
     }
 
+    if (!m_hostPrefetches.isEmpty())
+        hostRequested(req.url().host());
+
     reply = QNetworkAccessManager::createRequest(op, req, outgoingData);
+    if (m_networkMonitor)
+        m_networkMonitor->monitor(reply);
     emit requestCreated(op, req, reply);
     return reply;
 }
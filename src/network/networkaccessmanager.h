@@ -66,9 +66,13 @@
 #include <qnetworkaccessmanager.h>
 #include <qsslconfiguration.h>
 #include <qhash.h>
+#include <qdatetime.h>
+#include <qstringlist.h>
 #include "networkaccessmanagerproxy.h"
 
 class SchemeAccessHandler;
+class QHostInfo;
+class NetworkMonitor;
 
 class AdBlockNetwork;
 class NetworkAccessManager : public NetworkAccessManagerProxy
@@ -82,6 +86,14 @@ public:
     NetworkAccessManager(QObject *parent = 0);
     void setSchemeHandler(const QString &scheme, SchemeAccessHandler *handler);
 
+    void prefetchHosts(const QStringList &hosts);
+    int prefetchedHostCount() const;
+    int prefetchHitCount() const;
+    int prefetchSavedTime() const;
+
+    NetworkMonitor *networkMonitor() const;
+    void setNetworkMonitorEnabled(bool enabled);
+
     inline QNetworkReply *createRequestProxy(QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
     {
         return createRequest(op, request, outgoingData);
@@ -100,17 +112,48 @@ private slots:
     void sslErrors(QNetworkReply *reply, const QList<QSslError> &error);
 #endif
     void privacyChanged(bool isPrivate);
+    void hostPrefetched(const QHostInfo &info);
+    void expireHostPrefetches();
 
 private:
+    void hostRequested(const QString &host);
+
 #ifndef QT_NO_OPENSSL
     static QString certToFormattedString(QSslCertificate cert);
 #endif
 
+    enum Scheme {
+        HttpScheme,
+        HttpsScheme,
+        FtpScheme,
+        FileScheme,
+        DataScheme,
+        QrcScheme,
+        AbpScheme,
+        OtherScheme
+    };
+    static Scheme scheme(const QString &scheme);
+
     QByteArray m_acceptLanguage;
-    QHash<QString, SchemeAccessHandler*> m_schemeHandlers;
+    SchemeAccessHandler *m_schemeHandlers[OtherScheme];
+    QHash<QString, SchemeAccessHandler*> m_otherSchemeHandlers;
 
     QNetworkCookieJar *m_privateCookieJar;
     AdBlockNetwork *m_adblockNetwork;
+
+    struct HostPrefetch {
+        HostPrefetch() : lookupTime(-1) {}
+        QTime started;
+        int lookupTime;
+    };
+    bool m_prefetchEnabled;
+    QHash<QString, HostPrefetch> m_hostPrefetches;
+    QHash<int, QString> m_hostPrefetchLookups;
+    int m_prefetchedHostCount;
+    int m_prefetchHitCount;
+    int m_prefetchSavedTime;
+
+    NetworkMonitor *m_networkMonitor;
 };
 
 #endif // NETWORKACCESSMANAGER_H
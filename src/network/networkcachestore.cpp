@@ -0,0 +1,1083 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "networkcachestore.h"
+
+#include <qbuffer.h>
+#include <qdatastream.h>
+#include <qdatetime.h>
+#include <qdir.h>
+#include <qfile.h>
+#include <qthread.h>
+
+#include <qdebug.h>
+
+// #define NETWORKCACHESTORE_DEBUG
+
+static const quint32 shardMagic = 0xca5e5a4d;
+static const quint32 recordMagic = 0xca5e0e17;
+static const quint32 indexMagic = 0xca5e1d00;
+static const qint32 indexVersion = 3;
+
+// magic, generation
+static const qint64 shardHeaderSize = 8;
+// magic, type, meta data size, body size
+static const qint64 recordHeaderSize = 13;
+
+static QByteArray recordHeader(quint8 type, quint32 metaSize, quint32 bodySize)
+{
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream << recordMagic << type << metaSize << bodySize;
+    return header;
+}
+
+/*
+    Copies the live records of a shard to a new file on a worker thread.
+    The shard is only read up to the size it had when the compactor was
+    created, the store keeps appending to it in the meantime.
+*/
+class ShardCompactor : public QThread
+{
+public:
+    struct Item {
+        QByteArray key;
+        qint64 metaOffset;
+        qint64 metaSize;
+        qint64 bodyOffset;
+        qint64 bodySize;
+        qint64 newOffset;
+        bool copied;
+        bool compressed;
+    };
+
+    ShardCompactor()
+        : shard(0)
+        , generation(0)
+        , snapshotSize(0)
+        , compactedSize(0)
+        , epoch(0)
+        , ok(false)
+    {
+    }
+
+    void compact();
+
+    int shard;
+    QString source;
+    QString target;
+    quint32 generation;
+    qint64 snapshotSize;
+    qint64 compactedSize;
+    QList<Item> items;
+    int epoch;
+    bool ok;
+
+protected:
+    void run()
+    {
+        compact();
+    }
+};
+
+void ShardCompactor::compact()
+{
+    ok = false;
+    QFile input(source);
+    QFile output(target);
+    if (!input.open(QFile::ReadOnly) || !output.open(QFile::WriteOnly | QFile::Truncate))
+        return;
+
+    {
+        QDataStream stream(&output);
+        stream << shardMagic << generation;
+    }
+
+    qint64 offset = shardHeaderSize;
+    for (int i = 0; i < items.count(); ++i) {
+        Item &item = items[i];
+        item.copied = false;
+        QByteArray meta;
+        QByteArray body;
+        if (input.seek(item.metaOffset))
+            meta = input.read(item.metaSize);
+        if (input.seek(item.bodyOffset))
+            body = input.read(item.bodySize);
+        if (meta.size() != item.metaSize || body.size() != item.bodySize)
+            continue;
+
+        quint8 type = NetworkCacheStore::InsertRecord;
+        if (item.compressed)
+            type |= NetworkCacheStore::CompressedFlag;
+        QByteArray header = recordHeader(type, meta.size(), body.size());
+        if (output.write(header) != header.size()
+            || output.write(meta) != meta.size()
+            || output.write(body) != body.size())
+            return;
+        item.newOffset = offset;
+        item.copied = true;
+        offset += header.size() + meta.size() + body.size();
+    }
+    output.close();
+    compactedSize = offset;
+    ok = output.error() == QFile::NoError;
+}
+
+NetworkCacheStore::Entry::Entry()
+    : shard(0)
+    , offset(0)
+    , size(0)
+    , metaOffset(0)
+    , metaSize(0)
+    , bodyOffset(0)
+    , bodySize(0)
+    , expires(0)
+    , lastAccess(0)
+    , compressed(false)
+    , hits(0)
+{
+}
+
+NetworkCacheStore::NetworkCacheStore(int shardCount, QObject *parent)
+    : QObject(parent)
+    , m_maximumSize(50 * 1024 * 1024)
+    , m_open(false)
+    , m_shardCount(qMax(1, shardCount))
+    , m_tick(0)
+    , m_indexChanged(false)
+    , m_compactor(0)
+    , m_epoch(0)
+{
+}
+
+NetworkCacheStore::~NetworkCacheStore()
+{
+    waitForCompaction();
+    saveIndex();
+    close();
+}
+
+QString NetworkCacheStore::directory() const
+{
+    return m_directory;
+}
+
+void NetworkCacheStore::setDirectory(const QString &directory)
+{
+    if (m_directory == directory)
+        return;
+    waitForCompaction();
+    saveIndex();
+    close();
+    m_directory = directory;
+}
+
+qint64 NetworkCacheStore::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void NetworkCacheStore::setMaximumSize(qint64 size)
+{
+    m_maximumSize = size;
+}
+
+int NetworkCacheStore::shardCount() const
+{
+    return m_shardCount;
+}
+
+QString NetworkCacheStore::shardFileName(int shard) const
+{
+    return m_directory + QString(QLatin1String("/shard%1.dat")).arg(shard);
+}
+
+QString NetworkCacheStore::indexFileName() const
+{
+    return m_directory + QLatin1String("/index.dat");
+}
+
+int NetworkCacheStore::shardForKey(const QByteArray &key) const
+{
+    return qHash(key) % m_shardCount;
+}
+
+static QByteArray encodeMetaData(const QNetworkCacheMetaData &metaData)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << metaData;
+    return data;
+}
+
+static QNetworkCacheMetaData decodeMetaData(const QByteArray &data)
+{
+    QNetworkCacheMetaData metaData;
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream >> metaData;
+    if (stream.status() != QDataStream::Ok)
+        return QNetworkCacheMetaData();
+    return metaData;
+}
+
+static uint expirationTime(const QNetworkCacheMetaData &metaData)
+{
+    QDateTime expirationDate = metaData.expirationDate();
+    return expirationDate.isValid() ? expirationDate.toTime_t() : 0;
+}
+
+bool NetworkCacheStore::open()
+{
+    if (m_open)
+        return true;
+    if (m_directory.isEmpty())
+        return false;
+
+    QDir dir;
+    if (!dir.mkpath(m_directory)) {
+        qWarning() << "NetworkCacheStore: Unable to create" << m_directory;
+        return false;
+    }
+
+    m_shards.fill(0, m_shardCount);
+    m_generations.fill(0, m_shardCount);
+    m_shardSizes.fill(0, m_shardCount);
+    m_liveSizes.fill(0, m_shardCount);
+    m_open = true;
+    for (int i = 0; i < m_shardCount; ++i) {
+        if (!openShard(i)) {
+            close();
+            return false;
+        }
+    }
+
+    m_indexChanged = false;
+    QVector<qint64> scanFrom = loadIndex();
+    for (int i = 0; i < m_shardCount; ++i)
+        scanShard(i, scanFrom.at(i));
+#ifdef NETWORKCACHESTORE_DEBUG
+    qDebug() << "NetworkCacheStore::" << __FUNCTION__ << m_directory << count() << size();
+#endif
+    return true;
+}
+
+void NetworkCacheStore::close()
+{
+    // Throw away the work of a running compactor
+    if (m_compactor) {
+        m_compactor->wait();
+        QFile::remove(m_compactor->target);
+        delete m_compactor;
+        m_compactor = 0;
+    }
+    ++m_epoch;
+    qDeleteAll(m_shards);
+    m_shards.clear();
+    m_entries.clear();
+    m_lru.clear();
+    m_tick = 0;
+    m_open = false;
+    m_indexChanged = false;
+}
+
+bool NetworkCacheStore::openShard(int shard)
+{
+    QFile *file = m_shards.at(shard);
+    if (!file) {
+        file = new QFile(shardFileName(shard));
+        m_shards[shard] = file;
+    }
+    if (!file->isOpen() && !file->open(QFile::ReadWrite)) {
+        qWarning() << "NetworkCacheStore: Unable to open" << file->fileName();
+        return false;
+    }
+
+    quint32 magic = 0;
+    quint32 generation = 0;
+    if (file->size() >= shardHeaderSize) {
+        QDataStream stream(file);
+        stream >> magic >> generation;
+    }
+    if (magic != shardMagic) {
+        generation = QDateTime::currentDateTime().toTime_t();
+        file->resize(0);
+        file->seek(0);
+        QDataStream stream(file);
+        stream << shardMagic << generation;
+        file->flush();
+    }
+    m_generations[shard] = generation;
+    m_shardSizes[shard] = file->size();
+    m_liveSizes[shard] = 0;
+    return true;
+}
+
+/*!
+    Loads the saved index and returns for every shard the offset from which
+    records have to be read because they are not in the index.
+ */
+QVector<qint64> NetworkCacheStore::loadIndex()
+{
+    QVector<qint64> scanFrom(m_shardCount, shardHeaderSize);
+    QFile file(indexFileName());
+    if (!file.open(QFile::ReadOnly)) {
+        m_indexChanged = true;
+        return scanFrom;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    quint32 magic;
+    qint32 version;
+    qint32 shardCount;
+    quint64 tick;
+    stream >> magic >> version >> shardCount >> tick;
+    if (stream.status() != QDataStream::Ok
+        || magic != indexMagic
+        || version != indexVersion
+        || shardCount != m_shardCount) {
+        m_indexChanged = true;
+        return scanFrom;
+    }
+
+    QVector<bool> valid(m_shardCount);
+    QVector<qint64> indexedSizes(m_shardCount);
+    for (int i = 0; i < m_shardCount; ++i) {
+        quint32 generation;
+        qint64 size;
+        stream >> generation >> size;
+        valid[i] = generation == m_generations.at(i)
+                   && size >= shardHeaderSize
+                   && size <= m_shardSizes.at(i);
+        indexedSizes[i] = size;
+        if (!valid.at(i))
+            m_indexChanged = true;
+    }
+
+    qint32 count;
+    stream >> count;
+    m_tick = tick;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray key;
+        Entry entry;
+        qint32 shard;
+        stream >> key >> shard >> entry.offset >> entry.size
+               >> entry.metaOffset >> entry.metaSize >> entry.bodyOffset >> entry.bodySize
+               >> entry.expires >> entry.lastAccess >> entry.compressed >> entry.hits;
+        if (shard < 0 || shard >= m_shardCount || !valid.at(shard))
+            continue;
+        entry.shard = shard;
+        m_entries.insert(key, entry);
+        m_lru.insert(entry.lastAccess, key);
+        m_liveSizes[shard] += entry.size;
+        m_tick = qMax(m_tick, entry.lastAccess);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "NetworkCacheStore: Corrupt index, rebuilding it";
+        m_entries.clear();
+        m_lru.clear();
+        m_liveSizes.fill(0);
+        m_tick = 0;
+        m_indexChanged = true;
+        return scanFrom;
+    }
+
+    for (int i = 0; i < m_shardCount; ++i) {
+        if (valid.at(i))
+            scanFrom[i] = indexedSizes.at(i);
+    }
+    return scanFrom;
+}
+
+/*!
+    Applies the records of \a shard starting at \a from to the index.  A
+    record that was only partly written is cut off.
+ */
+void NetworkCacheStore::scanShard(int shard, qint64 from)
+{
+    QFile *file = m_shards.at(shard);
+    qint64 shardSize = m_shardSizes.at(shard);
+    qint64 offset = from;
+    while (offset + recordHeaderSize <= shardSize) {
+        if (!file->seek(offset))
+            break;
+        QByteArray header = file->read(recordHeaderSize);
+        if (header.size() != recordHeaderSize)
+            break;
+        QDataStream stream(header);
+        quint32 magic;
+        quint8 type;
+        quint32 metaSize;
+        quint32 bodySize;
+        stream >> magic >> type >> metaSize >> bodySize;
+        bool compressed = type & CompressedFlag;
+        type &= ~CompressedFlag;
+        qint64 size = recordHeaderSize + metaSize + bodySize;
+        if (magic != recordMagic || offset + size > shardSize)
+            break;
+
+        QByteArray meta = file->read(metaSize);
+        if (meta.size() != (int)metaSize)
+            break;
+        QNetworkCacheMetaData metaData = decodeMetaData(meta);
+        QByteArray key = metaData.url().toEncoded();
+        if (key.isEmpty()) {
+            offset += size;
+            continue;
+        }
+        QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+
+        switch (type) {
+        case InsertRecord: {
+            if (it != m_entries.end())
+                dropEntry(it);
+            Entry &entry = m_entries[key];
+            entry.shard = shard;
+            entry.offset = offset;
+            entry.size = size;
+            entry.metaOffset = offset + recordHeaderSize;
+            entry.metaSize = metaSize;
+            entry.bodyOffset = entry.metaOffset + metaSize;
+            entry.bodySize = bodySize;
+            entry.expires = expirationTime(metaData);
+            entry.compressed = compressed;
+            touch(key, entry);
+            m_liveSizes[shard] += entry.size;
+            break;
+        }
+        case UpdateRecord:
+            if (it != m_entries.end() && it->shard == shard) {
+                m_liveSizes[shard] -= it->size;
+                it->metaOffset = offset + recordHeaderSize;
+                it->metaSize = metaSize;
+                it->size = recordHeaderSize + metaSize + it->bodySize;
+                it->expires = expirationTime(metaData);
+                m_liveSizes[shard] += it->size;
+                touch(key, *it);
+            }
+            break;
+        case RemoveRecord:
+            if (it != m_entries.end())
+                dropEntry(it);
+            break;
+        default:
+            break;
+        }
+        m_indexChanged = true;
+        offset += size;
+    }
+
+    if (offset < shardSize) {
+        qWarning() << "NetworkCacheStore: Truncating damaged shard" << file->fileName() << "at" << offset;
+        file->resize(offset);
+        m_shardSizes[shard] = offset;
+        m_indexChanged = true;
+    }
+}
+
+/*
+    Copies the \a size bytes of \a from to \a to in chunks so a big body
+    is never held in memory as a whole.
+ */
+static bool copyData(QIODevice *from, QIODevice *to, qint64 size)
+{
+    if (!from->seek(0))
+        return false;
+    while (size > 0) {
+        QByteArray chunk = from->read(qMin(size, qint64(64 * 1024)));
+        if (chunk.isEmpty() || to->write(chunk) != chunk.size())
+            return false;
+        size -= chunk.size();
+    }
+    return true;
+}
+
+bool NetworkCacheStore::append(int shard, RecordType type, const QNetworkCacheMetaData &metaData,
+                               QIODevice *body, Entry *entry, bool compressed)
+{
+    QByteArray meta = encodeMetaData(metaData);
+    quint8 flags = compressed ? CompressedFlag : 0;
+    qint64 bodySize = body ? body->size() : 0;
+    QByteArray header = recordHeader(type | flags, meta.size(), bodySize);
+    QFile *file = m_shards.at(shard);
+    qint64 offset = m_shardSizes.at(shard);
+    if (!file->seek(offset)
+        || file->write(header) != header.size()
+        || file->write(meta) != meta.size()
+        || (body && !copyData(body, file, bodySize))
+        || !file->flush()) {
+        qWarning() << "NetworkCacheStore: Unable to write to" << file->fileName() << file->errorString();
+        file->resize(offset);
+        return false;
+    }
+
+    qint64 size = recordHeaderSize + meta.size() + bodySize;
+    m_shardSizes[shard] += size;
+    if (entry) {
+        entry->shard = shard;
+        entry->offset = offset;
+        entry->size = size;
+        entry->metaOffset = offset + recordHeaderSize;
+        entry->metaSize = meta.size();
+        entry->bodyOffset = entry->metaOffset + meta.size();
+        entry->bodySize = bodySize;
+        entry->expires = expirationTime(metaData);
+        entry->compressed = compressed;
+    }
+    m_indexChanged = true;
+    return true;
+}
+
+void NetworkCacheStore::touch(const QByteArray &key, Entry &entry)
+{
+    if (entry.lastAccess)
+        m_lru.remove(entry.lastAccess);
+    entry.lastAccess = ++m_tick;
+    m_lru.insert(entry.lastAccess, key);
+}
+
+void NetworkCacheStore::dropEntry(QHash<QByteArray, Entry>::iterator it)
+{
+    m_lru.remove(it->lastAccess);
+    m_liveSizes[it->shard] -= it->size;
+    m_entries.erase(it);
+    m_indexChanged = true;
+}
+
+bool NetworkCacheStore::contains(const QUrl &url)
+{
+    if (!open())
+        return false;
+    return m_entries.contains(url.toEncoded());
+}
+
+NetworkCacheStore::Entry NetworkCacheStore::entry(const QUrl &url)
+{
+    if (!open())
+        return Entry();
+    return m_entries.value(url.toEncoded());
+}
+
+QList<QUrl> NetworkCacheStore::urls()
+{
+    QList<QUrl> list;
+    if (!open())
+        return list;
+    QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it)
+        list.append(QUrl::fromEncoded(it.key()));
+    return list;
+}
+
+int NetworkCacheStore::count()
+{
+    if (!open())
+        return 0;
+    return m_entries.count();
+}
+
+/*!
+    Returns the number of bytes used on disk.
+ */
+qint64 NetworkCacheStore::size()
+{
+    if (!open())
+        return 0;
+    qint64 total = 0;
+    for (int i = 0; i < m_shardCount; ++i)
+        total += m_shardSizes.at(i);
+    return total;
+}
+
+/*!
+    Returns the number of bytes used by entries that are still in the index.
+ */
+qint64 NetworkCacheStore::liveSize()
+{
+    if (!open())
+        return 0;
+    qint64 total = 0;
+    for (int i = 0; i < m_shardCount; ++i)
+        total += m_liveSizes.at(i);
+    return total;
+}
+
+/*!
+    Returns the number of bytes in \a shard that compacting would reclaim.
+ */
+qint64 NetworkCacheStore::deadSize(int shard)
+{
+    if (!open() || shard < 0 || shard >= m_shardCount)
+        return 0;
+    return qMax(qint64(0), m_shardSizes.at(shard) - shardHeaderSize - m_liveSizes.at(shard));
+}
+
+/*!
+    Reads the meta data and the uncompressed body of \a entry from \a shard,
+    either can be 0.  Returns false if the entry is damaged.
+
+    This does not use the store so it can be called from any thread.
+ */
+bool NetworkCacheStore::readEntry(QIODevice *shard, const Entry &entry,
+                                  QNetworkCacheMetaData *metaData, QByteArray *data)
+{
+    if (metaData) {
+        if (!shard->seek(entry.metaOffset))
+            return false;
+        *metaData = decodeMetaData(shard->read(entry.metaSize));
+        if (!metaData->isValid())
+            return false;
+    }
+    if (data) {
+        if (!shard->seek(entry.bodyOffset))
+            return false;
+        *data = shard->read(entry.bodySize);
+        if (data->size() != entry.bodySize)
+            return false;
+        if (entry.compressed) {
+            *data = qUncompress(*data);
+            if (data->isEmpty())
+                return false;
+        }
+    }
+    return true;
+}
+
+QNetworkCacheMetaData NetworkCacheStore::metaData(const QUrl &url)
+{
+    if (!open())
+        return QNetworkCacheMetaData();
+    QByteArray key = url.toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return QNetworkCacheMetaData();
+
+    QNetworkCacheMetaData metaData;
+    if (!readEntry(m_shards.at(it->shard), *it, &metaData, 0)
+        || metaData.url().toEncoded() != key) {
+        qWarning() << "NetworkCacheStore: Dropping unreadable entry for" << url;
+        dropEntry(it);
+        return QNetworkCacheMetaData();
+    }
+    touch(key, *it);
+    return metaData;
+}
+
+QByteArray NetworkCacheStore::data(const QUrl &url)
+{
+    if (!open())
+        return QByteArray();
+    QByteArray key = url.toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return QByteArray();
+
+    QByteArray body;
+    if (!readEntry(m_shards.at(it->shard), *it, 0, &body)) {
+        qWarning() << "NetworkCacheStore: Dropping unreadable entry for" << url;
+        dropEntry(it);
+        return QByteArray();
+    }
+    ++it->hits;
+    touch(key, *it);
+    m_indexChanged = true;
+    return body;
+}
+
+/*!
+    Counts a use of the entry for \a url that was served from a copy held
+    outside of the store.
+ */
+void NetworkCacheStore::recordHit(const QUrl &url)
+{
+    if (!open())
+        return;
+    QByteArray key = url.toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return;
+    ++it->hits;
+    touch(key, *it);
+    m_indexChanged = true;
+}
+
+/*!
+    Stores \a data for the url of \a metaData.  When \a compress is true the
+    data is stored compressed if that makes it noticeably smaller.
+ */
+bool NetworkCacheStore::insert(const QNetworkCacheMetaData &metaData, const QByteArray &data, bool compress)
+{
+    // Favor speed, most of the gain on text comes from the first level
+    QByteArray compressed;
+    if (compress && !data.isEmpty()) {
+        compressed = qCompress(data, 1);
+        if (compressed.size() > data.size() - data.size() / 8)
+            compressed.clear();
+    }
+
+    QBuffer buffer;
+    buffer.setData(compressed.isEmpty() ? data : compressed);
+    buffer.open(QBuffer::ReadOnly);
+    return insertRecord(metaData, &buffer, !compressed.isEmpty());
+}
+
+/*!
+    Stores the contents of \a data uncompressed for the url of \a metaData,
+    it is copied over a chunk at a time.
+ */
+bool NetworkCacheStore::insert(const QNetworkCacheMetaData &metaData, QIODevice *data)
+{
+    return insertRecord(metaData, data, false);
+}
+
+bool NetworkCacheStore::insertRecord(const QNetworkCacheMetaData &metaData, QIODevice *body, bool compressed)
+{
+    if (!open() || !metaData.isValid())
+        return false;
+    QByteArray key = metaData.url().toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it != m_entries.end())
+        dropEntry(it);
+
+    int shard = shardForKey(key);
+    Entry entry;
+    if (!append(shard, InsertRecord, metaData, body, &entry, compressed))
+        return false;
+    Entry &stored = m_entries[key];
+    stored = entry;
+    touch(key, stored);
+    m_liveSizes[shard] += stored.size;
+
+    if (size() > m_maximumSize)
+        expire();
+    return true;
+}
+
+bool NetworkCacheStore::updateMetaData(const QNetworkCacheMetaData &metaData)
+{
+    if (!open() || !metaData.isValid())
+        return false;
+    QByteArray key = metaData.url().toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return false;
+
+    Entry update;
+    if (!append(it->shard, UpdateRecord, metaData, 0, &update))
+        return false;
+    m_liveSizes[it->shard] -= it->size;
+    it->metaOffset = update.metaOffset;
+    it->metaSize = update.metaSize;
+    it->size = recordHeaderSize + it->metaSize + it->bodySize;
+    it->expires = update.expires;
+    m_liveSizes[it->shard] += it->size;
+    touch(key, *it);
+    return true;
+}
+
+bool NetworkCacheStore::remove(const QUrl &url)
+{
+    if (!open())
+        return false;
+    QByteArray key = url.toEncoded();
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end())
+        return false;
+
+    // Record the removal so that replaying the shard does not bring it back
+    QNetworkCacheMetaData metaData;
+    metaData.setUrl(url);
+    append(it->shard, RemoveRecord, metaData, 0, 0);
+    dropEntry(it);
+    return true;
+}
+
+void NetworkCacheStore::clear()
+{
+    close();
+    if (m_directory.isEmpty())
+        return;
+    for (int i = 0; i < m_shardCount; ++i)
+        QFile::remove(shardFileName(i));
+    QFile::remove(indexFileName());
+}
+
+/*!
+    Evicts the least recently used entries until the entries fit in
+    maximumSize() and starts compacting the shards in the background.
+ */
+void NetworkCacheStore::expire()
+{
+    if (!open() || size() <= m_maximumSize)
+        return;
+
+    // Leave some room so that the next inserts don't evict again right away
+    qint64 target = m_maximumSize * 9 / 10;
+    while (!m_lru.isEmpty() && liveSize() > target) {
+        QHash<QByteArray, Entry>::iterator it = m_entries.find(m_lru.begin().value());
+        if (it == m_entries.end())
+            m_lru.erase(m_lru.begin());
+        else
+            dropEntry(it);
+    }
+
+    if (!m_compactor) {
+        int shard = mostFragmentedShard();
+        if (shard != -1) {
+            m_compactor = createCompactor(shard);
+            connect(m_compactor, SIGNAL(finished()),
+                    this, SLOT(compactionFinished()));
+            m_compactor->start(QThread::LowestPriority);
+        }
+    }
+#ifdef NETWORKCACHESTORE_DEBUG
+    qDebug() << "NetworkCacheStore::" << __FUNCTION__ << count() << liveSize() << size();
+#endif
+}
+
+int NetworkCacheStore::mostFragmentedShard()
+{
+    int worst = -1;
+    for (int i = 0; i < m_shardCount; ++i) {
+        if (deadSize(i) > 0 && (worst == -1 || deadSize(i) > deadSize(worst)))
+            worst = i;
+    }
+    return worst;
+}
+
+bool NetworkCacheStore::isCompacting() const
+{
+    return m_compactor != 0;
+}
+
+/*!
+    Blocks until the shards have been compacted enough to fit in maximumSize().
+ */
+void NetworkCacheStore::waitForCompaction()
+{
+    while (m_compactor) {
+        m_compactor->wait();
+        compactionFinished();
+    }
+}
+
+void NetworkCacheStore::compactionFinished()
+{
+    // A queued signal can arrive after the compactor was already handled
+    if (!m_compactor || !m_compactor->isFinished())
+        return;
+
+    ShardCompactor *compactor = m_compactor;
+    m_compactor = 0;
+    if (compactor->epoch != m_epoch || !finishCompaction(compactor))
+        QFile::remove(compactor->target);
+    compactor->deleteLater();
+
+    if (size() > m_maximumSize)
+        expire();
+}
+
+/*!
+    Rewrites \a shard so that it only contains the entries in the index.
+ */
+bool NetworkCacheStore::compact(int shard)
+{
+    waitForCompaction();
+    if (!open() || shard < 0 || shard >= m_shardCount)
+        return false;
+
+    ShardCompactor *compactor = createCompactor(shard);
+    compactor->compact();
+    bool compacted = finishCompaction(compactor);
+    if (!compacted)
+        QFile::remove(compactor->target);
+    delete compactor;
+    return compacted;
+}
+
+ShardCompactor *NetworkCacheStore::createCompactor(int shard)
+{
+    ShardCompactor *compactor = new ShardCompactor;
+    compactor->shard = shard;
+    compactor->source = shardFileName(shard);
+    compactor->target = compactor->source + QLatin1String(".tmp");
+    compactor->generation = m_generations.at(shard) + 1;
+    compactor->snapshotSize = m_shardSizes.at(shard);
+    compactor->epoch = m_epoch;
+
+    // Keep the file order so the shard is read sequentially
+    QMap<qint64, QByteArray> order;
+    QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        if (it->shard == shard && it->bodyOffset < compactor->snapshotSize)
+            order.insert(it->bodyOffset, it.key());
+    }
+    QMap<qint64, QByteArray>::const_iterator ordered = order.constBegin();
+    for (; ordered != order.constEnd(); ++ordered) {
+        const Entry &entry = m_entries[ordered.value()];
+        ShardCompactor::Item item;
+        item.key = ordered.value();
+        item.metaOffset = entry.metaOffset;
+        item.metaSize = entry.metaSize;
+        item.bodyOffset = entry.bodyOffset;
+        item.bodySize = entry.bodySize;
+        item.newOffset = 0;
+        item.copied = false;
+        item.compressed = entry.compressed;
+        compactor->items.append(item);
+    }
+    return compactor;
+}
+
+/*!
+    Appends the records written since \a compactor took its snapshot to the
+    compacted file, replaces the shard with it and moves the index over.
+ */
+bool NetworkCacheStore::finishCompaction(ShardCompactor *compactor)
+{
+    if (!compactor->ok)
+        return false;
+
+    int shard = compactor->shard;
+    QFile *file = m_shards.at(shard);
+    QFile compacted(compactor->target);
+    if (!compacted.open(QFile::ReadWrite) || !compacted.seek(compactor->compactedSize))
+        return false;
+    qint64 offset = compactor->snapshotSize;
+    while (offset < m_shardSizes.at(shard)) {
+        if (!file->seek(offset))
+            return false;
+        QByteArray tail = file->read(qMin(m_shardSizes.at(shard) - offset, qint64(64 * 1024)));
+        if (tail.isEmpty() || compacted.write(tail) != tail.size())
+            return false;
+        offset += tail.size();
+    }
+    compacted.close();
+    if (compacted.error() != QFile::NoError)
+        return false;
+
+    file->close();
+    bool replaced = QFile::remove(compactor->source) && compacted.rename(compactor->source);
+    if (!replaced)
+        qWarning() << "NetworkCacheStore: Unable to replace" << compactor->source;
+
+    QHash<QByteArray, const ShardCompactor::Item*> items;
+    for (int i = 0; i < compactor->items.count(); ++i) {
+        const ShardCompactor::Item &item = compactor->items.at(i);
+        if (item.copied)
+            items.insert(item.key, &item);
+    }
+
+    // Records from the snapshot moved to the front of the file, the
+    // records appended since then all moved by the same amount
+    qint64 delta = compactor->compactedSize - compactor->snapshotSize;
+    QList<QByteArray> keys;
+    QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        if (it->shard == shard)
+            keys.append(it.key());
+    }
+    foreach (const QByteArray &key, keys) {
+        QHash<QByteArray, Entry>::iterator entry = m_entries.find(key);
+        const ShardCompactor::Item *item = items.value(key);
+        bool moved = replaced;
+        if (entry->bodyOffset >= compactor->snapshotSize) {
+            entry->offset += delta;
+            entry->bodyOffset += delta;
+        } else if (item && item->bodyOffset == entry->bodyOffset) {
+            entry->offset = item->newOffset;
+            entry->bodyOffset = item->newOffset + recordHeaderSize + item->metaSize;
+        } else {
+            moved = false;
+        }
+        if (entry->metaOffset >= compactor->snapshotSize)
+            entry->metaOffset += delta;
+        else if (item && item->metaOffset == entry->metaOffset)
+            entry->metaOffset = item->newOffset + recordHeaderSize;
+        else
+            moved = false;
+        if (!moved)
+            dropEntry(entry);
+    }
+
+    if (!openShard(shard))
+        return false;
+    it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        if (it->shard == shard)
+            m_liveSizes[shard] += it->size;
+    }
+    m_indexChanged = true;
+    saveIndex();
+#ifdef NETWORKCACHESTORE_DEBUG
+    qDebug() << "NetworkCacheStore::" << __FUNCTION__ << shard << m_shardSizes.at(shard);
+#endif
+    return replaced;
+}
+
+bool NetworkCacheStore::saveIndex()
+{
+    if (!m_open || !m_indexChanged)
+        return true;
+
+    QString fileName = indexFileName();
+    QFile file(fileName + QLatin1String(".tmp"));
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "NetworkCacheStore: Unable to save" << fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_5);
+    stream << indexMagic << indexVersion << qint32(m_shardCount) << m_tick;
+    for (int i = 0; i < m_shardCount; ++i)
+        stream << m_generations.at(i) << m_shardSizes.at(i);
+    stream << qint32(m_entries.count());
+    QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        const Entry &entry = it.value();
+        stream << it.key() << qint32(entry.shard) << entry.offset << entry.size
+               << entry.metaOffset << entry.metaSize << entry.bodyOffset << entry.bodySize
+               << entry.expires << entry.lastAccess << entry.compressed << entry.hits;
+    }
+    file.close();
+    if (file.error() != QFile::NoError) {
+        file.remove();
+        return false;
+    }
+
+    QFile::remove(fileName);
+    if (!file.rename(fileName))
+        return false;
+    m_indexChanged = false;
+    return true;
+}
+
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef NETWORKCACHESTORE_H
+#define NETWORKCACHESTORE_H
+
+#include <qobject.h>
+
+#include <qabstractnetworkcache.h>
+#include <qhash.h>
+#include <qmap.h>
+#include <qurl.h>
+#include <qvector.h>
+
+class QFile;
+class QIODevice;
+class ShardCompactor;
+
+/*
+    Stores cache entries in a fixed number of append only shard files.
+
+    An index of every entry is kept in memory and saved to index.dat so
+    looking up, evicting or measuring the cache never touches the
+    directory.  Entries are assigned to a shard by url.  Replacing or
+    removing an entry only updates the index, the space is reclaimed
+    when the shard is compacted.
+
+    Each shard starts with a small header holding a generation that is
+    bumped on every compaction.  When the index was saved for an older
+    generation, or is missing, the shard is scanned to rebuild it.
+    Records appended after the index was saved are replayed.
+
+    Evicting only drops entries from the index.  The space is reclaimed
+    by a worker thread that copies the live records of a snapshot of the
+    shard to a new file.  Records appended in the meantime are copied
+    over when the worker is done, before the new file replaces the shard.
+*/
+class NetworkCacheStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry {
+        Entry();
+
+        int shard;
+        qint64 offset;
+        qint64 size;
+        qint64 metaOffset;
+        qint64 metaSize;
+        qint64 bodyOffset;
+        qint64 bodySize;
+        uint expires;
+        quint64 lastAccess;
+        bool compressed;
+        quint32 hits;
+    };
+
+    NetworkCacheStore(int shardCount = 8, QObject *parent = 0);
+    ~NetworkCacheStore();
+
+    QString directory() const;
+    void setDirectory(const QString &directory);
+
+    qint64 maximumSize() const;
+    void setMaximumSize(qint64 size);
+
+    int shardCount() const;
+    QString shardFileName(int shard) const;
+    QString indexFileName() const;
+
+    bool contains(const QUrl &url);
+    Entry entry(const QUrl &url);
+    QList<QUrl> urls();
+    int count();
+    qint64 size();
+    qint64 liveSize();
+    qint64 deadSize(int shard);
+
+    QNetworkCacheMetaData metaData(const QUrl &url);
+    QByteArray data(const QUrl &url);
+    void recordHit(const QUrl &url);
+    static bool readEntry(QIODevice *shard, const Entry &entry,
+                          QNetworkCacheMetaData *metaData, QByteArray *data);
+    bool insert(const QNetworkCacheMetaData &metaData, const QByteArray &data, bool compress = false);
+    bool insert(const QNetworkCacheMetaData &metaData, QIODevice *data);
+    bool updateMetaData(const QNetworkCacheMetaData &metaData);
+    bool remove(const QUrl &url);
+    void clear();
+
+    void expire();
+    bool compact(int shard);
+    bool isCompacting() const;
+    void waitForCompaction();
+    bool saveIndex();
+
+private slots:
+    void compactionFinished();
+
+private:
+    friend class ShardCompactor;
+    enum RecordType {
+        InsertRecord = 1,
+        UpdateRecord = 2,
+        RemoveRecord = 3,
+        CompressedFlag = 0x80
+    };
+
+    bool open();
+    void close();
+    QVector<qint64> loadIndex();
+    bool openShard(int shard);
+    void scanShard(int shard, qint64 from);
+    bool append(int shard, RecordType type, const QNetworkCacheMetaData &metaData,
+                QIODevice *body, Entry *entry, bool compressed = false);
+    bool insertRecord(const QNetworkCacheMetaData &metaData, QIODevice *body, bool compressed);
+    void touch(const QByteArray &key, Entry &entry);
+    void dropEntry(QHash<QByteArray, Entry>::iterator it);
+    int shardForKey(const QByteArray &key) const;
+    int mostFragmentedShard();
+    ShardCompactor *createCompactor(int shard);
+    bool finishCompaction(ShardCompactor *compactor);
+
+    QString m_directory;
+    qint64 m_maximumSize;
+    bool m_open;
+    int m_shardCount;
+    QVector<QFile*> m_shards;
+    QVector<quint32> m_generations;
+    QVector<qint64> m_shardSizes;
+    QVector<qint64> m_liveSizes;
+    QHash<QByteArray, Entry> m_entries;
+    QMap<quint64, QByteArray> m_lru;
+    quint64 m_tick;
+    bool m_indexChanged;
+    ShardCompactor *m_compactor;
+    int m_epoch;
+};
+
+#endif // NETWORKCACHESTORE_H
+
@@ -28,15 +28,118 @@
 
 #include "networkdiskcache.h"
 
+#include "autosaver.h"
 #include "browserapplication.h"
+#include "networkcachestore.h"
 
+#include <qbuffer.h>
 #include <qdesktopservices.h>
+#include <qdir.h>
+#include <qfile.h>
+#include <qnetworkdiskcache.h>
 #include <qsettings.h>
+#include <qstringlist.h>
+#include <qtemporaryfile.h>
+
+#include <qdebug.h>
+
+// #define NETWORKDISKCACHE_DEBUG
+
+// Bodies up to this size are collected and compressed in memory
+static const qint64 maximumBufferedBodySize = 1024 * 1024;
+
+/*
+    Collects the body of a reply that is being cached.  The body is kept
+    in memory until it gets bigger than maximumBufferedBodySize, from then
+    on it goes to a temporary file.  A body that gets bigger than
+    \a maximumSize is dropped.
+*/
+class CacheBodyDevice : public QIODevice
+{
+public:
+    CacheBodyDevice(qint64 maximumSize)
+        : m_file(0)
+        , m_size(0)
+        , m_maximumSize(maximumSize)
+        , m_failed(false)
+    {
+        open(QIODevice::WriteOnly);
+    }
+
+    ~CacheBodyDevice()
+    {
+        delete m_file;
+    }
+
+    bool failed() const { return m_failed; }
+    QByteArray buffer() const { return m_buffer; }
+    QFile *file() const { return m_file; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+    qint64 writeData(const char *data, qint64 length)
+    {
+        if (m_failed || m_size + length > m_maximumSize)
+            return fail();
+        if (!m_file && m_size + length > maximumBufferedBodySize) {
+            m_file = new QTemporaryFile;
+            if (!m_file->open() || m_file->write(m_buffer) != m_buffer.size())
+                return fail();
+            m_buffer.clear();
+        }
+        if (m_file && m_file->write(data, length) != length)
+            return fail();
+        if (!m_file)
+            m_buffer.append(data, length);
+        m_size += length;
+        return length;
+    }
+
+private:
+    qint64 fail()
+    {
+        m_failed = true;
+        m_buffer.clear();
+        delete m_file;
+        m_file = 0;
+        return -1;
+    }
+
+    QTemporaryFile *m_file;
+    QByteArray m_buffer;
+    qint64 m_size;
+    qint64 m_maximumSize;
+    bool m_failed;
+};
+
+static QStringList defaultCompressedContentTypes()
+{
+    return QStringList()
+        << QLatin1String("text/")
+        << QLatin1String("application/javascript")
+        << QLatin1String("application/x-javascript")
+        << QLatin1String("application/json")
+        << QLatin1String("application/xml")
+        << QLatin1String("application/xhtml+xml")
+        << QLatin1String("image/svg+xml");
+}
 
 NetworkDiskCache::NetworkDiskCache(QObject *parent)
-    : QNetworkDiskCache(parent)
+    : QAbstractNetworkCache(parent)
     , m_private(false)
+    , m_store(new NetworkCacheStore)
+    , m_saveTimer(new AutoSaver(this))
 {
+    m_memoryCache.setMaxCost(8 * 1024 * 1024);
+    m_compressedContentTypes = defaultCompressedContentTypes();
+    for (int i = 0; i <= Miss; ++i)
+        m_hitCounts[i] = 0;
     QString diskCacheDirectory = QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
                                 + QLatin1String("/browser");
     setCacheDirectory(diskCacheDirectory);
@@ -44,6 +147,13 @@ NetworkDiskCache::NetworkDiskCache(QObject *parent)
             this, SLOT(privacyChanged(bool)));
 }
 
+NetworkDiskCache::~NetworkDiskCache()
+{
+    m_saveTimer->saveIfNeccessary();
+    qDeleteAll(m_inserting.keys());
+    delete m_store;
+}
+
 void NetworkDiskCache::loadSettings()
 {
     QSettings settings;
@@ -51,6 +161,134 @@ void NetworkDiskCache::loadSettings()
     qint64 maximumCacheSize = settings.value(QLatin1String("maximumCacheSize"), 50).toInt();
     maximumCacheSize = maximumCacheSize * 1024 * 1024;
     setMaximumCacheSize(maximumCacheSize);
+    int maximumMemoryCacheSize = settings.value(QLatin1String("maximumMemoryCacheSize"), 8).toInt();
+    setMaximumMemoryCacheSize(maximumMemoryCacheSize * 1024 * 1024);
+    setCompressedContentTypes(settings.value(QLatin1String("compressedCacheContentTypes"),
+                                             defaultCompressedContentTypes()).toStringList());
+}
+
+QString NetworkDiskCache::cacheDirectory() const
+{
+    return m_store->directory();
+}
+
+void NetworkDiskCache::setCacheDirectory(const QString &cacheDirectory)
+{
+    m_store->setDirectory(cacheDirectory);
+    removeLegacyCache();
+}
+
+/*!
+    Earlier versions used QNetworkDiskCache which stored a file per entry in
+    the same directory, remove those files the first time the store is used.
+ */
+void NetworkDiskCache::removeLegacyCache()
+{
+    if (QFile::exists(m_store->indexFileName()))
+        return;
+    QDir dir(m_store->directory());
+    if (dir.entryList(QStringList() << QLatin1String("data*"), QDir::Dirs).isEmpty())
+        return;
+    QNetworkDiskCache legacyCache;
+    legacyCache.setCacheDirectory(m_store->directory());
+    legacyCache.clear();
+}
+
+qint64 NetworkDiskCache::maximumCacheSize() const
+{
+    return m_store->maximumSize();
+}
+
+void NetworkDiskCache::setMaximumCacheSize(qint64 size)
+{
+    m_store->setMaximumSize(size);
+    m_store->expire();
+}
+
+int NetworkDiskCache::maximumMemoryCacheSize() const
+{
+    return m_memoryCache.maxCost();
+}
+
+/*!
+    Sets the number of bytes of recently used entries that are kept in
+    memory in front of the disk cache.
+ */
+void NetworkDiskCache::setMaximumMemoryCacheSize(int size)
+{
+    m_memoryCache.setMaxCost(size);
+}
+
+int NetworkDiskCache::memoryCacheSize() const
+{
+    return m_memoryCache.totalCost();
+}
+
+int NetworkDiskCache::hitCount(Tier tier) const
+{
+    return m_hitCounts[tier];
+}
+
+/*!
+    Returns the share of data() calls that were answered by \a tier.
+ */
+qreal NetworkDiskCache::hitRatio(Tier tier) const
+{
+    int total = 0;
+    for (int i = 0; i <= Miss; ++i)
+        total += m_hitCounts[i];
+    if (total == 0)
+        return 0;
+    return qreal(m_hitCounts[tier]) / total;
+}
+
+QStringList NetworkDiskCache::compressedContentTypes() const
+{
+    return m_compressedContentTypes;
+}
+
+/*!
+    Sets the content types that are compressed on disk, a type ending with
+    a '/' matches all of its subtypes.
+ */
+void NetworkDiskCache::setCompressedContentTypes(const QStringList &contentTypes)
+{
+    m_compressedContentTypes = contentTypes;
+}
+
+bool NetworkDiskCache::shouldCompress(const QNetworkCacheMetaData &metaData) const
+{
+    if (m_compressedContentTypes.isEmpty())
+        return false;
+
+    QString contentType;
+    foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders()) {
+        if (header.first.toLower() == "content-type") {
+            contentType = QString::fromLatin1(header.second).section(QLatin1Char(';'), 0, 0);
+            contentType = contentType.trimmed().toLower();
+            break;
+        }
+    }
+    if (contentType.isEmpty())
+        return false;
+
+    foreach (const QString &type, m_compressedContentTypes) {
+        if (type.endsWith(QLatin1Char('/')) ? contentType.startsWith(type) : contentType == type)
+            return true;
+    }
+    return false;
+}
+
+void NetworkDiskCache::insertIntoMemory(const QNetworkCacheMetaData &metaData, const QByteArray &data)
+{
+    // Big entries would push out many of the small ones that are reused most
+    int cost = data.size();
+    if (cost > m_memoryCache.maxCost() / 8)
+        return;
+    MemoryEntry *entry = new MemoryEntry;
+    entry->metaData = metaData;
+    entry->data = data;
+    m_memoryCache.insert(metaData.url().toEncoded(), entry, qMax(1, cost));
 }
 
 void NetworkDiskCache::privacyChanged(bool isPrivate)
@@ -58,10 +296,132 @@ void NetworkDiskCache::privacyChanged(bool isPrivate)
     m_private = isPrivate;
 }
 
+void NetworkDiskCache::save()
+{
+    m_store->saveIndex();
+}
+
+QNetworkCacheMetaData NetworkDiskCache::metaData(const QUrl &url)
+{
+    if (MemoryEntry *entry = m_memoryCache.object(url.toEncoded()))
+        return entry->metaData;
+    return m_store->metaData(url);
+}
+
+void NetworkDiskCache::updateMetaData(const QNetworkCacheMetaData &metaData)
+{
+    if (MemoryEntry *entry = m_memoryCache.object(metaData.url().toEncoded()))
+        entry->metaData = metaData;
+    if (m_store->updateMetaData(metaData))
+        m_saveTimer->changeOccurred();
+}
+
+QIODevice *NetworkDiskCache::data(const QUrl &url)
+{
+    QByteArray key = url.toEncoded();
+    QBuffer *buffer = 0;
+    if (MemoryEntry *entry = m_memoryCache.object(key)) {
+        ++m_hitCounts[MemoryTier];
+        m_store->recordHit(url);
+        // Shares the data with the memory cache rather than copying it
+        buffer = new QBuffer;
+        buffer->setData(entry->data);
+    } else if (m_store->contains(url)) {
+        QByteArray data = m_store->data(url);
+        if (data.isEmpty() && !m_store->contains(url)) {
+            ++m_hitCounts[Miss];
+            return 0;
+        }
+        ++m_hitCounts[DiskTier];
+        insertIntoMemory(m_store->metaData(url), data);
+        buffer = new QBuffer;
+        buffer->setData(data);
+    } else {
+        ++m_hitCounts[Miss];
+        return 0;
+    }
+#ifdef NETWORKDISKCACHE_DEBUG
+    qDebug() << "NetworkDiskCache::" << __FUNCTION__ << url
+             << "memory:" << hitRatio(MemoryTier) << "disk:" << hitRatio(DiskTier);
+#endif
+    buffer->open(QBuffer::ReadOnly);
+    return buffer;
+}
+
+bool NetworkDiskCache::remove(const QUrl &url)
+{
+    // Drop any reply that is still being written for this url
+    QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = m_inserting.begin();
+    while (it != m_inserting.end()) {
+        if (it.value().url() == url) {
+            delete it.key();
+            it = m_inserting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_memoryCache.remove(url.toEncoded());
+    if (!m_store->remove(url))
+        return false;
+    m_saveTimer->changeOccurred();
+    return true;
+}
+
+qint64 NetworkDiskCache::cacheSize() const
+{
+    return m_store->size();
+}
+
 QIODevice *NetworkDiskCache::prepare(const QNetworkCacheMetaData &metaData)
 {
     if (m_private)
         return 0;
-    return QNetworkDiskCache::prepare(metaData);
+    if (!metaData.isValid() || !metaData.url().isValid() || !metaData.saveToDisk())
+        return 0;
+
+    // Don't let a single entry push everything else out of the cache
+    foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders()) {
+        if (header.first.toLower() == "content-length") {
+            if (header.second.toLongLong() > maximumCacheSize() * 3 / 4)
+                return 0;
+            break;
+        }
+    }
+
+    CacheBodyDevice *body = new CacheBodyDevice(maximumCacheSize() * 3 / 4);
+    m_inserting.insert(body, metaData);
+    return body;
+}
+
+void NetworkDiskCache::insert(QIODevice *device)
+{
+    QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = m_inserting.find(device);
+    if (it == m_inserting.end())
+        return;
+
+    m_memoryCache.remove(it.value().url().toEncoded());
+    // Only devices from prepare() are in m_inserting
+    CacheBodyDevice *body = static_cast<CacheBodyDevice*>(device);
+    if (!body->failed()) {
+        if (QFile *file = body->file()) {
+            // Copied over as it is, compressing it would hold up the pages
+            if (file->flush() && m_store->insert(it.value(), file))
+                m_saveTimer->changeOccurred();
+        } else if (m_store->insert(it.value(), body->buffer(), shouldCompress(it.value()))) {
+            insertIntoMemory(it.value(), body->buffer());
+            m_saveTimer->changeOccurred();
+        }
+    }
+    m_inserting.erase(it);
+    delete device;
+}
+
+void NetworkDiskCache::clear()
+{
+    qDeleteAll(m_inserting.keys());
+    m_inserting.clear();
+    m_memoryCache.clear();
+    m_store->clear();
 }
 
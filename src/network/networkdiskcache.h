@@ -29,24 +29,78 @@
 #ifndef NETWORKDISKCACHE_H
 #define NETWORKDISKCACHE_H
 
-#include <qnetworkdiskcache.h>
+#include <qabstractnetworkcache.h>
 
-class NetworkDiskCache : public QNetworkDiskCache
+#include <qcache.h>
+#include <qhash.h>
+#include <qstringlist.h>
+
+class AutoSaver;
+class NetworkCacheStore;
+class NetworkDiskCache : public QAbstractNetworkCache
 {
     Q_OBJECT
 
 public:
     NetworkDiskCache(QObject *parent = 0);
+    ~NetworkDiskCache();
 
     void loadSettings();
 
+    QString cacheDirectory() const;
+    void setCacheDirectory(const QString &cacheDirectory);
+
+    qint64 maximumCacheSize() const;
+    void setMaximumCacheSize(qint64 size);
+
+    int maximumMemoryCacheSize() const;
+    void setMaximumMemoryCacheSize(int size);
+    int memoryCacheSize() const;
+
+    enum Tier {
+        MemoryTier,
+        DiskTier,
+        Miss
+    };
+    int hitCount(Tier tier) const;
+    qreal hitRatio(Tier tier) const;
+
+    QStringList compressedContentTypes() const;
+    void setCompressedContentTypes(const QStringList &contentTypes);
+    bool shouldCompress(const QNetworkCacheMetaData &metaData) const;
+
+    QNetworkCacheMetaData metaData(const QUrl &url);
+    void updateMetaData(const QNetworkCacheMetaData &metaData);
+    QIODevice *data(const QUrl &url);
+    bool remove(const QUrl &url);
+    qint64 cacheSize() const;
+
     QIODevice *prepare(const QNetworkCacheMetaData &metaData);
+    void insert(QIODevice *device);
+
+public slots:
+    void clear();
 
 private slots:
     void privacyChanged(bool isPrivate);
+    void save();
 
 private:
+    void removeLegacyCache();
+
+    struct MemoryEntry {
+        QNetworkCacheMetaData metaData;
+        QByteArray data;
+    };
+    void insertIntoMemory(const QNetworkCacheMetaData &metaData, const QByteArray &data);
+
     bool m_private;
+    NetworkCacheStore *m_store;
+    QCache<QByteArray, MemoryEntry> m_memoryCache;
+    int m_hitCounts[Miss + 1];
+    QStringList m_compressedContentTypes;
+    QHash<QIODevice*, QNetworkCacheMetaData> m_inserting;
+    AutoSaver *m_saveTimer;
 };
 
 #endif // NETWORKDISKCACHE_H
@@ -0,0 +1,272 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "networkmonitor.h"
+
+#include "webpageproxy.h"
+
+#include <qnetworkreply.h>
+#include <qnetworkrequest.h>
+#include <qstringlist.h>
+
+static const int monitorCapacity = 1000;
+
+NetworkMonitor::Request::Request()
+    : page(0)
+    , fromCache(false)
+    , size(0)
+    , queued(0)
+    , headers(-1)
+    , firstByte(-1)
+    , finished(-1)
+{
+}
+
+NetworkMonitor::Totals::Totals()
+    : requests(0)
+    , cacheHits(0)
+    , blocked(0)
+    , errors(0)
+    , bytes(0)
+    , time(0)
+{
+}
+
+NetworkMonitor::NetworkMonitor(QObject *parent)
+    : QObject(parent)
+    , m_next(0)
+    , m_count(0)
+{
+    m_clock.start();
+    m_requests.resize(monitorCapacity);
+}
+
+/*!
+    Starts recording \a reply, \a handler is the name of whatever created
+    the reply when it was not a plain network request.
+ */
+void NetworkMonitor::monitor(QNetworkReply *reply, const QString &handler)
+{
+    if (!reply)
+        return;
+
+    QNetworkRequest request = reply->request();
+    Request record;
+    record.url = request.url();
+    record.host = record.url.host();
+    record.handler = handler;
+    record.queued = m_clock.elapsed();
+    QVariant page = request.attribute((QNetworkRequest::Attribute)(WebPageProxy::pageAttributeId()));
+    record.page = quintptr(page.value<void*>());
+    m_pending.insert(reply, record);
+
+    // The totals of a page are dropped with it, a finished reply of a
+    // page that is already gone is only kept in the request list
+    if (record.page && !m_pages.contains(record.page)) {
+        m_pages.insert(record.page);
+        WebPageProxy *webPage = static_cast<WebPageProxy*>(page.value<void*>());
+        connect(webPage, SIGNAL(destroyed(QObject *)),
+                this, SLOT(pageDestroyed(QObject *)));
+    }
+
+    connect(reply, SIGNAL(metaDataChanged()),
+            this, SLOT(replyMetaDataChanged()));
+    connect(reply, SIGNAL(downloadProgress(qint64, qint64)),
+            this, SLOT(replyDownloadProgress(qint64, qint64)));
+    connect(reply, SIGNAL(finished()),
+            this, SLOT(replyFinished()));
+    connect(reply, SIGNAL(destroyed(QObject *)),
+            this, SLOT(replyDestroyed(QObject *)));
+}
+
+void NetworkMonitor::replyMetaDataChanged()
+{
+    QHash<QObject*, Request>::iterator it = m_pending.find(sender());
+    if (it == m_pending.end() || it->headers != -1)
+        return;
+    it->headers = m_clock.elapsed() - it->queued;
+}
+
+void NetworkMonitor::replyDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+    Q_UNUSED(bytesTotal);
+    QHash<QObject*, Request>::iterator it = m_pending.find(sender());
+    if (it == m_pending.end())
+        return;
+    if (it->firstByte == -1 && bytesReceived > 0)
+        it->firstByte = m_clock.elapsed() - it->queued;
+    it->size = bytesReceived;
+}
+
+void NetworkMonitor::replyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply || !m_pending.contains(reply))
+        return;
+
+    Request record = m_pending.take(reply);
+    record.finished = m_clock.elapsed() - record.queued;
+    record.fromCache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+    if (reply->error() != QNetworkReply::NoError)
+        record.error = reply->errorString();
+
+    m_requests[m_next] = record;
+    m_next = (m_next + 1) % m_requests.count();
+    m_count = qMin(m_count + 1, m_requests.count());
+
+    Totals *totals[2] = { &m_hostTotals[record.host], 0 };
+    int count = 1;
+    if (m_pages.contains(record.page))
+        totals[count++] = &m_pageTotals[record.page];
+    for (int i = 0; i < count; ++i) {
+        ++totals[i]->requests;
+        if (record.fromCache)
+            ++totals[i]->cacheHits;
+        if (record.handler == QLatin1String("adblock"))
+            ++totals[i]->blocked;
+        else if (!record.error.isEmpty())
+            ++totals[i]->errors;
+        totals[i]->bytes += record.size;
+        totals[i]->time += record.finished;
+    }
+    emit requestFinished();
+}
+
+void NetworkMonitor::replyDestroyed(QObject *object)
+{
+    m_pending.remove(object);
+}
+
+void NetworkMonitor::pageDestroyed(QObject *object)
+{
+    quintptr page = quintptr(static_cast<WebPageProxy*>(object));
+    m_pages.remove(page);
+    m_pageTotals.remove(page);
+}
+
+int NetworkMonitor::capacity() const
+{
+    return m_requests.count();
+}
+
+/*!
+    Returns the most recently finished requests, oldest first.
+ */
+QList<NetworkMonitor::Request> NetworkMonitor::requests() const
+{
+    QList<Request> list;
+    int start = (m_next - m_count + m_requests.count()) % m_requests.count();
+    for (int i = 0; i < m_count; ++i)
+        list.append(m_requests.at((start + i) % m_requests.count()));
+    return list;
+}
+
+QHash<QString, NetworkMonitor::Totals> NetworkMonitor::hostTotals() const
+{
+    return m_hostTotals;
+}
+
+QHash<quintptr, NetworkMonitor::Totals> NetworkMonitor::pageTotals() const
+{
+    return m_pageTotals;
+}
+
+void NetworkMonitor::clear()
+{
+    m_next = 0;
+    m_count = 0;
+    m_hostTotals.clear();
+    m_pageTotals.clear();
+}
+
+static QString jsonString(const QString &string)
+{
+    QString escaped = string;
+    escaped.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    escaped.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    escaped.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+    escaped.replace(QLatin1Char('\r'), QLatin1String("\\r"));
+    escaped.replace(QLatin1Char('\t'), QLatin1String("\\t"));
+    return QLatin1Char('"') + escaped + QLatin1Char('"');
+}
+
+static QString jsonTotals(const NetworkMonitor::Totals &totals)
+{
+    return QString(QLatin1String("\"requests\": %1, \"cacheHits\": %2, \"blocked\": %3, "
+                                 "\"errors\": %4, \"bytes\": %5, \"time\": %6"))
+        .arg(totals.requests).arg(totals.cacheHits).arg(totals.blocked).arg(totals.errors)
+        .arg(totals.bytes).arg(totals.time);
+}
+
+/*!
+    Returns the recorded requests and the totals per host and page as JSON.
+ */
+QByteArray NetworkMonitor::toJson() const
+{
+    QStringList requestList;
+    foreach (const Request &request, requests()) {
+        // Concatenated rather than filled in with arg(), the url and the
+        // error can have percent signs that arg() would replace
+        requestList.append(QLatin1String("    { \"url\": ")
+                           + jsonString(QString::fromUtf8(request.url.toEncoded()))
+                           + QLatin1String(", \"host\": ") + jsonString(request.host)
+                           + QLatin1String(", \"page\": ") + QString::number(request.page)
+                           + QLatin1String(", \"handler\": ") + jsonString(request.handler)
+                           + QLatin1String(", \"error\": ") + jsonString(request.error)
+                           + QLatin1String(", \"fromCache\": ")
+                           + (request.fromCache ? QLatin1String("true") : QLatin1String("false"))
+                           + QLatin1String(", \"size\": ") + QString::number(request.size)
+                           + QLatin1String(", \"queued\": ") + QString::number(request.queued)
+                           + QLatin1String(", \"headers\": ") + QString::number(request.headers)
+                           + QLatin1String(", \"firstByte\": ") + QString::number(request.firstByte)
+                           + QLatin1String(", \"finished\": ") + QString::number(request.finished)
+                           + QLatin1String(" }"));
+    }
+
+    QStringList hostList;
+    QHash<QString, Totals>::const_iterator host = m_hostTotals.constBegin();
+    for (; host != m_hostTotals.constEnd(); ++host)
+        hostList.append(QString(QLatin1String("    { \"host\": %1, %2 }"))
+                        .arg(jsonString(host.key()), jsonTotals(host.value())));
+
+    QStringList pageList;
+    QHash<quintptr, Totals>::const_iterator page = m_pageTotals.constBegin();
+    for (; page != m_pageTotals.constEnd(); ++page)
+        pageList.append(QString(QLatin1String("    { \"page\": %1, %2 }"))
+                        .arg(QString::number(page.key()), jsonTotals(page.value())));
+
+    QString json = QLatin1String("{\n  \"requests\": [\n")
+        + requestList.join(QLatin1String(",\n"))
+        + QLatin1String("\n  ],\n  \"hosts\": [\n")
+        + hostList.join(QLatin1String(",\n"))
+        + QLatin1String("\n  ],\n  \"pages\": [\n")
+        + pageList.join(QLatin1String(",\n"))
+        + QLatin1String("\n  ]\n}\n");
+    return json.toUtf8();
+}
+
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef NETWORKMONITOR_H
+#define NETWORKMONITOR_H
+
+#include <qobject.h>
+
+#include <qdatetime.h>
+#include <qhash.h>
+#include <qset.h>
+#include <qurl.h>
+#include <qvector.h>
+
+class QNetworkReply;
+
+/*
+    Records the timing, size and cache status of network replies.
+
+    Finished requests are kept in a fixed size ring buffer and summed up
+    per host and per page.  Everything happens on the thread of the
+    QNetworkAccessManager so no locking is needed.
+
+    Qt does not report when the host lookup or the connection of a reply
+    is done, only when a reply is created, when its headers arrive, when
+    the first data is read and when it is finished.
+*/
+class NetworkMonitor : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void requestFinished();
+
+public:
+    struct Request {
+        Request();
+
+        QUrl url;
+        QString host;
+        quintptr page;
+        QString handler;
+        QString error;
+        bool fromCache;
+        qint64 size;
+
+        // In milliseconds, queued since the monitor was created and
+        // the others since queued or -1 when it was never reached
+        int queued;
+        int headers;
+        int firstByte;
+        int finished;
+    };
+
+    struct Totals {
+        Totals();
+
+        int requests;
+        int cacheHits;
+        int blocked;
+        int errors;
+        qint64 bytes;
+        qint64 time;
+    };
+
+    NetworkMonitor(QObject *parent = 0);
+
+    void monitor(QNetworkReply *reply, const QString &handler = QString());
+
+    int capacity() const;
+    QList<Request> requests() const;
+    QHash<QString, Totals> hostTotals() const;
+    QHash<quintptr, Totals> pageTotals() const;
+
+    QByteArray toJson() const;
+
+public slots:
+    void clear();
+
+private slots:
+    void replyMetaDataChanged();
+    void replyDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void replyFinished();
+    void replyDestroyed(QObject *object);
+    void pageDestroyed(QObject *object);
+
+private:
+    QTime m_clock;
+    QHash<QObject*, Request> m_pending;
+    QVector<Request> m_requests;
+    int m_next;
+    int m_count;
+    QHash<QString, Totals> m_hostTotals;
+    QHash<quintptr, Totals> m_pageTotals;
+    QSet<quintptr> m_pages;
+};
+
+#endif // NETWORKMONITOR_H
+
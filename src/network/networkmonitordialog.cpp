@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "networkmonitordialog.h"
+
+#include "browserapplication.h"
+#include "networkaccessmanager.h"
+#include "networkdiskcache.h"
+#include "networkmonitor.h"
+
+#include <qcheckbox.h>
+#include <qdialogbuttonbox.h>
+#include <qfile.h>
+#include <qfiledialog.h>
+#include <qheaderview.h>
+#include <qlabel.h>
+#include <qlayout.h>
+#include <qmessagebox.h>
+#include <qpushbutton.h>
+#include <qsettings.h>
+#include <qtimer.h>
+#include <qtreewidget.h>
+
+NetworkMonitorDialog::NetworkMonitorDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Network Monitor"));
+    resize(640, 400);
+
+    QVBoxLayout *layout = new QVBoxLayout;
+
+    m_enabled = new QCheckBox(tr("&Record network requests"));
+    m_enabled->setChecked(BrowserApplication::networkAccessManager()->networkMonitor() != 0);
+    connect(m_enabled, SIGNAL(toggled(bool)),
+            this, SLOT(setMonitorEnabled(bool)));
+    layout->addWidget(m_enabled);
+
+    m_hosts = new QTreeWidget;
+    m_hosts->setRootIsDecorated(false);
+    m_hosts->setSortingEnabled(true);
+    m_hosts->setHeaderLabels(QStringList()
+                             << tr("Host")
+                             << tr("Requests")
+                             << tr("From Cache")
+                             << tr("Blocked")
+                             << tr("Errors")
+                             << tr("Bytes")
+                             << tr("Average Time (ms)"));
+    layout->addWidget(m_hosts);
+
+    m_cacheHits = new QLabel;
+    layout->addWidget(m_cacheHits);
+
+    m_prefetches = new QLabel;
+    layout->addWidget(m_prefetches);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton *clearButton = buttonBox->addButton(tr("C&lear"), QDialogButtonBox::ActionRole);
+    connect(clearButton, SIGNAL(clicked()), this, SLOT(clear()));
+    QPushButton *saveButton = buttonBox->addButton(tr("&Save..."), QDialogButtonBox::ActionRole);
+    connect(saveButton, SIGNAL(clicked()), this, SLOT(save()));
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+    layout->addWidget(buttonBox);
+
+    setLayout(layout);
+
+    QTimer *timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    timer->start(1000);
+    refresh();
+}
+
+void NetworkMonitorDialog::setMonitorEnabled(bool enabled)
+{
+    QSettings settings;
+    settings.beginGroup(QLatin1String("network"));
+    settings.setValue(QLatin1String("monitorRequests"), enabled);
+    BrowserApplication::networkAccessManager()->setNetworkMonitorEnabled(enabled);
+    refresh();
+}
+
+void NetworkMonitorDialog::clear()
+{
+    if (NetworkMonitor *monitor = BrowserApplication::networkAccessManager()->networkMonitor())
+        monitor->clear();
+    refresh();
+}
+
+void NetworkMonitorDialog::save()
+{
+    NetworkMonitor *monitor = BrowserApplication::networkAccessManager()->networkMonitor();
+    if (!monitor)
+        return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Network Requests"),
+                                                    QLatin1String("requests.json"),
+                                                    tr("JSON (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(monitor->toJson()) == -1) {
+        QMessageBox::warning(this, tr("Unable to save"),
+                             tr("Unable to save the network requests to %1: %2")
+                             .arg(fileName).arg(file.errorString()));
+    }
+}
+
+void NetworkMonitorDialog::refresh()
+{
+    NetworkDiskCache *cache = qobject_cast<NetworkDiskCache*>(BrowserApplication::networkAccessManager()->cache());
+    if (cache) {
+        m_cacheHits->setText(tr("Cache hits: %1% from memory, %2% from disk, %3% missed")
+                             .arg(qRound(cache->hitRatio(NetworkDiskCache::MemoryTier) * 100))
+                             .arg(qRound(cache->hitRatio(NetworkDiskCache::DiskTier) * 100))
+                             .arg(qRound(cache->hitRatio(NetworkDiskCache::Miss) * 100)));
+    } else {
+        m_cacheHits->setText(tr("The network cache is disabled"));
+    }
+
+    NetworkAccessManager *manager = BrowserApplication::networkAccessManager();
+    m_prefetches->setText(tr("Host prefetches: %1 looked up, %2 used, %3 ms saved")
+                          .arg(manager->prefetchedHostCount())
+                          .arg(manager->prefetchHitCount())
+                          .arg(manager->prefetchSavedTime()));
+
+    m_hosts->clear();
+    NetworkMonitor *monitor = manager->networkMonitor();
+    if (!monitor)
+        return;
+
+    QHash<QString, NetworkMonitor::Totals> totals = monitor->hostTotals();
+    QHash<QString, NetworkMonitor::Totals>::const_iterator it = totals.constBegin();
+    for (; it != totals.constEnd(); ++it) {
+        const NetworkMonitor::Totals &host = it.value();
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_hosts);
+        item->setText(0, it.key());
+        item->setData(1, Qt::DisplayRole, host.requests);
+        item->setData(2, Qt::DisplayRole, host.cacheHits);
+        item->setData(3, Qt::DisplayRole, host.blocked);
+        item->setData(4, Qt::DisplayRole, host.errors);
+        item->setData(5, Qt::DisplayRole, host.bytes);
+        item->setData(6, Qt::DisplayRole, host.requests ? int(host.time / host.requests) : 0);
+    }
+}
+
@@ -0,0 +1,425 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "sessionjournal.h"
+
+#include <qdatastream.h>
+#include <qset.h>
+
+#include <qdebug.h>
+
+// #define SESSIONJOURNAL_DEBUG
+
+static const quint32 SessionJournalMagic = 0x5e55107a;
+static const qint32 SessionJournalVersion = 1;
+
+// Compacting a small session is not worth it
+static const qint64 minimumJournalSize = 64 * 1024;
+
+SessionJournal::SessionJournal(QObject *parent)
+    : QThread(parent)
+    , m_journalSize(0)
+    , m_snapshotSize(0)
+    , m_closing(false)
+{
+}
+
+SessionJournal::~SessionJournal()
+{
+    close();
+}
+
+void SessionJournal::clear()
+{
+    m_windows.clear();
+    m_windowData.clear();
+    m_tabs.clear();
+}
+
+/*!
+    Replays the journal in \a fileName.  The session can then be read with
+    windows(), window() and tab().
+
+    Returns false when there is no journal.
+ */
+bool SessionJournal::read(const QString &fileName)
+{
+    clear();
+
+    // The browser went away while the journal was being compacted
+    QFile file(fileName);
+    if (!file.exists())
+        file.setFileName(fileName + QLatin1String(".new"));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic;
+    qint32 version;
+    stream >> magic;
+    stream >> version;
+    if (magic != SessionJournalMagic || version != SessionJournalVersion)
+        return false;
+
+    forever {
+        quint32 length;
+        quint16 checksum;
+        stream >> length;
+        stream >> checksum;
+        if (stream.status() != QDataStream::Ok)
+            break;
+        QByteArray record = file.read(length);
+        if (record.size() != int(length)
+            || qChecksum(record.constData(), record.size()) != checksum)
+            break;
+        apply(record);
+    }
+
+#ifdef SESSIONJOURNAL_DEBUG
+    qDebug() << "SessionJournal::" << __FUNCTION__ << file.fileName()
+             << m_windows.count() << "windows" << m_tabs.count() << "tabs";
+#endif
+    return true;
+}
+
+/*!
+    Starts a new journal in \a fileName with an empty session and starts
+    the thread that writes it.
+ */
+bool SessionJournal::open(const QString &fileName)
+{
+    close();
+    clear();
+    m_fileName = fileName;
+    m_closing = false;
+    m_snapshot = snapshot();
+    m_snapshotSize = m_snapshot.size();
+    m_journalSize = 0;
+    start();
+    return true;
+}
+
+/*!
+    Writes out everything that is queued and stops the thread.
+ */
+void SessionJournal::close()
+{
+    if (!isRunning())
+        return;
+    m_mutex.lock();
+    m_closing = true;
+    m_waitCondition.wakeAll();
+    m_mutex.unlock();
+    wait();
+    m_file.close();
+}
+
+bool SessionJournal::isOpen() const
+{
+    return isRunning();
+}
+
+QList<quint32> SessionJournal::windows() const
+{
+    return m_windows;
+}
+
+SessionJournal::Window SessionJournal::window(quint32 id) const
+{
+    return m_windowData.value(id);
+}
+
+SessionJournal::Tab SessionJournal::tab(quint32 id) const
+{
+    return m_tabs.value(id);
+}
+
+/*!
+    Sets the windows of the session, windows that are not in \a windows
+    are removed.
+ */
+void SessionJournal::setWindows(const QList<quint32> &windows)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << quint8(WindowsRecord) << windows;
+    append(record);
+}
+
+void SessionJournal::setWindowState(quint32 window, const QByteArray &state)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << quint8(WindowStateRecord) << window << state;
+    append(record);
+}
+
+/*!
+    Sets the tabs of \a window, tabs that are not in \a tabs are removed
+    once the journal is compacted.
+ */
+void SessionJournal::setTabs(quint32 window, const QList<quint32> &tabs, int currentTab)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << quint8(TabsRecord) << window << tabs << qint32(currentTab);
+    append(record);
+}
+
+void SessionJournal::setTab(quint32 tab, const QUrl &url, const QByteArray &history,
+                            const QString &title)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << quint8(TabRecord) << tab << url << history << title;
+    append(record);
+}
+
+/*
+    Applies \a record to the session in memory.
+ */
+void SessionJournal::apply(const QByteArray &record)
+{
+    QDataStream stream(record);
+    quint8 type;
+    stream >> type;
+    switch (type) {
+    case WindowsRecord: {
+        stream >> m_windows;
+        foreach (quint32 id, m_windowData.keys()) {
+            if (!m_windows.contains(id))
+                m_windowData.remove(id);
+        }
+        prune();
+        break;
+    }
+    case WindowStateRecord: {
+        quint32 window;
+        stream >> window;
+        stream >> m_windowData[window].state;
+        break;
+    }
+    case TabsRecord: {
+        quint32 window;
+        qint32 currentTab;
+        stream >> window;
+        stream >> m_windowData[window].tabs;
+        stream >> currentTab;
+        m_windowData[window].currentTab = currentTab;
+        prune();
+        break;
+    }
+    case TabRecord: {
+        quint32 tab;
+        stream >> tab;
+        stream >> m_tabs[tab].url;
+        stream >> m_tabs[tab].history;
+        // Tab records written before the titles were kept end here
+        m_tabs[tab].title.clear();
+        if (!stream.atEnd())
+            stream >> m_tabs[tab].title;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/*
+    Forgets the tabs that are no longer in any window.  A tab is always
+    written before the window that it is added to.
+ */
+void SessionJournal::prune()
+{
+    QSet<quint32> tabs;
+    foreach (const Window &window, m_windowData)
+        foreach (quint32 tab, window.tabs)
+            tabs.insert(tab);
+
+    QHash<quint32, Tab>::iterator it = m_tabs.begin();
+    while (it != m_tabs.end()) {
+        if (tabs.contains(it.key()))
+            ++it;
+        else
+            it = m_tabs.erase(it);
+    }
+}
+
+/*
+    Applies \a record and queues it to be written.
+ */
+void SessionJournal::append(const QByteArray &record)
+{
+    apply(record);
+    if (!isRunning())
+        return;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(record.size());
+    stream << qChecksum(record.constData(), record.size());
+    data += record;
+
+    QMutexLocker locker(&m_mutex);
+    m_journalSize += data.size();
+    m_queue += data;
+    m_waitCondition.wakeAll();
+}
+
+/*!
+    Ends a save, the journal is compacted when it has grown too big.
+
+    Until then the session in memory can be missing records that the
+    rest of the save still writes, for example tabs that are not yet in
+    the window they are added to.
+ */
+void SessionJournal::commit()
+{
+    if (!isRunning())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_journalSize <= qMax(minimumJournalSize, 2 * m_snapshotSize))
+        return;
+
+    // The snapshot has everything that is queued
+    m_snapshot = snapshot();
+    m_snapshotSize = m_snapshot.size();
+    m_journalSize = 0;
+    m_queue.clear();
+    m_waitCondition.wakeAll();
+}
+
+/*
+    Returns a journal that only has the records needed for the session,
+    tabs that are no longer in a window are left out.
+ */
+QByteArray SessionJournal::snapshot() const
+{
+    QList<QByteArray> records;
+    QByteArray record;
+    {
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream << quint8(WindowsRecord) << m_windows;
+    }
+    records.append(record);
+    foreach (quint32 id, m_windows) {
+        Window window = m_windowData.value(id);
+        record.clear();
+        {
+            QDataStream stream(&record, QIODevice::WriteOnly);
+            stream << quint8(WindowStateRecord) << id << window.state;
+        }
+        records.append(record);
+        foreach (quint32 tabId, window.tabs) {
+            Tab tab = m_tabs.value(tabId);
+            record.clear();
+            QDataStream stream(&record, QIODevice::WriteOnly);
+            stream << quint8(TabRecord) << tabId << tab.url << tab.history << tab.title;
+            records.append(record);
+        }
+        record.clear();
+        {
+            QDataStream stream(&record, QIODevice::WriteOnly);
+            stream << quint8(TabsRecord) << id << window.tabs << qint32(window.currentTab);
+        }
+        records.append(record);
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << SessionJournalMagic;
+    stream << SessionJournalVersion;
+    foreach (const QByteArray &record, records) {
+        stream << quint32(record.size());
+        stream << qChecksum(record.constData(), record.size());
+        stream.writeRawData(record.constData(), record.size());
+    }
+    return data;
+}
+
+/*
+    Replaces the journal with \a data, which is first written next to it
+    so that there always is a complete journal to read.
+ */
+bool SessionJournal::replace(const QByteArray &data)
+{
+    QString newFileName = m_fileName + QLatin1String(".new");
+    QFile file(newFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(data) != data.size()) {
+        qWarning() << "SessionJournal: Unable to write" << newFileName << file.errorString();
+        return false;
+    }
+    file.close();
+
+    m_file.close();
+    if ((QFile::exists(m_fileName) && !QFile::remove(m_fileName))
+        || !QFile::rename(newFileName, m_fileName)) {
+        qWarning() << "SessionJournal: Unable to replace" << m_fileName;
+        return false;
+    }
+    m_file.setFileName(m_fileName);
+    return m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered);
+}
+
+void SessionJournal::run()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        if (!m_snapshot.isEmpty()) {
+            QByteArray data = m_snapshot;
+            m_snapshot.clear();
+            locker.unlock();
+            replace(data);
+            locker.relock();
+            continue;
+        }
+
+        if (m_queue.isEmpty()) {
+            if (m_closing)
+                break;
+            m_waitCondition.wait(&m_mutex);
+            continue;
+        }
+
+        QByteArray data = m_queue;
+        m_queue.clear();
+        locker.unlock();
+        // Each batch goes to the system right away, a crash loses nothing that was queued before it
+        bool ok = m_file.isOpen() && m_file.write(data) == data.size();
+        locker.relock();
+
+#ifdef SESSIONJOURNAL_DEBUG
+        qDebug() << "SessionJournal::" << __FUNCTION__ << data.size() << ok;
+#else
+        Q_UNUSED(ok);
+#endif
+    }
+}
+
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <qthread.h>
+
+#include <qfile.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qurl.h>
+#include <qwaitcondition.h>
+
+/*
+    Keeps the session in a file that only the changes are appended to, so
+    that saving the session costs as much as what changed since the last
+    save rather than as much as all of the windows and tabs.  A save is a
+    number of changes followed by commit().
+
+    Every change is a record that is applied to the session kept in
+    memory and appended to the journal.  Each record carries its length
+    and a checksum, replaying the journal stops at a record that was not
+    completely written when the browser went away.  Once the records add
+    up to more than twice the size of the session the journal is
+    compacted into a new file with just the session, but only when a
+    save is committed so that a session that is half way through a save
+    is never written.
+
+    The file is written on a thread of its own.
+*/
+class SessionJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Tab {
+        QUrl url;
+        QString title;
+        QByteArray history;
+    };
+
+    struct Window {
+        Window() : currentTab(0) {}
+        QByteArray state;
+        QList<quint32> tabs;
+        int currentTab;
+    };
+
+    SessionJournal(QObject *parent = 0);
+    ~SessionJournal();
+
+    bool read(const QString &fileName);
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    QList<quint32> windows() const;
+    Window window(quint32 id) const;
+    Tab tab(quint32 id) const;
+
+    void setWindows(const QList<quint32> &windows);
+    void setWindowState(quint32 window, const QByteArray &state);
+    void setTabs(quint32 window, const QList<quint32> &tabs, int currentTab);
+    void setTab(quint32 tab, const QUrl &url, const QByteArray &history,
+                const QString &title = QString());
+    void commit();
+
+protected:
+    void run();
+
+private:
+    enum RecordType {
+        WindowsRecord,
+        WindowStateRecord,
+        TabsRecord,
+        TabRecord
+    };
+
+    void clear();
+    void apply(const QByteArray &record);
+    void prune();
+    void append(const QByteArray &record);
+    QByteArray snapshot() const;
+    bool replace(const QByteArray &data);
+
+    QList<quint32> m_windows;
+    QHash<quint32, Window> m_windowData;
+    QHash<quint32, Tab> m_tabs;
+    qint64 m_journalSize;
+    qint64 m_snapshotSize;
+
+    QMutex m_mutex;
+    QWaitCondition m_waitCondition;
+    QString m_fileName;
+    QFile m_file;
+    QByteArray m_queue;
+    QByteArray m_snapshot;
+    bool m_closing;
+};
+
+#endif // SESSIONJOURNAL_H
+
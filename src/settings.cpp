@@ -258,6 +258,7 @@ void SettingsDialog::loadFromSettings()
     m_cacheEnabled = settings.value(QLatin1String("cacheEnabled"), true).toBool();
     networkCache->setChecked(m_cacheEnabled);
     networkCacheMaximumSizeSpinBox->setValue(settings.value(QLatin1String("maximumCacheSize"), 50).toInt());
+    networkCacheMemorySizeSpinBox->setValue(settings.value(QLatin1String("maximumMemoryCacheSize"), 8).toInt());
     settings.endGroup();
 
     // Proxy
@@ -408,6 +409,7 @@ void SettingsDialog::saveToSettings()
     settings.beginGroup(QLatin1String("network"));
     settings.setValue(QLatin1String("cacheEnabled"), networkCache->isChecked());
     settings.setValue(QLatin1String("maximumCacheSize"), networkCacheMaximumSizeSpinBox->value());
+    settings.setValue(QLatin1String("maximumMemoryCacheSize"), networkCacheMemorySizeSpinBox->value());
     settings.endGroup();
 
     // proxy
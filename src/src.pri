@@ -43,16 +43,20 @@ HEADERS += \
     browsermainwindow.h \
     clearprivatedata.h \
     clearbutton.h \
+    closedtabstore.h \
     downloadmanager.h \
+    downloadwriter.h \
     modelmenu.h \
     modeltoolbar.h \
     plaintexteditsearch.h \
     searchbar.h \
+    sessionjournal.h \
     searchbutton.h \
     searchlineedit.h \
     settings.h \
     sourcehighlighter.h \
     sourceviewer.h \
+    startuptrace.h \
     tabbar.h \
     tabwidget.h \
     toolbarsearch.h \
@@ -71,16 +75,20 @@ SOURCES += \
     browsermainwindow.cpp \
     clearprivatedata.cpp \
     clearbutton.cpp \
+    closedtabstore.cpp \
     downloadmanager.cpp \
+    downloadwriter.cpp \
     modelmenu.cpp \
     modeltoolbar.cpp \
     plaintexteditsearch.cpp \
     searchbar.cpp \
+    sessionjournal.cpp \
     searchbutton.cpp \
     searchlineedit.cpp \
     settings.cpp \
     sourcehighlighter.cpp \
     sourceviewer.cpp \
+    startuptrace.cpp \
     tabbar.cpp \
     tabwidget.cpp \
     toolbarsearch.cpp \
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "startuptrace.h"
+
+#include <qevent.h>
+#include <qwidget.h>
+
+#include <stdio.h>
+
+StartupTrace::StartupTrace()
+    : QObject(0)
+    , m_enabled(qgetenv("ARORA_STARTUP_TRACE").length() > 0)
+    , m_painted(false)
+{
+    m_clock.start();
+}
+
+StartupTrace *StartupTrace::instance()
+{
+    static StartupTrace *trace = 0;
+    if (!trace)
+        trace = new StartupTrace;
+    return trace;
+}
+
+/*!
+    Starts the clock, this should be called first thing in main().
+ */
+void StartupTrace::start()
+{
+    StartupTrace *trace = instance();
+    trace->m_clock.restart();
+    trace->m_painted = false;
+    mark(QLatin1String("start"));
+}
+
+bool StartupTrace::isEnabled()
+{
+    return instance()->m_enabled;
+}
+
+qint64 StartupTrace::elapsed()
+{
+    return instance()->m_clock.elapsed();
+}
+
+void StartupTrace::mark(const QString &phase)
+{
+    if (!isEnabled())
+        return;
+    fprintf(stderr, "startup: %6lld ms %s\n", (long long)elapsed(), phase.toLocal8Bit().constData());
+    fflush(stderr);
+}
+
+/*!
+    Marks "first paint" when \a widget gets its first paint event.
+ */
+void StartupTrace::markFirstPaint(QWidget *widget)
+{
+    StartupTrace *trace = instance();
+    if (!trace->m_enabled || trace->m_painted || !widget)
+        return;
+    widget->installEventFilter(trace);
+}
+
+bool StartupTrace::eventFilter(QObject *object, QEvent *event)
+{
+    if (event->type() == QEvent::Paint && !m_painted) {
+        m_painted = true;
+        object->removeEventFilter(this);
+        mark(QLatin1String("first paint"));
+    }
+    return QObject::eventFilter(object, event);
+}
+
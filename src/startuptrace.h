@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <qobject.h>
+
+#if QT_VERSION >= 0x040700
+#include <qelapsedtimer.h>
+#else
+#include <qdatetime.h>
+#endif
+
+class QWidget;
+
+/*
+    Timestamps the phases of the browser startup.
+
+    The trace is only collected when ARORA_STARTUP_TRACE is set in the
+    environment.  Every mark is printed to stderr as
+    "startup: <msecs> ms <phase>" where the time is counted from start(),
+    so the cost of each phase can be read off the difference between two
+    lines.
+*/
+class StartupTrace : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void start();
+    static bool isEnabled();
+    static qint64 elapsed();
+
+    static void mark(const QString &phase);
+    static void markFirstPaint(QWidget *widget);
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event);
+
+private:
+    StartupTrace();
+    static StartupTrace *instance();
+
+#if QT_VERSION >= 0x040700
+    QElapsedTimer m_clock;
+#else
+    QTime m_clock;
+#endif
+    bool m_enabled;
+    bool m_painted;
+};
+
+#endif // STARTUPTRACE_H
+
@@ -68,12 +68,14 @@
 #include "bookmarksmodel.h"
 #include "browserapplication.h"
 #include "browsermainwindow.h"
+#include "closedtabstore.h"
 #include "history.h"
 #include "historycompleter.h"
 #include "historymanager.h"
 #include "locationbar.h"
 #include "opensearchengine.h"
 #include "opensearchmanager.h"
+#include "sessionjournal.h"
 #include "tabbar.h"
 #include "toolbarsearch.h"
 #include "webactionmapper.h"
@@ -84,6 +86,7 @@
 #include <qcompleter.h>
 #include <qdir.h>
 #include <qevent.h>
+#include <qfile.h>
 #include <qlistview.h>
 #include <qmenu.h>
 #include <qmessagebox.h>
@@ -91,12 +94,19 @@
 #include <qsettings.h>
 #include <qstackedwidget.h>
 #include <qstyle.h>
+#include <qtimer.h>
 #include <qtoolbutton.h>
+#include <qwebframe.h>
 #include <qwebhistory.h>
 
 #include <qdebug.h>
 
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
 //#define USERMODIFIEDBEHAVIOR_DEBUG
+//#define BACKGROUNDTABS_DEBUG
 
 TabWidget::TabWidget(QWidget *parent)
     : QTabWidget(parent)
@@ -107,6 +117,9 @@ TabWidget::TabWidget(QWidget *parent)
     , m_nextTabAction(0)
     , m_previousTabAction(0)
     , m_recentlyClosedTabsMenu(0)
+    , m_backgroundRestoreLimit(0)
+    , m_hibernateAfter(0)
+    , m_hibernateMemoryLimit(0)
     , m_lineEditCompleter(0)
     , m_locationBars(0)
     , m_tabBar(new TabBar(this))
@@ -169,7 +182,9 @@ TabWidget::TabWidget(QWidget *parent)
             this, SLOT(aboutToShowRecentTriggeredAction(QAction *)));
     m_recentlyClosedTabsAction = new QAction(this);
     m_recentlyClosedTabsAction->setMenu(m_recentlyClosedTabsMenu);
-    m_recentlyClosedTabsAction->setEnabled(false);
+    m_recentlyClosedTabsAction->setEnabled(!BrowserApplication::closedTabStore()->isEmpty());
+    connect(BrowserApplication::closedTabStore(), SIGNAL(changed()),
+            this, SLOT(closedTabsChanged()));
 
 #ifndef Q_WS_MAC // can't seem to figure out the background color :(
     addTabButton = new QToolButton(this);
@@ -185,8 +200,12 @@ TabWidget::TabWidget(QWidget *parent)
 
     m_locationBars = new QStackedWidget(this);
 
-    connect(BrowserApplication::historyManager(), SIGNAL(historyCleared()),
-        this, SLOT(historyCleared()));
+    // Don't load the history just to show the window
+    if (BrowserApplication::hasHistoryManager())
+        historyManagerCreated();
+    else if (qobject_cast<BrowserApplication*>(QCoreApplication::instance()))
+        connect(BrowserApplication::instance(), SIGNAL(historyManagerCreated()),
+                this, SLOT(historyManagerCreated()));
 
     // Initialize Actions' labels
     retranslate();
@@ -195,20 +214,36 @@ TabWidget::TabWidget(QWidget *parent)
 
 void TabWidget::historyCleared()
 {
-    m_recentlyClosedTabs.clear();
-    m_recentlyClosedTabsAction->setEnabled(false);
+    BrowserApplication::closedTabStore()->clear();
+}
+
+void TabWidget::closedTabsChanged()
+{
+    m_recentlyClosedTabsAction->setEnabled(!BrowserApplication::closedTabStore()->isEmpty());
+}
+
+void TabWidget::historyManagerCreated()
+{
+    HistoryManager *historyManager = BrowserApplication::historyManager();
+    connect(historyManager, SIGNAL(historyCleared()),
+        this, SLOT(historyCleared()));
+    if (!m_lineEditCompleter)
+        return;
+    HistoryCompletionModel *completionModel = qobject_cast<HistoryCompletionModel*>(m_lineEditCompleter->model());
+    if (completionModel && !completionModel->sourceModel())
+        completionModel->setSourceModel(historyManager->historyFilterModel());
 }
 
 void TabWidget::clear()
 {
     // clear the recently closed tabs
-    m_recentlyClosedTabs.clear();
-    m_recentlyClosedTabsAction->setEnabled(false);
+    BrowserApplication::closedTabStore()->clear();
     // clear the line edit history
     for (int i = 0; i < m_locationBars->count(); ++i) {
         QLineEdit *qLineEdit = locationBar(i);
         qLineEdit->setText(qLineEdit->text());
-        webViewSearch(i)->clear();
+        if (WebViewSearch *search = webViewSearch(i))
+            search->clear();
     }
 }
 
@@ -222,6 +257,8 @@ void TabWidget::reloadTab(int index)
 
     if (WebView *tab = webView(index)) {
         tab->reload();
+    } else {
+        loadPendingTab(index);
     }
 }
 
@@ -230,6 +267,7 @@ void TabWidget::moveTab(int fromIndex, int toIndex)
     QWidget *lineEdit = m_locationBars->widget(fromIndex);
     m_locationBars->removeWidget(lineEdit);
     m_locationBars->insertWidget(toIndex, lineEdit);
+    updateWebViewIndexes();
 }
 
 void TabWidget::addWebAction(QAction *action, QWebPage::WebAction webAction)
@@ -241,12 +279,18 @@ void TabWidget::addWebAction(QAction *action, QWebPage::WebAction webAction)
 
 void TabWidget::currentChanged(int index)
 {
+    if (isPendingTab(index))
+        loadPendingTab(index);
+
     WebView *webView = this->webView(index);
     if (!webView)
         return;
 
     Q_ASSERT(m_locationBars->count() == count());
 
+    if (QWidget *oldWidget = widget(m_locationBars->currentIndex()))
+        m_lastActive[oldWidget] = QDateTime::currentDateTime();
+
     WebView *oldWebView = this->webView(m_locationBars->currentIndex());
     if (oldWebView) {
         disconnect(oldWebView, SIGNAL(statusBarMessage(const QString&)),
@@ -255,7 +299,18 @@ void TabWidget::currentChanged(int index)
                    this, SIGNAL(linkHovered(const QString&)));
         disconnect(oldWebView, SIGNAL(loadProgress(int)),
                    this, SIGNAL(loadProgress(int)));
+        oldWebView->webPage()->setBackground(true);
+    }
+    webView->webPage()->setBackground(!isVisible());
+
+#ifdef BACKGROUNDTABS_DEBUG
+    for (int i = 0; i < count(); ++i) {
+        if (WebView *tab = this->webView(i))
+            qDebug() << "TabWidget::" << __FUNCTION__ << i << tab->url()
+                     << "cpu:" << tab->cpuTime() << "ms"
+                     << (tab->webPage()->isBackground() ? "background" : "foreground");
     }
+#endif
 
     connect(webView, SIGNAL(statusBarMessage(const QString&)),
             this, SIGNAL(showStatusBarMessage(const QString&)));
@@ -349,14 +404,33 @@ WebViewSearch *TabWidget::webViewSearch(int index) const
 
 int TabWidget::webViewIndex(WebView *webView) const
 {
+    return m_webViewIndexes.value(webView, -1);
+}
+
+/*
+    Every signal of a WebView has to find its tab so the index of each
+    WebView is kept in a hash that is rebuilt whenever a tab is added,
+    moved or closed or a tab gets or loses its WebView.
+ */
+void TabWidget::updateWebViewIndexes()
+{
+    m_webViewIndexes.clear();
     for (int i = 0; i < count(); ++i) {
-        QWidget *widget = this->widget(i);
-        if (WebViewWithSearch *webViewWithSearch = qobject_cast<WebViewWithSearch*>(widget)) {
-            if (webViewWithSearch->m_webView == webView)
-                return i;
-        }
+        if (WebView *webView = this->webView(i))
+            m_webViewIndexes.insert(webView, i);
     }
-    return -1;
+}
+
+void TabWidget::tabInserted(int index)
+{
+    QTabWidget::tabInserted(index);
+    updateWebViewIndexes();
+}
+
+void TabWidget::tabRemoved(int index)
+{
+    QTabWidget::tabRemoved(index);
+    updateWebViewIndexes();
 }
 
 void TabWidget::newTab()
@@ -366,11 +440,27 @@ void TabWidget::newTab()
 
 WebView *TabWidget::makeNewTab(bool makeCurrent)
 {
-    // line edit
+    LocationBar *locationBar = makeLocationBar();
+    WebView *webView = makeWebView(locationBar);
+
+    WebViewWithSearch *webViewWithSearch = new WebViewWithSearch(webView, this);
+    addTab(webViewWithSearch, tr("Untitled"));
+    if (makeCurrent)
+        setCurrentWidget(webViewWithSearch);
+
+    if (count() == 1)
+        currentChanged(currentIndex());
+    emit tabsChanged();
+    return webView;
+}
+
+LocationBar *TabWidget::makeLocationBar()
+{
     LocationBar *locationBar = new LocationBar;
     if (!m_lineEditCompleter) {
         HistoryCompletionModel *completionModel = new HistoryCompletionModel(this);
-        completionModel->setSourceModel(BrowserApplication::historyManager()->historyFilterModel());
+        if (BrowserApplication::hasHistoryManager())
+            completionModel->setSourceModel(BrowserApplication::historyManager()->historyFilterModel());
         m_lineEditCompleter = new HistoryCompleter(completionModel, this);
         connect(m_lineEditCompleter, SIGNAL(activated(const QString &)),
                 this, SLOT(loadString(const QString &)));
@@ -391,9 +481,14 @@ WebView *TabWidget::makeNewTab(bool makeCurrent)
 #ifndef AUTOTESTS
     QWidget::setTabOrder(locationBar, qFindChild<ToolbarSearch*>(BrowserMainWindow::parentWindow(this)));
 #endif
+    return locationBar;
+}
 
-    // webview
+WebView *TabWidget::makeWebView(LocationBar *locationBar)
+{
     WebView *webView = new WebView;
+    // Until it is the current tab
+    webView->webPage()->setBackground(true);
     locationBar->setWebView(webView);
     connect(webView, SIGNAL(loadStarted()),
             this, SLOT(webViewLoadStarted()));
@@ -422,23 +517,194 @@ WebView *TabWidget::makeNewTab(bool makeCurrent)
     connect(webView->page(), SIGNAL(toolBarVisibilityChangeRequested(bool)),
             this, SLOT(toolBarVisibilityChangeRequestedCheck(bool)));
 
-    WebViewWithSearch *webViewWithSearch = new WebViewWithSearch(webView, this);
-    addTab(webViewWithSearch, tr("Untitled"));
-    if (makeCurrent)
-        setCurrentWidget(webViewWithSearch);
-
     // webview actions
     for (int i = 0; i < m_actions.count(); ++i) {
         WebActionMapper *mapper = m_actions[i];
         mapper->addChild(webView->page()->action(mapper->webAction()));
     }
+    return webView;
+}
 
-    if (count() == 1)
-        currentChanged(currentIndex());
-    emit tabsChanged();
+/*
+    Adds a tab for \a url that only gets a WebView and starts loading
+    when it is first shown or loadPendingTab() is called.  Until then the
+    tab shows the \a pageTitle the page had when it was saved.
+ */
+void TabWidget::addPendingTab(const QUrl &url, const QString &pageTitle, const QByteArray &historyState)
+{
+    LocationBar *locationBar = makeLocationBar();
+    locationBar->setText(QString::fromUtf8(url.toEncoded()));
+    locationBar->setCursorPosition(0);
+
+    WebViewWithSearch *webViewWithSearch = new WebViewWithSearch(0, this);
+    TabState state;
+    state.url = url;
+    state.title = pageTitle;
+    state.history = historyState;
+    m_pendingTabs.insert(webViewWithSearch, state);
+
+    QString title = pageTitle.isEmpty() ? QString::fromUtf8(url.toEncoded()) : pageTitle;
+    title.replace(QLatin1Char('&'), QLatin1String("&&"));
+    int index = addTab(webViewWithSearch, title.isEmpty() ? tr("Untitled") : title);
+    setTabToolTip(index, title);
+    m_tabBar->setTabData(index, url);
+    if (isPendingTab(index)) {
+#if !defined(Q_WS_MAC)
+        QIcon icon = BrowserApplication::instance()->icon(url);
+        animationLabel(index, false)->setPixmap(icon.pixmap(16, 16));
+#endif
+    }
+}
+
+bool TabWidget::isPendingTab(int index) const
+{
+    return m_pendingTabs.contains(widget(index));
+}
+
+/*!
+    Creates the WebView of the tab at \a index if it has been restored
+    without one and starts loading it.
+ */
+WebView *TabWidget::loadPendingTab(int index)
+{
+    QWidget *widget = this->widget(index);
+    if (!m_pendingTabs.contains(widget))
+        return webView(index);
+
+    TabState state = m_pendingTabs.take(widget);
+    LocationBar *locationBar = qobject_cast<LocationBar*>(m_locationBars->widget(index));
+    WebView *webView = makeWebView(locationBar);
+    qobject_cast<WebViewWithSearch*>(widget)->setWebView(webView);
+    m_webViewIndexes.insert(webView, index);
+    if (!state.scrollPosition.isNull())
+        m_restoreScrollPositions.insert(webView, state.scrollPosition);
+#if QT_VERSION >= 0x040600
+    if (!state.history.isEmpty()) {
+        QDataStream historyStream(state.history);
+        historyStream >> *webView->history();
+        return webView;
+    }
+#endif
+    webView->loadUrl(state.url);
     return webView;
 }
 
+/*
+    A tab that is hibernated keeps its place in the tab bar but not its
+    WebView.  It is loaded again like a tab restored on demand.
+ */
+bool TabWidget::canHibernate(int index) const
+{
+    WebView *webView = this->webView(index);
+    return webView
+        && index != currentIndex()
+        && !webView->url().isEmpty()
+        && !webView->isModified();
+}
+
+/*!
+    Destroys the WebView of the background tab at \a index keeping only
+    its url, history and scroll position.  The page is loaded again when
+    the tab is shown.
+
+    Returns false if the tab can not be hibernated.
+ */
+bool TabWidget::hibernateTab(int index)
+{
+    if (!canHibernate(index))
+        return false;
+
+    QWidget *widget = this->widget(index);
+    WebView *webView = this->webView(index);
+    m_pendingTabs.insert(widget, tabState(index));
+    m_restoreScrollPositions.remove(webView);
+    m_webViewIndexes.remove(webView);
+    m_tabUpdates.remove(webView);
+    qobject_cast<WebViewWithSearch*>(widget)->clearWebView();
+    return true;
+}
+
+// Returns the resident memory of the process in bytes or -1 if it is not known
+static qint64 processMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile statm(QLatin1String("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.count() > 1)
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return -1;
+}
+
+/*
+    Hibernates the background tabs that have not been shown for
+    m_hibernateAfter minutes and, while the process uses more than
+    m_hibernateMemoryLimit, the least recently shown one.
+ */
+void TabWidget::hibernateTabs()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    int leastRecent = -1;
+    QDateTime leastRecentTime;
+    for (int i = 0; i < count(); ++i) {
+        if (!canHibernate(i))
+            continue;
+        QWidget *widget = this->widget(i);
+        if (!m_lastActive.contains(widget)) {
+            m_lastActive.insert(widget, now);
+            continue;
+        }
+        QDateTime lastActive = m_lastActive.value(widget);
+        if (m_hibernateAfter > 0 && lastActive.secsTo(now) >= m_hibernateAfter * 60) {
+            hibernateTab(i);
+            continue;
+        }
+        if (leastRecent == -1 || lastActive < leastRecentTime) {
+            leastRecent = i;
+            leastRecentTime = lastActive;
+        }
+    }
+
+    if (leastRecent != -1 && m_hibernateMemoryLimit > 0
+        && processMemory() > m_hibernateMemoryLimit)
+        hibernateTab(leastRecent);
+}
+
+void TabWidget::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_hibernateTimer.timerId()) {
+        hibernateTabs();
+        return;
+    }
+    if (event->timerId() == m_tabUpdateTimer.timerId()) {
+        m_tabUpdateTimer.stop();
+        updateTabs();
+        return;
+    }
+    QTabWidget::timerEvent(event);
+}
+
+/*
+    Loads the tabs restoreState() added in the background with at most
+    m_backgroundRestoreLimit of them loading at the same time.
+ */
+void TabWidget::restorePendingTabs()
+{
+    for (int i = m_backgroundRestores.count() - 1; i >= 0; --i) {
+        if (!m_backgroundRestores.at(i))
+            m_backgroundRestores.removeAt(i);
+    }
+
+    while (!m_restoreQueue.isEmpty()
+           && m_backgroundRestores.count() < m_backgroundRestoreLimit) {
+        int index = indexOf(m_restoreQueue.takeFirst());
+        if (index != -1 && isPendingTab(index))
+            m_backgroundRestores.append(loadPendingTab(index));
+    }
+}
+
 void TabWidget::geometryChangeRequestedCheck(const QRect &geometry)
 {
     if (count() == 1)
@@ -485,11 +751,11 @@ void TabWidget::bookmarkTabs()
 
     for (int i = 0; i < count(); ++i) {
         WebView *tab = webView(i);
-        if (!tab)
+        if (!tab && !isPendingTab(i))
             continue;
 
-        QString title = tab->title();
-        QString url = QString::fromUtf8(tab->url().toEncoded());
+        QString url = QString::fromUtf8(tabState(i).url.toEncoded());
+        QString title = tab ? tab->title() : url;
         BookmarkNode *bookmark = new BookmarkNode(BookmarkNode::Bookmark);
         bookmark->url = url;
         bookmark->title = title;
@@ -542,7 +808,7 @@ void TabWidget::cloneTab(int index)
         index = currentIndex();
     if (index < 0 || index >= count())
         return;
-    QUrl url = webView(index)->url();
+    QUrl url = tabState(index).url;
     WebView *tab = makeNewTab();
     tab->loadUrl(url);
 }
@@ -573,20 +839,19 @@ void TabWidget::closeTab(int index)
                 return;
         }
         hasFocus = tab->hasFocus();
+    }
 
-        m_recentlyClosedTabsAction->setEnabled(true);
-        m_recentlyClosedTabs.prepend(tab->url());
-#if QT_VERSION >= 0x040600
-        QByteArray tabHistory;
-        QDataStream tabHistoryStream(&tabHistory, QIODevice::WriteOnly);
-        tabHistoryStream << *tab->history();
-        m_recentlyClosedTabsHistory.prepend(tabHistory);
-#else
-        m_recentlyClosedTabsHistory.prepend(QByteArray());
-#endif
-        if (m_recentlyClosedTabs.size() >= TabWidget::m_recentlyClosedTabsSize)
-            m_recentlyClosedTabs.removeLast();
+    if (isPendingTab(index) || (tab && !tab->url().isEmpty())) {
+        TabState state = tabState(index);
+        BrowserApplication::closedTabStore()->prepend(state.url, state.history);
     }
+    m_pendingTabs.remove(widget(index));
+    m_lastActive.remove(widget(index));
+    m_tabIds.remove(widget(index));
+    m_changedTabs.remove(widget(index));
+    m_restoreScrollPositions.remove(tab);
+    m_tabUpdates.remove(tab);
+
     QWidget *lineEdit = m_locationBars->widget(index);
     m_locationBars->removeWidget(lineEdit);
     lineEdit->deleteLater();
@@ -627,11 +892,8 @@ void TabWidget::webViewLoadStarted()
 {
     WebView *webView = qobject_cast<WebView*>(sender());
     int index = webViewIndex(webView);
-    if (-1 != index) {
-        QLabel *label = animationLabel(index, true);
-        if (label->movie())
-            label->movie()->start();
-    }
+    if (-1 != index)
+        scheduleTabUpdate(webView, TabLoadStarted);
 
     if (index != currentIndex())
         return;
@@ -659,17 +921,20 @@ void TabWidget::webViewLoadFinished(bool ok)
     WebView *webView = qobject_cast<WebView*>(sender());
     int index = webViewIndex(webView);
 
+    for (int i = m_backgroundRestores.count() - 1; i >= 0; --i) {
+        if (m_backgroundRestores.at(i) == webView) {
+            m_backgroundRestores.removeAt(i);
+            QTimer::singleShot(0, this, SLOT(restorePendingTabs()));
+        }
+    }
+
+    if (m_restoreScrollPositions.contains(webView))
+        webView->page()->mainFrame()->setScrollPosition(m_restoreScrollPositions.take(webView));
+
     if (-1 != index) {
-        QLabel *label = animationLabel(index, true);
-        if (label->movie())
-            label->movie()->stop();
-#if defined(Q_WS_MAC)
-        QTabBar::ButtonPosition side = m_tabBar->freeSide();
-        m_tabBar->setTabButton(index, side, 0);
-        delete label;
-#endif
+        m_changedTabs.insert(widget(index));
+        scheduleTabUpdate(webView, TabLoadFinished | TabIcon);
     }
-    webViewIconChanged();
 
     if (index != currentIndex())
         return;
@@ -683,17 +948,8 @@ void TabWidget::webViewLoadFinished(bool ok)
 void TabWidget::webViewIconChanged()
 {
     WebView *webView = qobject_cast<WebView*>(sender());
-    int index = webViewIndex(webView);
-    if (-1 != index) {
-#if !defined(Q_WS_MAC)
-        QIcon icon = BrowserApplication::instance()->icon(webView->url());
-        QLabel *label = animationLabel(index, false);
-        QMovie *movie = label->movie();
-        delete movie;
-        label->setMovie(0);
-        label->setPixmap(icon.pixmap(16, 16));
-#endif
-    }
+    if (-1 != webViewIndex(webView))
+        scheduleTabUpdate(webView, TabIcon);
 }
 
 void TabWidget::webViewTitleChanged(const QString &title)
@@ -702,12 +958,8 @@ void TabWidget::webViewTitleChanged(const QString &title)
     int index = webViewIndex(webView);
     if (-1 == index)
         return;
-    QString tabTitle = title;
-    if (title.isEmpty())
-        tabTitle = QString::fromUtf8(webView->url().toEncoded());
-    tabTitle.replace(QLatin1Char('&'), QLatin1String("&&"));
-    setTabText(index, tabTitle);
-    setTabToolTip(index, tabTitle);
+    scheduleTabUpdate(webView, TabTitle);
+    m_changedTabs.insert(widget(index));
     if (currentIndex() == index)
         emit setCurrentTitle(title);
     BrowserApplication::historyManager()->updateHistoryEntry(webView->url(), title);
@@ -715,41 +967,124 @@ void TabWidget::webViewTitleChanged(const QString &title)
 
 void TabWidget::webViewUrlChanged(const QUrl &url)
 {
+    Q_UNUSED(url);
     WebView *webView = qobject_cast<WebView*>(sender());
     int index = webViewIndex(webView);
     if (-1 == index)
         return;
-    m_tabBar->setTabData(index, url);
+    scheduleTabUpdate(webView, TabUrl);
+    m_changedTabs.insert(widget(index));
     emit tabsChanged();
 }
 
+/*
+    Changes to the tab bar are not made as the signals of the WebViews
+    arrive but collected and made at most once a frame, with many tabs
+    loading at the same time most of them would be redone right away.
+ */
+void TabWidget::scheduleTabUpdate(WebView *webView, int updates)
+{
+    int &pending = m_tabUpdates[webView];
+    // Only the last of a started and finished load matters
+    if (updates & TabLoadStarted)
+        pending &= ~TabLoadFinished;
+    if (updates & TabLoadFinished)
+        pending &= ~TabLoadStarted;
+    pending |= updates;
+    if (!m_tabUpdateTimer.isActive())
+        m_tabUpdateTimer.start(16, this);
+}
+
+void TabWidget::updateTabs()
+{
+    QHash<WebView*, int> tabUpdates = m_tabUpdates;
+    m_tabUpdates.clear();
+
+    QHash<WebView*, int>::const_iterator it = tabUpdates.constBegin();
+    for (; it != tabUpdates.constEnd(); ++it) {
+        WebView *webView = it.key();
+        int updates = it.value();
+        int index = webViewIndex(webView);
+        if (-1 == index)
+            continue;
+
+        if (updates & TabLoadStarted) {
+            QLabel *label = animationLabel(index, true);
+            if (label->movie()) {
+                label->movie()->start();
+                if (!isVisible())
+                    label->movie()->setPaused(true);
+            }
+        }
+
+        if (updates & TabLoadFinished) {
+            QLabel *label = animationLabel(index, true);
+            if (label->movie())
+                label->movie()->stop();
+#if defined(Q_WS_MAC)
+            QTabBar::ButtonPosition side = m_tabBar->freeSide();
+            m_tabBar->setTabButton(index, side, 0);
+            delete label;
+#endif
+        }
+
+#if !defined(Q_WS_MAC)
+        if (updates & TabIcon) {
+            QIcon icon = BrowserApplication::instance()->icon(webView->url());
+            QLabel *label = animationLabel(index, false);
+            QMovie *movie = label->movie();
+            delete movie;
+            label->setMovie(0);
+            label->setPixmap(icon.pixmap(16, 16));
+        }
+#endif
+
+        if (updates & TabTitle) {
+            QString tabTitle = webView->title();
+            if (tabTitle.isEmpty())
+                tabTitle = QString::fromUtf8(webView->url().toEncoded());
+            tabTitle.replace(QLatin1Char('&'), QLatin1String("&&"));
+            setTabText(index, tabTitle);
+            setTabToolTip(index, tabTitle);
+        }
+
+        if (updates & TabUrl)
+            m_tabBar->setTabData(index, webView->url());
+    }
+}
+
 void TabWidget::openLastTab()
 {
-    if (m_recentlyClosedTabs.isEmpty())
+    openClosedTab(0);
+}
+
+void TabWidget::openClosedTab(int index)
+{
+    ClosedTabStore *store = BrowserApplication::closedTabStore();
+    if (index < 0 || index >= store->count())
         return;
-    QUrl url = m_recentlyClosedTabs.takeFirst();
-    QByteArray historyState = m_recentlyClosedTabsHistory.takeFirst();
+    ClosedTabStore::Tab tab = store->take(index);
 #if QT_VERSION >= 0x040600
-    createTab(historyState, NewTab);
+    // Tabs that were never shown might not have a history
+    if (!tab.history.isEmpty())
+        createTab(tab.history, NewTab);
+    else
+        loadUrl(tab.url, NewTab);
 #else
-    loadUrl(url, NewTab);
+    loadUrl(tab.url, NewTab);
 #endif
-    m_recentlyClosedTabsAction->setEnabled(!m_recentlyClosedTabs.isEmpty());
 }
 
 void TabWidget::aboutToShowRecentTabsMenu()
 {
     m_recentlyClosedTabsMenu->clear();
-    for (int i = 0; i < m_recentlyClosedTabs.count(); ++i) {
+    ClosedTabStore *store = BrowserApplication::closedTabStore();
+    for (int i = 0; i < store->count(); ++i) {
         QAction *action = new QAction(m_recentlyClosedTabsMenu);
-#if QT_VERSION >= 0x040600
-        action->setData(m_recentlyClosedTabsHistory.at(i));
-#else
-        action->setData(m_recentlyClosedTabs.at(i));
-#endif
-        QIcon icon = BrowserApplication::instance()->icon(m_recentlyClosedTabs.at(i));
+        action->setData(store->id(i));
+        QIcon icon = BrowserApplication::instance()->icon(store->url(i));
         action->setIcon(icon);
-        action->setText(m_recentlyClosedTabs.at(i).toString());
+        action->setText(store->url(i).toString());
         m_recentlyClosedTabsMenu->addAction(action);
     }
 }
@@ -758,14 +1093,7 @@ void TabWidget::aboutToShowRecentTriggeredAction(QAction *action)
 {
     if (!action)
         return;
-
-#if QT_VERSION >= 0x040600
-    QByteArray historyState = action->data().toByteArray();
-    createTab(historyState, NewTab);
-#else
-    QUrl url = action->data().toUrl();
-    loadUrl(url, NewTab);
-#endif
+    openClosedTab(BrowserApplication::closedTabStore()->indexOf(action->data().toUInt()));
 }
 
 void TabWidget::retranslate()
@@ -800,6 +1128,42 @@ void TabWidget::changeEvent(QEvent *event)
     QTabWidget::changeEvent(event);
 }
 
+/*
+    While the window is hidden or minimized the current tab is put in the
+    background with the others and the loading animations are paused.
+ */
+void TabWidget::hideEvent(QHideEvent *event)
+{
+    QTabWidget::hideEvent(event);
+    if (WebView *webView = currentWebView())
+        webView->webPage()->setBackground(true);
+    setAnimationsPaused(true);
+}
+
+void TabWidget::showEvent(QShowEvent *event)
+{
+    QTabWidget::showEvent(event);
+    if (WebView *webView = currentWebView())
+        webView->webPage()->setBackground(false);
+    setAnimationsPaused(false);
+}
+
+void TabWidget::setAnimationsPaused(bool paused)
+{
+    QTabBar::ButtonPosition side = m_tabBar->freeSide();
+    for (int i = 0; i < count(); ++i) {
+        QLabel *label = qobject_cast<QLabel*>(m_tabBar->tabButton(i, side));
+        if (!label || !label->movie())
+            continue;
+        // Unpausing a movie that was stopped would start it again
+        QMovie *movie = label->movie();
+        if (paused && movie->state() == QMovie::Running)
+            movie->setPaused(true);
+        else if (!paused && movie->state() == QMovie::Paused)
+            movie->setPaused(false);
+    }
+}
+
 /*
     Transform string into a QUrl and then load it.
 
@@ -891,6 +1255,13 @@ void TabWidget::loadSettings()
         setCornerWidget(0, newTabButtonInRightCorner ? Qt::TopLeftCorner : Qt::TopRightCorner);
     }
     m_tabBar->setTabsClosable(!oneCloseButton);
+
+    m_hibernateAfter = settings.value(QLatin1String("hibernateAfter"), 0).toInt();
+    m_hibernateMemoryLimit = settings.value(QLatin1String("hibernateMemoryLimit"), 0).toLongLong() * 1024 * 1024;
+    if (m_hibernateAfter > 0 || m_hibernateMemoryLimit > 0)
+        m_hibernateTimer.start(30 * 1000, this);
+    else
+        m_hibernateTimer.stop();
 }
 
 /*
@@ -1014,87 +1385,350 @@ void TabWidget::previousTab()
 
 static const qint32 TabWidgetMagic = 0xaa;
 
-QByteArray TabWidget::saveState() const
+/*
+    Returns what it takes to load the tab at \a index again.  This is what
+    saveState() saves and what a tab keeps while it is hibernated.
+ */
+TabWidget::TabState TabWidget::tabState(int index) const
 {
-    int version = 1;
-    QByteArray data;
-    QDataStream stream(&data, QIODevice::WriteOnly);
-
-    stream << qint32(TabWidgetMagic);
-    stream << qint32(version);
+    if (isPendingTab(index))
+        return m_pendingTabs.value(widget(index));
 
-    QStringList tabs;
-    QList<QByteArray> tabsHistory;
-    for (int i = 0; i < count(); ++i) {
-        if (WebView *tab = webView(i)) {
-            tabs.append(QString::fromUtf8(tab->url().toEncoded()));
+    TabState state;
+    WebView *tab = webView(index);
+    if (!tab)
+        return state;
+    state.url = tab->url();
+    state.title = tab->title();
 #if QT_VERSION >= 0x040600
-            if (tab->history()->count() != 0) {
-                QByteArray tabHistory;
-                QDataStream tabHistoryStream(&tabHistory, QIODevice::WriteOnly);
-                tabHistoryStream << *tab->history();
-                tabsHistory.append(tabHistory);
-            } else {
-                tabsHistory << QByteArray();
-            }
-#else
-            tabsHistory.append(QByteArray());
+    if (tab->history()->count() != 0) {
+        QDataStream historyStream(&state.history, QIODevice::WriteOnly);
+        historyStream << *tab->history();
+    }
 #endif
-        } else {
-            tabs.append(QString::null);
-            tabsHistory.append(QByteArray());
+    state.scrollPosition = tab->page()->mainFrame()->scrollPosition();
+    return state;
+}
+
+QByteArray TabWidget::saveState() const
+{
+    QList<QUrl> urls;
+    QStringList titles;
+    QList<QByteArray> histories;
+    for (int i = 0; i < count(); ++i) {
+        TabState state = tabState(i);
+        urls.append(state.url);
+        titles.append(state.title);
+        histories.append(state.history);
+    }
+    return stateFromTabs(urls, histories, currentIndex(), titles);
+}
+
+static void writeVarint(QByteArray &data, quint32 value)
+{
+    while (value >= 0x80) {
+        data.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+static bool readVarint(const QByteArray &data, int &position, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (position >= data.size())
+            return false;
+        uchar byte = data.at(position++);
+        value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void writeBytes(QByteArray &data, const QByteArray &bytes)
+{
+    writeVarint(data, bytes.size());
+    data.append(bytes);
+}
+
+static bool readBytes(const QByteArray &data, int &position, QByteArray &bytes)
+{
+    quint32 size;
+    if (!readVarint(data, position, size) || size > quint32(data.size() - position))
+        return false;
+    bytes = data.mid(position, size);
+    position += size;
+    return true;
+}
+
+/*
+    Adds \a value to \a table unless it is already in it and returns its
+    position, empty values are not stored and are 0.
+ */
+static quint32 tableIndex(QList<QByteArray> &table, QHash<QByteArray, quint32> &indexes,
+                          const QByteArray &value)
+{
+    if (value.isEmpty())
+        return 0;
+    if (!indexes.contains(value)) {
+        indexes.insert(value, table.count() + 1);
+        table.append(value);
+    }
+    return indexes.value(value);
+}
+
+static void writeTable(QByteArray &data, const QList<QByteArray> &table)
+{
+    writeVarint(data, table.count());
+    foreach (const QByteArray &value, table)
+        writeBytes(data, value);
+}
+
+/*!
+    Returns the state restoreState() takes for tabs with \a urls,
+    \a histories and the page \a titles of which the one at
+    \a currentIndex is the current one.
+
+    Every url, title and history is written once no matter how many tabs
+    share it, the tabs refer to them by their position in a table.  The
+    histories repeat the urls and titles of the pages in them so all of
+    it is compressed.
+
+    The tables belong to this one state, every window of a session
+    writes its own, so a url open in two windows is stored twice.
+ */
+QByteArray TabWidget::stateFromTabs(const QList<QUrl> &urls, const QList<QByteArray> &histories,
+                                    int currentIndex, const QStringList &titles)
+{
+    int version = 2;
+
+    QList<QByteArray> urlTable;
+    QHash<QByteArray, quint32> urlIndexes;
+    QList<QByteArray> historyTable;
+    QHash<QByteArray, quint32> historyIndexes;
+    QList<QByteArray> titleTable;
+    QHash<QByteArray, quint32> titleIndexes;
+    QByteArray tabs;
+    QByteArray tabTitles;
+    for (int i = 0; i < urls.count(); ++i) {
+        QByteArray url = urls.at(i).toEncoded();
+        if (!urlIndexes.contains(url)) {
+            urlIndexes.insert(url, urlTable.count());
+            urlTable.append(url);
         }
+        writeVarint(tabs, urlIndexes.value(url));
+
+        // 0 is a tab without a history or a title
+        writeVarint(tabs, tableIndex(historyTable, historyIndexes, histories.value(i)));
+        writeVarint(tabTitles, tableIndex(titleTable, titleIndexes, titles.value(i).toUtf8()));
     }
-    stream << tabs;
-    stream << currentIndex();
-    stream << tabsHistory;
 
+    QByteArray body;
+    writeTable(body, urlTable);
+    writeTable(body, historyTable);
+    writeVarint(body, urls.count());
+    body.append(tabs);
+    writeVarint(body, qMax(-1, currentIndex) + 1);
+
+    // The titles come last, the states written before they were saved
+    // end after the current tab
+    writeTable(body, titleTable);
+    body.append(tabTitles);
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << qint32(TabWidgetMagic);
+    stream << qint32(version);
+    stream << qCompress(body);
     return data;
 }
 
-bool TabWidget::restoreState(const QByteArray &state)
+static bool readTable(const QByteArray &data, int &position, QList<QByteArray> &table)
+{
+    quint32 count;
+    if (!readVarint(data, position, count))
+        return false;
+    for (quint32 i = 0; i < count; ++i) {
+        QByteArray value;
+        if (!readBytes(data, position, value))
+            return false;
+        table.append(value);
+    }
+    return true;
+}
+
+/*
+    Reads the tabs stateFromTabs() wrote to \a state, and the tabs of
+    the sessions written before the tabs shared their urls and histories.
+    Tabs without a saved title get an empty one.
+ */
+static bool readTabs(const QByteArray &state, QList<QUrl> &urls, QStringList &titles,
+                     QList<QByteArray> &histories, int &currentIndex)
 {
-    int version = 1;
-    QByteArray sd = state;
-    QDataStream stream(&sd, QIODevice::ReadOnly);
+    QDataStream stream(state);
     if (stream.atEnd())
         return false;
 
     qint32 marker;
-    qint32 v;
+    qint32 version;
     stream >> marker;
-    stream >> v;
-    if (marker != TabWidgetMagic || v != version)
+    stream >> version;
+    if (marker != TabWidgetMagic || !(version == 1 || version == 2))
         return false;
 
-    QStringList openTabs;
-    stream >> openTabs;
+    if (version == 1) {
+        QStringList openTabs;
+        stream >> openTabs;
+        stream >> currentIndex;
+        stream >> histories;
+        foreach (const QString &tab, openTabs) {
+            urls.append(QUrl::fromEncoded(tab.toUtf8()));
+            titles.append(QString());
+        }
+        return true;
+    }
 
-    int currentTab;
-    stream >> currentTab;
-    setCurrentIndex(currentTab);
+    QByteArray compressed;
+    stream >> compressed;
+    QByteArray body = qUncompress(compressed);
+    int position = 0;
+
+    QList<QByteArray> urlTable;
+    QList<QByteArray> historyTable;
+    if (!readTable(body, position, urlTable)
+        || !readTable(body, position, historyTable))
+        return false;
+
+    quint32 count;
+    if (!readVarint(body, position, count))
+        return false;
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 url;
+        quint32 history;
+        if (!readVarint(body, position, url) || url >= quint32(urlTable.count())
+            || !readVarint(body, position, history) || history > quint32(historyTable.count()))
+            return false;
+        urls.append(QUrl::fromEncoded(urlTable.at(url)));
+        histories.append(history ? historyTable.at(history - 1) : QByteArray());
+    }
+
+    quint32 current;
+    if (!readVarint(body, position, current))
+        return false;
+    currentIndex = int(current) - 1;
+
+    QList<QByteArray> titleTable;
+    bool hasTitles = readTable(body, position, titleTable);
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 title = 0;
+        if (!hasTitles || !readVarint(body, position, title) || title > quint32(titleTable.count()))
+            title = 0;
+        titles.append(title ? QString::fromUtf8(titleTable.at(title - 1)) : QString());
+    }
+    return true;
+}
+
+/*!
+    Writes the tabs of \a window to \a journal, only the tabs that
+    navigated since the last time are written again.
+ */
+void TabWidget::journalSession(SessionJournal *journal, quint32 window)
+{
+    static quint32 lastTabId = 0;
+    QList<quint32> tabs;
+    for (int i = 0; i < count(); ++i) {
+        QWidget *widget = this->widget(i);
+        quint32 id = m_tabIds.value(widget);
+        if (!id) {
+            id = ++lastTabId;
+            m_tabIds.insert(widget, id);
+            m_changedTabs.insert(widget);
+        }
+        tabs.append(id);
+        if (m_changedTabs.contains(widget)) {
+            TabState state = tabState(i);
+            journal->setTab(id, state.url, state.history, state.title);
+        }
+    }
+    m_changedTabs.clear();
+
+    SessionJournal::Window journaled = journal->window(window);
+    if (journaled.tabs != tabs || journaled.currentTab != currentIndex())
+        journal->setTabs(window, tabs, currentIndex());
+}
+
+bool TabWidget::restoreState(const QByteArray &state)
+{
+    QList<QUrl> openTabs;
+    QStringList titles;
     QList<QByteArray> tabHistory;
-    stream >> tabHistory;
+    int currentTab;
+    if (!readTabs(state, openTabs, titles, tabHistory, currentTab))
+        return false;
 
-    for (int i = 0; i < openTabs.count(); ++i) {
-        QUrl url = QUrl::fromEncoded(openTabs.at(i).toUtf8());
-        TabWidget::OpenUrlIn tab = i == 0 && currentWebView()->url() == QUrl() ? CurrentTab : NewTab;
+    QSettings settings;
+    settings.beginGroup(QLatin1String("tabs"));
+    bool onDemand = settings.value(QLatin1String("restoreOnDemand"), true).toBool();
+    m_backgroundRestoreLimit = settings.value(QLatin1String("restoreInBackground"), 0).toInt();
+
+    if (!onDemand) {
+        setCurrentIndex(currentTab);
+        for (int i = 0; i < openTabs.count(); ++i) {
+            QUrl url = openTabs.at(i);
+            TabWidget::OpenUrlIn tab = i == 0 && currentWebView()->url() == QUrl() ? CurrentTab : NewTab;
 #if QT_VERSION >= 0x040600
-        QByteArray historyState = tabHistory.value(i);
-        if (!historyState.isEmpty()) {
-            createTab(historyState, tab);
-        } else {
+            QByteArray historyState = tabHistory.value(i);
+            if (!historyState.isEmpty()) {
+                createTab(historyState, tab);
+            } else {
 #endif
-            if (WebView *webView = getView(tab, currentWebView()))
-                webView->loadUrl(url);
+                if (WebView *webView = getView(tab, currentWebView()))
+                    webView->loadUrl(url);
 #if QT_VERSION >= 0x040600
-        }
+            }
 #endif
+        }
+        return true;
+    }
 
+    // Only the current tab is loaded, the others wait until they are shown
+    WebView *blankView = currentWebView();
+    if (blankView && !blankView->url().isEmpty())
+        blankView = 0;
+    int first = count();
+    for (int i = 0; i < openTabs.count(); ++i) {
+        addPendingTab(openTabs.at(i), titles.value(i), tabHistory.value(i));
+        if (m_backgroundRestoreLimit > 0)
+            m_restoreQueue.append(widget(count() - 1));
     }
+    if (currentTab < 0 || currentTab >= openTabs.count())
+        currentTab = 0;
+    setCurrentIndex(first + currentTab);
+    if (blankView && !openTabs.isEmpty())
+        closeTab(webViewIndex(blankView));
+    emit tabsChanged();
+
+    if (m_backgroundRestoreLimit > 0)
+        QTimer::singleShot(0, this, SLOT(restorePendingTabs()));
     return true;
 }
 
+/*!
+    Returns the urls of the tabs in \a state without restoring them.
+ */
+QList<QUrl> TabWidget::urlsFromState(const QByteArray &state)
+{
+    QList<QUrl> urls;
+    QStringList titles;
+    QList<QByteArray> histories;
+    int currentIndex;
+    if (!readTabs(state, urls, titles, histories, currentIndex))
+        return QList<QUrl>();
+    return urls;
+}
+
 void TabWidget::createTab(const QByteArray &historyState, TabWidget::OpenUrlIn tab)
 {
 #if QT_VERSION >= 0x040600
@@ -65,6 +65,12 @@
 
 #include <qtabwidget.h>
 
+#include <qbasictimer.h>
+#include <qdatetime.h>
+#include <qhash.h>
+#include <qpointer.h>
+#include <qset.h>
+#include <qstringlist.h>
 #include <qwebpage.h>
 #include <qurl.h>
 
@@ -77,6 +83,8 @@ class QStackedWidget;
 QT_END_NAMESPACE
 
 class BrowserMainWindow;
+class LocationBar;
+class SessionJournal;
 class TabBar;
 class WebView;
 class WebActionMapper;
@@ -141,15 +149,27 @@ public:
     QLineEdit *locationBar(int index) const;
     int webViewIndex(WebView *webView) const;
     WebView *makeNewTab(bool makeCurrent = false);
+    bool isPendingTab(int index) const;
+    WebView *loadPendingTab(int index);
+    bool hibernateTab(int index);
 
     QByteArray saveState() const;
     bool restoreState(const QByteArray &state);
+    static QList<QUrl> urlsFromState(const QByteArray &state);
+    static QByteArray stateFromTabs(const QList<QUrl> &urls, const QList<QByteArray> &histories,
+                                    int currentIndex, const QStringList &titles = QStringList());
+    void journalSession(SessionJournal *journal, quint32 window);
 
     static OpenUrlIn modifyWithUserBehavior(OpenUrlIn tab);
     WebView *getView(OpenUrlIn tab, WebView *currentView);
 
 protected:
     void changeEvent(QEvent *event);
+    void hideEvent(QHideEvent *event);
+    void showEvent(QShowEvent *event);
+    void timerEvent(QTimerEvent *event);
+    void tabInserted(int index);
+    void tabRemoved(int index);
 
 public slots:
     void loadString(const QString &string, OpenUrlIn tab = CurrentTab);
@@ -171,6 +191,7 @@ private slots:
     void openLastTab();
     void aboutToShowRecentTabsMenu();
     void aboutToShowRecentTriggeredAction(QAction *action);
+    void closedTabsChanged();
     void webViewLoadStarted();
     void webViewLoadProgress(int progress);
     void webViewLoadFinished(bool ok);
@@ -185,10 +206,22 @@ private slots:
     void statusBarVisibilityChangeRequestedCheck(bool visible);
     void toolBarVisibilityChangeRequestedCheck(bool visible);
     void historyCleared();
+    void historyManagerCreated();
+    void restorePendingTabs();
 
 private:
     static QUrl guessUrlFromString(const QString &url);
+    LocationBar *makeLocationBar();
+    WebView *makeWebView(LocationBar *locationBar);
+    void addPendingTab(const QUrl &url, const QString &title, const QByteArray &historyState);
+    void openClosedTab(int index);
+    bool canHibernate(int index) const;
+    void hibernateTabs();
     QLabel *animationLabel(int index, bool addMovie);
+    void setAnimationsPaused(bool paused);
+    void updateWebViewIndexes();
+    void scheduleTabUpdate(WebView *webView, int updates);
+    void updateTabs();
     void retranslate();
 
     QAction *m_recentlyClosedTabsAction;
@@ -199,11 +232,40 @@ private:
     QAction *m_previousTabAction;
 
     QMenu *m_recentlyClosedTabsMenu;
-    static const int m_recentlyClosedTabsSize = 10;
-    QList<QUrl> m_recentlyClosedTabs;
-    QList<QByteArray> m_recentlyClosedTabsHistory;
     QList<WebActionMapper*> m_actions;
 
+    struct TabState {
+        QUrl url;
+        QString title;
+        QByteArray history;
+        QPoint scrollPosition;
+    };
+    TabState tabState(int index) const;
+    QHash<QWidget*, TabState> m_pendingTabs;
+    QList<QPointer<QWidget> > m_restoreQueue;
+    QList<QPointer<WebView> > m_backgroundRestores;
+    int m_backgroundRestoreLimit;
+    QHash<WebView*, QPoint> m_restoreScrollPositions;
+
+    QBasicTimer m_hibernateTimer;
+    QHash<QWidget*, QDateTime> m_lastActive;
+    int m_hibernateAfter;
+    qint64 m_hibernateMemoryLimit;
+
+    QHash<QWidget*, quint32> m_tabIds;
+    QSet<QWidget*> m_changedTabs;
+
+    enum TabUpdate {
+        TabLoadStarted = 0x1,
+        TabLoadFinished = 0x2,
+        TabIcon = 0x4,
+        TabTitle = 0x8,
+        TabUrl = 0x10
+    };
+    QHash<WebView*, int> m_webViewIndexes;
+    QHash<WebView*, int> m_tabUpdates;
+    QBasicTimer m_tabUpdateTimer;
+
     QCompleter *m_lineEditCompleter;
     QStackedWidget *m_locationBars;
     TabBar *m_tabBar;
@@ -101,9 +101,6 @@ ToolbarSearch::ToolbarSearch(QWidget *parent)
     , m_suggestTimer(0)
     , m_completer(0)
 {
-    connect(openSearchManager(), SIGNAL(currentEngineChanged()),
-            this, SLOT(currentEngineChanged()));
-
     m_completer = new QCompleter(m_model, this);
     m_completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
     setCompleter(m_completer);
@@ -117,6 +114,17 @@ ToolbarSearch::ToolbarSearch(QWidget *parent)
 
     load();
 
+    // Reading the search engines is left until the window is up
+    if (s_openSearchManager)
+        setupEngine();
+    else
+        QTimer::singleShot(0, this, SLOT(setupEngine()));
+}
+
+void ToolbarSearch::setupEngine()
+{
+    connect(openSearchManager(), SIGNAL(currentEngineChanged()),
+            this, SLOT(currentEngineChanged()));
     currentEngineChanged();
 }
 
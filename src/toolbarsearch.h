@@ -92,6 +92,7 @@ public slots:
     void searchNow();
 
 private slots:
+    void setupEngine();
     void currentEngineChanged();
     void save();
     void textEdited(const QString &);
@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "publicsuffix.h"
+
+#include "publicsuffix_p.h"
+
+#define PUBLICSUFFIX_TABLESIZE(table) int(sizeof(table) / sizeof(table[0]) - 1)
+
+// Length of the host without the trailing dot of a fully qualified name
+static int hostLength(const QString &host)
+{
+    int length = host.length();
+    if (length > 0 && host.at(length - 1) == QLatin1Char('.'))
+        --length;
+    return length;
+}
+
+static int compareRule(const QChar *begin, const QChar *end, const char *rule)
+{
+    for (; begin != end && *rule; ++begin, ++rule) {
+        ushort c = begin->toLower().unicode();
+        ushort r = uchar(*rule);
+        if (c != r)
+            return c < r ? -1 : 1;
+    }
+    if (begin != end)
+        return 1;
+    if (*rule)
+        return -1;
+    return 0;
+}
+
+static bool containsRule(const char *const table[], int size, const QChar *begin, const QChar *end)
+{
+    int low = 0;
+    int high = size - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        int result = compareRule(begin, end, table[middle]);
+        if (result == 0)
+            return true;
+        if (result < 0)
+            high = middle - 1;
+        else
+            low = middle + 1;
+    }
+    return false;
+}
+
+/*
+    Returns the position in host where its public suffix starts, 0 if
+    the whole host is a public suffix or -1 if host is empty.
+*/
+int PublicSuffix::publicSuffixIndex(const QString &host)
+{
+    int length = hostLength(host);
+    if (length == 0)
+        return -1;
+
+    const QChar *data = host.constData();
+    const QChar *end = data + length;
+
+    // Walk from the longest suffix to the shortest so that the first
+    // rule that matches is the prevailing one.
+    int index = 0;
+    forever {
+        int dot = host.indexOf(QLatin1Char('.'), index);
+        if (dot >= length)
+            dot = -1;
+
+        // Exception rules always have a wildcard parent
+        if (dot != -1
+            && containsRule(publicSuffixExceptionRules,
+                            PUBLICSUFFIX_TABLESIZE(publicSuffixExceptionRules),
+                            data + index, end))
+            return dot + 1;
+
+        if (containsRule(publicSuffixRules,
+                         PUBLICSUFFIX_TABLESIZE(publicSuffixRules),
+                         data + index, end))
+            return index;
+
+        if (dot == -1)
+            break;
+
+        if (containsRule(publicSuffixWildcardRules,
+                         PUBLICSUFFIX_TABLESIZE(publicSuffixWildcardRules),
+                         data + dot + 1, end))
+            return index;
+
+        index = dot + 1;
+    }
+
+    // Nothing matched, the default rule "*" makes the last label public
+    return index;
+}
+
+/*
+    Returns the position in host where the registrable domain, the
+    public suffix plus one label, starts or -1 if host is a public suffix.
+*/
+int PublicSuffix::registrableDomainIndex(const QString &host)
+{
+    int suffix = publicSuffixIndex(host);
+    if (suffix <= 1)
+        return -1;
+
+    int dot = suffix - 1;
+    int start = host.lastIndexOf(QLatin1Char('.'), dot - 1) + 1;
+    if (start == dot)
+        return -1;
+    return start;
+}
+
+bool PublicSuffix::isPublicSuffix(const QString &host)
+{
+    return publicSuffixIndex(host) == 0;
+}
+
+QString PublicSuffix::publicSuffix(const QString &host)
+{
+    int index = publicSuffixIndex(host);
+    if (index == -1)
+        return QString();
+    return host.mid(index, hostLength(host) - index);
+}
+
+QString PublicSuffix::registrableDomain(const QString &host)
+{
+    int index = registrableDomainIndex(host);
+    if (index == -1)
+        return QString();
+    return host.mid(index, hostLength(host) - index);
+}
+
@@ -0,0 +1,204 @@
+// This file is generated by tools/publicsuffix/generatePublicSuffix
+// from tools/publicsuffix/effective_tld_names.dat, do not edit it by hand.
+
+#ifndef PUBLICSUFFIX_P_H
+#define PUBLICSUFFIX_P_H
+
+// Each table is sorted in byte order so that it can be binary searched.
+
+// example
+static const char *const publicSuffixRules[] = {
+    "ac.jp",
+    "ad.jp",
+    "aero",
+    "ao",
+    "ar",
+    "arpa",
+    "asia",
+    "bd",
+    "biz",
+    "bn",
+    "br",
+    "cat",
+    "ck",
+    "co",
+    "co.jp",
+    "com",
+    "coop",
+    "cr",
+    "cy",
+    "do",
+    "ed.jp",
+    "edu",
+    "eg",
+    "et",
+    "fj",
+    "fk",
+    "gh",
+    "gn",
+    "go.jp",
+    "gov",
+    "gr.jp",
+    "gu",
+    "id",
+    "il",
+    "info",
+    "int",
+    "jm",
+    "jobs",
+    "jp",
+    "ke",
+    "kh",
+    "ki",
+    "kw",
+    "kz",
+    "lb",
+    "lc",
+    "lg.jp",
+    "lr",
+    "ls",
+    "mil",
+    "ml",
+    "mm",
+    "mobi",
+    "museum",
+    "mv",
+    "mw",
+    "mx",
+    "my",
+    "name",
+    "ne.jp",
+    "net",
+    "ng",
+    "ni",
+    "np",
+    "nz",
+    "om",
+    "or.jp",
+    "org",
+    "pa",
+    "pe",
+    "pg",
+    "pro",
+    "pw",
+    "py",
+    "qa",
+    "sa",
+    "sb",
+    "sv",
+    "sy",
+    "tel",
+    "th",
+    "tn",
+    "travel",
+    "tz",
+    "uk",
+    "uy",
+    "va",
+    "ve",
+    "ye",
+    "yu",
+    "za",
+    "zm",
+    "zw",
+    0
+};
+
+// *.example stored as example
+static const char *const publicSuffixWildcardRules[] = {
+    "ao",
+    "ar",
+    "arpa",
+    "bd",
+    "bn",
+    "br",
+    "ck",
+    "co",
+    "cr",
+    "cy",
+    "do",
+    "eg",
+    "et",
+    "fj",
+    "fk",
+    "gh",
+    "gn",
+    "gu",
+    "id",
+    "il",
+    "jm",
+    "kawasaki.jp",
+    "ke",
+    "kh",
+    "ki",
+    "kitakyushu.jp",
+    "kobe.jp",
+    "kw",
+    "kz",
+    "lb",
+    "lc",
+    "lr",
+    "ls",
+    "ml",
+    "mm",
+    "mv",
+    "mw",
+    "mx",
+    "my",
+    "nagoya.jp",
+    "ng",
+    "ni",
+    "np",
+    "nz",
+    "om",
+    "pa",
+    "pe",
+    "pg",
+    "pw",
+    "py",
+    "qa",
+    "sa",
+    "sapporo.jp",
+    "sb",
+    "sendai.jp",
+    "sv",
+    "sy",
+    "th",
+    "tn",
+    "tz",
+    "uk",
+    "uy",
+    "va",
+    "ve",
+    "ye",
+    "yokohama.jp",
+    "yu",
+    "za",
+    "zm",
+    "zw",
+    0
+};
+
+// !www.example stored as www.example
+static const char *const publicSuffixExceptionRules[] = {
+    "bl.uk",
+    "british-library.uk",
+    "city.kawasaki.jp",
+    "city.kitakyushu.jp",
+    "city.kobe.jp",
+    "city.nagoya.jp",
+    "city.sapporo.jp",
+    "city.sendai.jp",
+    "city.yokohama.jp",
+    "jet.uk",
+    "mod.uk",
+    "national-library-scotland.uk",
+    "nel.uk",
+    "nic.uk",
+    "nls.uk",
+    "parliament.uk",
+    "www.ck",
+    0
+};
+
+#endif // PUBLICSUFFIX_P_H
@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "rateestimator.h"
+
+#include <math.h>
+
+// The length of a slot in milliseconds
+static const int slotLength = 250;
+
+/*!
+    Creates an estimator whose current rate gives half of its weight to the
+    last \a halfLife milliseconds and whose average rate covers the last
+    \a window milliseconds.
+ */
+RateEstimator::RateEstimator(int halfLife, int window)
+    : m_decay(pow(0.5, double(slotLength) / qMax(halfLife, 1)))
+    , m_rate(-1)
+    , m_bytes(0)
+    , m_slotStart(0)
+    , m_slotBytes(0)
+    , m_slots(0)
+    , m_window(qMax(window / slotLength, 1), 0)
+{
+    m_clock.start();
+}
+
+void RateEstimator::start()
+{
+    m_clock.start();
+    m_rate = -1;
+    m_bytes = 0;
+    m_slotStart = 0;
+    m_slotBytes = 0;
+    m_slots = 0;
+    m_window.fill(0);
+}
+
+qint64 RateEstimator::elapsed() const
+{
+    return m_clock.elapsed();
+}
+
+void RateEstimator::addBytes(qint64 bytes, qint64 msecs)
+{
+    closeSlots(msecs == -1 ? elapsed() : msecs);
+    m_slotBytes += bytes;
+    m_bytes += bytes;
+}
+
+qint64 RateEstimator::bytes() const
+{
+    return m_bytes;
+}
+
+/*
+    Ends the slots that are over by \a msecs.
+ */
+void RateEstimator::closeSlots(qint64 msecs)
+{
+    while (msecs >= m_slotStart + slotLength) {
+        double rate = m_slotBytes * 1000.0 / slotLength;
+        m_rate = m_rate < 0 ? rate : m_decay * m_rate + (1 - m_decay) * rate;
+        m_window[m_slots % m_window.count()] = m_slotBytes;
+        ++m_slots;
+        m_slotStart += slotLength;
+        m_slotBytes = 0;
+
+        // After a long stall every slot is empty, skip ahead
+        qint64 empty = (msecs - m_slotStart) / slotLength;
+        if (empty > m_window.count()) {
+            m_rate *= pow(m_decay, double(empty));
+            m_window.fill(0);
+            m_slots += empty;
+            m_slotStart += empty * slotLength;
+        }
+    }
+}
+
+/*!
+    Returns the current rate in bytes per second, or -1 when nothing is
+    known yet.
+ */
+double RateEstimator::currentRate(qint64 msecs) const
+{
+    if (msecs == -1)
+        msecs = elapsed();
+    if (m_rate < 0) {
+        // Still in the first slot
+        if (msecs <= 0)
+            return -1;
+        return m_slotBytes * 1000.0 / msecs;
+    }
+    // Slots that ended without data since the last update lower the rate
+    qint64 empty = (msecs - m_slotStart) / slotLength;
+    if (empty <= 0)
+        return m_rate;
+    double rate = m_decay * m_rate + (1 - m_decay) * m_slotBytes * 1000.0 / slotLength;
+    return rate * pow(m_decay, double(empty - 1));
+}
+
+/*!
+    Returns the average rate over the window in bytes per second, or -1
+    when nothing is known yet.
+ */
+double RateEstimator::averageRate(qint64 msecs) const
+{
+    if (msecs == -1)
+        msecs = elapsed();
+    if (msecs <= 0)
+        return -1;
+    // Slots that ended without data since the last update push the
+    // older ones out of the window
+    qint64 count = m_window.count();
+    qint64 passed = qMax(qint64(0), (msecs - m_slotStart) / slotLength);
+    qint64 closed = m_slots + passed;
+    qint64 first = qMax(qint64(0), closed - count);
+    qint64 bytes = 0;
+    for (qint64 slot = qMax(first, m_slots - count); slot < m_slots; ++slot)
+        bytes += m_window.at(slot % count);
+    if (m_slots >= first)
+        bytes += m_slotBytes;
+    qint64 slotStart = m_slotStart + passed * slotLength;
+    qint64 duration = (closed - first) * slotLength + qMax(qint64(0), msecs - slotStart);
+    return duration > 0 ? bytes * 1000.0 / duration : -1;
+}
+
+/*!
+    Returns the number of seconds it takes to transfer \a bytes at the
+    current rate, or -1 when the rate is not known.
+ */
+double RateEstimator::remainingTime(qint64 bytes, qint64 msecs) const
+{
+    double rate = currentRate(msecs);
+    if (rate <= 0)
+        return -1;
+    return bytes / rate;
+}
+
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2010, Arora Developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Arora Developers nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef RATEESTIMATOR_H
+#define RATEESTIMATOR_H
+
+#include <qvector.h>
+
+#if QT_VERSION >= 0x040700
+#include <qelapsedtimer.h>
+#else
+#include <qdatetime.h>
+#endif
+
+/*
+    Estimates the rate of a transfer from the bytes it is told about.
+
+    Bytes are counted in slots of a quarter of a second.  The current rate
+    is an exponentially weighted moving average of the slot rates so it
+    follows changes within a few seconds without jumping around, and
+    drops while nothing arrives.  The average rate is taken over a sliding
+    window of the last slots.
+
+    Times are in milliseconds since start(), the functions that take one
+    use the estimator's clock when it is -1.
+*/
+class RateEstimator
+{
+public:
+    RateEstimator(int halfLife = 2000, int window = 10000);
+
+    void start();
+    qint64 elapsed() const;
+
+    void addBytes(qint64 bytes, qint64 msecs = -1);
+    qint64 bytes() const;
+
+    double currentRate(qint64 msecs = -1) const;
+    double averageRate(qint64 msecs = -1) const;
+    double remainingTime(qint64 bytes, qint64 msecs = -1) const;
+
+private:
+    void closeSlots(qint64 msecs);
+
+#if QT_VERSION >= 0x040700
+    QElapsedTimer m_clock;
+#else
+    QTime m_clock;
+#endif
+    double m_decay;
+    double m_rate;
+    qint64 m_bytes;
+    qint64 m_slotStart;
+    qint64 m_slotBytes;
+    qint64 m_slots;
+    QVector<qint64> m_window;
+};
+
+#endif // RATEESTIMATOR_H
+
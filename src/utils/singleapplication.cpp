@@ -28,7 +28,9 @@
 
 #include "singleapplication.h"
 
+#include <qdatetime.h>
 #include <qdir.h>
+#include <qendian.h>
 #include <qlocalserver.h>
 #include <qlocalsocket.h>
 #include <qtextstream.h>
@@ -48,16 +50,34 @@ SingleApplication::SingleApplication(int &argc, char **argv)
 {
 }
 
+// Anything longer is not a message from us
+static const int MaximumMessageSize = 16 * 1024 * 1024;
+
 bool SingleApplication::sendMessage(const QByteArray &message, int waitMsecsForReply)
+{
+    return sendMessages(QList<QByteArray>() << message, waitMsecsForReply);
+}
+
+/*!
+    Sends all of the \a messages to the running instance over a single
+    connection.  If \a waitMsecsForReply is set, waits that long for a
+    reply, which is emitted with messageReceived().
+
+    Returns false if there is no running instance.
+ */
+bool SingleApplication::sendMessages(const QList<QByteArray> &messages, int waitMsecsForReply)
 {
 #ifdef SINGALAPPLICATION_DEBUG
-    qDebug() << "SingleApplication::" << __FUNCTION__ << message << waitMsecsForReply;
+    qDebug() << "SingleApplication::" << __FUNCTION__ << messages << waitMsecsForReply;
 #endif
     QLocalSocket socket;
     socket.connectToServer(serverName());
     if (!socket.waitForConnected(500))
         return false;
-    socket.write(message);
+    QByteArray data;
+    foreach (const QByteArray &message, messages)
+        data += frame(message);
+    socket.write(data);
     socket.flush();
     socket.waitForBytesWritten();
     bool success = true;
@@ -67,14 +87,35 @@ bool SingleApplication::sendMessage(const QByteArray &message, int waitMsecsForR
 #endif
         success = false;
     }
-    if (success) {
-        socket.waitForReadyRead(waitMsecsForReply);
-        if (socket.bytesAvailable() > 0)
-            emit messageReceived(&socket);
+    if (success && waitMsecsForReply > 0) {
+        QByteArray buffer;
+        QByteArray reply;
+        QTime time;
+        time.start();
+        int remaining = waitMsecsForReply;
+        while (remaining > 0 && socket.waitForReadyRead(remaining)) {
+            buffer += socket.readAll();
+            if (takeFrame(&buffer, &reply) != 0)
+                break;
+            remaining = waitMsecsForReply - time.elapsed();
+        }
+        if (!reply.isNull())
+            emit messageReceived(&socket, reply);
     }
     return success;
 }
 
+/*!
+    Replies to a message that came in on \a socket without waiting for
+    it to be written.
+ */
+void SingleApplication::sendReply(QLocalSocket *socket, const QByteArray &message)
+{
+    if (!socket || socket->state() != QLocalSocket::ConnectedState)
+        return;
+    socket->write(frame(message));
+}
+
 bool SingleApplication::startSingleServer()
 {
     if (m_localServer)
@@ -126,12 +167,83 @@ bool SingleApplication::isRunning() const
 
 void SingleApplication::newConnection()
 {
-    QLocalSocket *socket = m_localServer->nextPendingConnection();
+    while (QLocalSocket *socket = m_localServer->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, SIGNAL(readyRead()),
+                this, SLOT(readyRead()));
+        connect(socket, SIGNAL(disconnected()),
+                this, SLOT(disconnected()));
+        if (socket->bytesAvailable() > 0)
+            readMessages(socket);
+    }
+}
+
+void SingleApplication::readyRead()
+{
+    if (QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender()))
+        readMessages(socket);
+}
+
+void SingleApplication::disconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
     if (!socket)
         return;
-    socket->waitForReadyRead();
-    emit messageReceived(socket);
-    delete socket;
+    readMessages(socket);
+    m_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+/*
+    Emits every complete message that has arrived on \a socket and keeps
+    what is left of a partial one for the next time.
+ */
+void SingleApplication::readMessages(QLocalSocket *socket)
+{
+    if (!m_buffers.contains(socket))
+        return;
+    QByteArray buffer = m_buffers.value(socket) + socket->readAll();
+    QList<QByteArray> messages;
+    QByteArray next;
+    int result;
+    while ((result = takeFrame(&buffer, &next)) == 1)
+        messages.append(next);
+    if (result < 0) {
+        qWarning() << "SingleApplication: Dropping a connection that sent an invalid message";
+        m_buffers.remove(socket);
+        socket->abort();
+        socket->deleteLater();
+    } else {
+        m_buffers[socket] = buffer;
+    }
+    foreach (const QByteArray &message, messages)
+        emit messageReceived(socket, message);
+}
+
+QByteArray SingleApplication::frame(const QByteArray &message)
+{
+    QByteArray data(4, 0);
+    qToBigEndian<quint32>(message.size(), reinterpret_cast<uchar*>(data.data()));
+    return data + message;
+}
+
+/*
+    Moves the first message out of \a buffer into \a message.  Returns 1
+    if there was a complete message, 0 if more data is needed and -1 if
+    the buffer doesn't hold a message at all.
+ */
+int SingleApplication::takeFrame(QByteArray *buffer, QByteArray *message)
+{
+    if (buffer->size() < 4)
+        return 0;
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer->constData()));
+    if (size > quint32(MaximumMessageSize))
+        return -1;
+    if (quint32(buffer->size()) < 4 + size)
+        return 0;
+    *message = buffer->mid(4, size);
+    buffer->remove(0, 4 + size);
+    return 1;
 }
 
 QString SingleApplication::serverName() const
@@ -31,9 +31,15 @@
 
 #include <qapplication.h>
 
+#include <qhash.h>
+
 /*
     QApplication subclass that should be used when you only want one
     instant of the application to exist at a time.
+
+    Messages are passed over a local socket, each one prefixed with its
+    length so that several can be sent over one connection.  The running
+    instance reads them as they arrive without blocking its event loop.
 */
 class QLocalServer;
 class QLocalSocket;
@@ -42,21 +48,29 @@ class SingleApplication : public QApplication
     Q_OBJECT
 
 signals:
-    void messageReceived(QLocalSocket *socket);
+    void messageReceived(QLocalSocket *socket, const QByteArray &message);
 
 public:
     SingleApplication(int &argc, char **argv);
 
     bool sendMessage(const QByteArray &message, int waitMsecsForReply = 0);
+    bool sendMessages(const QList<QByteArray> &messages, int waitMsecsForReply = 0);
+    void sendReply(QLocalSocket *socket, const QByteArray &message);
     bool startSingleServer();
     bool isRunning() const;
+    QString serverName() const;
 
 private slots:
     void newConnection();
+    void readyRead();
+    void disconnected();
 
 private:
-    QString serverName() const;
+    static QByteArray frame(const QByteArray &message);
+    static int takeFrame(QByteArray *buffer, QByteArray *message);
+    void readMessages(QLocalSocket *socket);
     QLocalServer *m_localServer;
+    QHash<QLocalSocket*, QByteArray> m_buffers;
 
 };
 
@@ -10,6 +10,9 @@ HEADERS += \
     lineedit_p.h \
     networkaccessmanagerproxy.h \
     networkaccessmanagerproxy_p.h \
+    publicsuffix.h \
+    publicsuffix_p.h \
+    rateestimator.h \
     singleapplication.h \
     squeezelabel.h \
     treesortfilterproxymodel.h \
@@ -22,6 +25,8 @@ SOURCES += \
     languagemanager.cpp \
     lineedit.cpp \
     networkaccessmanagerproxy.cpp \
+    publicsuffix.cpp \
+    rateestimator.cpp \
     singleapplication.cpp \
     squeezelabel.cpp \
     treesortfilterproxymodel.cpp \
@@ -33,6 +33,7 @@
 
 #include <qbuffer.h>
 #include <qdesktopservices.h>
+#include <qfile.h>
 #include <qmessagebox.h>
 #include <qnetworkreply.h>
 #include <qnetworkrequest.h>
@@ -95,11 +96,28 @@ QString JavaScriptAroraObject::searchUrl(const QString &string) const
     return QString::fromUtf8(ToolbarSearch::openSearchManager()->currentEngine()->searchUrl(string).toEncoded());
 }
 
+JavaScriptTimersObject::JavaScriptTimersObject(QObject *parent)
+    : QObject(parent)
+    , m_minimum(0)
+{
+}
+
+int JavaScriptTimersObject::minimum() const
+{
+    return m_minimum;
+}
+
+void JavaScriptTimersObject::setMinimum(int minimum)
+{
+    m_minimum = minimum;
+}
+
 WebPage::WebPage(QObject *parent)
     : WebPageProxy(parent)
     , m_openTargetBlankLinksIn(TabWidget::NewWindow)
     , m_javaScriptExternalObject(0)
     , m_javaScriptAroraObject(0)
+    , m_javaScriptTimersObject(new JavaScriptTimersObject(this))
 {
     setPluginFactory(webPluginFactory());
     NetworkAccessManagerProxy *networkManagerProxy = new NetworkAccessManagerProxy(this);
@@ -218,6 +236,7 @@ void WebPage::addExternalBinding(QWebFrame *frame)
 
             frame->addToJavaScriptWindowObject(QLatin1String("arora"), m_javaScriptAroraObject);
         }
+        throttleTimers(frame);
     } else { // called from QWebPage::frameCreated
         connect(frame, SIGNAL(javaScriptWindowObjectCleared()),
                 this, SLOT(addExternalBinding()));
@@ -225,6 +244,64 @@ void WebPage::addExternalBinding(QWebFrame *frame)
     frame->addToJavaScriptWindowObject(QLatin1String("external"), m_javaScriptExternalObject);
 }
 
+// Background pages run their timers at most once a second
+static const int backgroundTimerInterval = 1000;
+
+static QList<QWebFrame*> allFrames(QWebFrame *frame)
+{
+    QList<QWebFrame*> frames;
+    frames.append(frame);
+    foreach (QWebFrame *child, frame->childFrames())
+        frames += allFrames(child);
+    return frames;
+}
+
+/*
+    Wraps the timers of the document in \a frame so the ones of a page in
+    the background can be slowed down and the time spent in them counted.
+    The script takes the timers object off the window again, pages only
+    see the read only __aroraTimersBusy counter.
+ */
+void WebPage::throttleTimers(QWebFrame *frame)
+{
+    static QString script;
+    if (script.isEmpty()) {
+        QFile file(QLatin1String(":backgroundTimers.js"));
+        if (!file.open(QFile::ReadOnly))
+            return;
+        script = QString::fromUtf8(file.readAll());
+    }
+    frame->addToJavaScriptWindowObject(QLatin1String("__aroraTimers"), m_javaScriptTimersObject);
+    frame->evaluateJavaScript(script);
+}
+
+bool WebPage::isBackground() const
+{
+    return m_javaScriptTimersObject->minimum() != 0;
+}
+
+/*!
+    Pages that are not shown are put in the background where their
+    JavaScript timers fire at most once a second.
+ */
+void WebPage::setBackground(bool background)
+{
+    m_javaScriptTimersObject->setMinimum(background ? backgroundTimerInterval : 0);
+}
+
+/*!
+    Returns the milliseconds the documents in the page have spent running
+    their timers.
+ */
+qint64 WebPage::scriptTime() const
+{
+    qint64 time = 0;
+    QString script = QLatin1String("window.__aroraTimersBusy || 0");
+    foreach (QWebFrame *frame, allFrames(mainFrame()))
+        time += frame->evaluateJavaScript(script).toLongLong();
+    return time;
+}
+
 QString WebPage::userAgent()
 {
     return s_userAgent;
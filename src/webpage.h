@@ -37,6 +37,7 @@ public:
 
 class OpenSearchEngine;
 class QNetworkReply;
+class QWebFrame;
 class WebPluginFactory;
 // See https://developer.mozilla.org/en/adding_search_engines_from_web_pages
 class JavaScriptExternalObject : public QObject
@@ -65,6 +66,23 @@ public slots:
     QString searchUrl(const QString &string) const;
 };
 
+// Read by the timer wrappers of the page, see backgroundTimers.js
+class JavaScriptTimersObject : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int minimum READ minimum)
+
+public:
+    JavaScriptTimersObject(QObject *parent = 0);
+
+    int minimum() const;
+    void setMinimum(int minimum);
+
+private:
+    int m_minimum;
+};
+
 class WebPage : public WebPageProxy
 {
     Q_OBJECT
@@ -84,6 +102,10 @@ public:
     static QString userAgent();
     static void setUserAgent(const QString &userAgent);
 
+    bool isBackground() const;
+    void setBackground(bool background);
+    qint64 scriptTime() const;
+
 protected:
     QString userAgentForUrl(const QUrl &url) const;
     bool acceptNavigationRequest(QWebFrame *frame, const QNetworkRequest &request,
@@ -103,8 +125,11 @@ protected:
     QUrl m_requestedUrl;
     JavaScriptExternalObject *m_javaScriptExternalObject;
     JavaScriptAroraObject *m_javaScriptAroraObject;
+    JavaScriptTimersObject *m_javaScriptTimersObject;
 
 private:
+    void throttleTimers(QWebFrame *frame);
+
     QNetworkRequest lastRequest;
     QWebPage::NavigationType lastRequestType;
 
@@ -86,6 +86,12 @@
 #include <qtimer.h>
 #include <qwebframe.h>
 
+#if QT_VERSION >= 0x040700
+#include <qelapsedtimer.h>
+#else
+#include <qdatetime.h>
+#endif
+
 #if QT_VERSION >= 0x040600 || defined(WEBKIT_TRUNK)
 #if !defined(QTWEBKIT_VERSION) || QTWEBKIT_VERSION < 0x020000
 Q_DECLARE_METATYPE(QWebElement)
@@ -104,6 +110,7 @@ Q_DECLARE_METATYPE(QWebElement)
 WebView::WebView(QWidget *parent)
     : QWebView(parent)
     , m_progress(0)
+    , m_paintTime(0)
     , m_currentZoom(100)
     , m_page(new WebPage(this))
 #if QT_VERSION >= 0x040600 || defined(WEBKIT_TRUNK)
@@ -330,6 +337,27 @@ void WebView::resizeEvent(QResizeEvent *event)
     QWebView::resizeEvent(event);
 }
 
+void WebView::paintEvent(QPaintEvent *event)
+{
+#if QT_VERSION >= 0x040700
+    QElapsedTimer clock;
+#else
+    QTime clock;
+#endif
+    clock.start();
+    QWebView::paintEvent(event);
+    m_paintTime += clock.elapsed();
+}
+
+/*!
+    Returns the milliseconds spent painting the page and running the
+    timers of its scripts.
+ */
+qint64 WebView::cpuTime() const
+{
+    return m_paintTime + m_page->scriptTime();
+}
+
 void WebView::downloadLinkToDisk()
 {
     pageAction(QWebPage::DownloadLinkToDisk)->trigger();
@@ -100,6 +100,7 @@ public:
     QString lastStatusBarText() const;
     inline int progress() const { return m_progress; }
     TabWidget *tabWidget() const;
+    qint64 cpuTime() const;
 
 signals:
     void search(const QUrl &searchUrl, TabWidget::OpenUrlIn openIn);
@@ -120,6 +121,7 @@ protected:
     void dragMoveEvent(QDragMoveEvent *event);
     void dropEvent(QDropEvent *event);
     void keyPressEvent(QKeyEvent *event);
+    void paintEvent(QPaintEvent *event);
 
 private:
     int levelForZoom(int zoom);
@@ -150,6 +152,7 @@ private:
     QString m_statusBarText;
     QUrl m_initialUrl;
     int m_progress;
+    qint64 m_paintTime;
     int m_currentZoom;
     QList<int> m_zoomLevels;
     WebPage *m_page;
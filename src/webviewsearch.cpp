@@ -79,15 +79,40 @@ QWebView *WebViewSearch::webView() const
 
 WebViewWithSearch::WebViewWithSearch(WebView *webView, QWidget *parent)
     : QWidget(parent)
-    , m_webView(webView)
+    , m_webView(0)
+    , m_webViewSearch(0)
 {
-    m_webView->setParent(this);
     QVBoxLayout *layout = new QVBoxLayout;
     layout->setSpacing(0);
     layout->setContentsMargins(0, 0, 0, 0);
+    setLayout(layout);
+    if (webView)
+        setWebView(webView);
+}
+
+/*!
+    Shows \a webView, a tab that is restored on demand only gets its
+    WebView when it is first shown.
+ */
+void WebViewWithSearch::setWebView(WebView *webView)
+{
+    Q_ASSERT(!m_webView);
+    m_webView = webView;
+    m_webView->setParent(this);
     m_webViewSearch = new WebViewSearch(m_webView, this);
+    QBoxLayout *layout = static_cast<QBoxLayout*>(this->layout());
     layout->addWidget(m_webViewSearch);
     layout->addWidget(m_webView);
-    setLayout(layout);
+}
+
+/*!
+    Destroys the WebView of a tab that is hibernated.
+ */
+void WebViewWithSearch::clearWebView()
+{
+    delete m_webViewSearch;
+    m_webViewSearch = 0;
+    delete m_webView;
+    m_webView = 0;
 }
 
@@ -55,6 +55,8 @@ class WebViewWithSearch : public QWidget
 
 public:
     WebViewWithSearch(WebView *webView, QWidget *parent = 0);
+    void setWebView(WebView *webView);
+    void clearWebView();
     WebView *m_webView;
     WebViewSearch *m_webViewSearch;
 };
@@ -1,7 +1,7 @@
 TEMPLATE = app
 TARGET = arora-cacheinfo
-DEPENDPATH += .
-INCLUDEPATH += .
+DEPENDPATH += . ../../src/network
+INCLUDEPATH += . ../../src/network
 
 win32|os2: CONFIG += console
 mac:CONFIG -= app_bundle
@@ -9,7 +9,8 @@ mac:CONFIG -= app_bundle
 QT += network
 
 # Input
-SOURCES += main.cpp
+HEADERS += networkcachestore.h
+SOURCES += main.cpp networkcachestore.cpp
 
 RCC_DIR     = $$PWD/.rcc
 UI_DIR      = $$PWD/.ui
@@ -20,53 +20,371 @@
 #include <QtNetwork/QtNetwork>
 #include <QtGui/QtGui>
 
-class NetworkDiskCache : public QNetworkDiskCache
+#include "networkcachestore.h"
+
+struct ScanJob
+{
+    QString fileName;
+    QList<QUrl> urls;
+    QList<NetworkCacheStore::Entry> entries;
+    bool readData;
+};
+
+struct ScanItem
+{
+    QUrl url;
+    QString host;
+    QString contentType;
+    QDateTime date;
+    qint64 storedSize;
+    qint64 dataSize;
+    uint expires;
+    quint32 hits;
+    bool compressed;
+    QByteArray hash;
+    bool damaged;
+};
+
+static QList<ScanItem> scanShard(const ScanJob &job)
+{
+    QList<ScanItem> items;
+    QFile file(job.fileName);
+    bool opened = file.open(QFile::ReadOnly);
+    for (int i = 0; i < job.entries.count(); ++i) {
+        const NetworkCacheStore::Entry &entry = job.entries.at(i);
+        ScanItem item;
+        item.url = job.urls.at(i);
+        item.host = item.url.host();
+        item.storedSize = entry.size;
+        item.dataSize = entry.bodySize;
+        item.expires = entry.expires;
+        item.hits = entry.hits;
+        item.compressed = entry.compressed;
+
+        QNetworkCacheMetaData metaData;
+        QByteArray data;
+        item.damaged = !opened
+            || !NetworkCacheStore::readEntry(&file, entry, &metaData, job.readData ? &data : 0);
+        if (!item.damaged && job.readData) {
+            item.dataSize = data.size();
+            item.hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+        }
+        foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders()) {
+            QByteArray name = header.first.toLower();
+            if (name == "content-type")
+                item.contentType = QString::fromLatin1(header.second).section(QLatin1Char(';'), 0, 0).trimmed().toLower();
+            else if (name == "date")
+                item.date = QDateTime::fromString(QString::fromLatin1(header.second).left(25), QLatin1String("ddd, dd MMM yyyy hh:mm:ss"));
+        }
+        if (!item.date.isValid())
+            item.date = metaData.lastModified();
+        items.append(item);
+    }
+    return items;
+}
+
+static void addItems(QList<ScanItem> &items, const QList<ScanItem> &shardItems)
+{
+    items += shardItems;
+}
+
+/*
+    Reads every entry of the store, one shard per thread.
+ */
+static QList<ScanItem> scan(NetworkCacheStore &store, bool readData)
+{
+    QList<ScanJob> jobs;
+    for (int i = 0; i < store.shardCount(); ++i) {
+        ScanJob job;
+        job.fileName = store.shardFileName(i);
+        job.readData = readData;
+        jobs.append(job);
+    }
+    foreach (const QUrl &url, store.urls()) {
+        NetworkCacheStore::Entry entry = store.entry(url);
+        jobs[entry.shard].urls.append(url);
+        jobs[entry.shard].entries.append(entry);
+    }
+    return QtConcurrent::blockingMappedReduced<QList<ScanItem> >(jobs, scanShard, addItems);
+}
+
+class Output
 {
 public:
-    QNetworkCacheMetaData _fileMetaData(const QString &fileName)
-        { return fileMetaData(fileName); }
+    Output(bool json) : m_json(json), m_stream(stdout), m_first(true), m_firstValue(true) {}
 
+    void beginSection(const QString &name)
+    {
+        if (m_json) {
+            m_stream << (m_first ? "{\n" : ",\n") << "  " << quote(name) << ": {";
+            m_firstValue = true;
+        } else {
+            m_stream << name << ":" << endl;
+        }
+        m_first = false;
+    }
+
+    void value(const QString &name, const QVariant &value)
+    {
+        if (m_json) {
+            m_stream << (m_firstValue ? "\n" : ",\n") << "    " << quote(name) << ": ";
+            if (value.type() == QVariant::String)
+                m_stream << quote(value.toString());
+            else
+                m_stream << value.toString();
+            m_firstValue = false;
+        } else {
+            m_stream << "\t" << name << ": " << value.toString() << endl;
+        }
+    }
+
+    // An object with numeric fields in JSON so the breakdowns can be summed
+    void totals(const QString &name, int count, qint64 bytes)
+    {
+        if (m_json) {
+            m_stream << (m_firstValue ? "\n" : ",\n") << "    " << quote(name)
+                     << ": { \"count\": " << count << ", \"bytes\": " << bytes << " }";
+            m_firstValue = false;
+        } else {
+            m_stream << "\t" << name << ": " << count << " entries, " << bytes << " bytes" << endl;
+        }
+    }
+
+    void endSection()
+    {
+        if (m_json)
+            m_stream << "\n  }";
+    }
+
+    void finish()
+    {
+        if (m_json)
+            m_stream << (m_first ? "{\n}\n" : "\n}\n");
+    }
+
+private:
+    static QString quote(const QString &string)
+    {
+        QString escaped = string;
+        escaped.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+        escaped.replace(QLatin1Char('"'), QLatin1String("\\\""));
+        escaped.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+        return QLatin1Char('"') + escaped + QLatin1Char('"');
+    }
+
+    bool m_json;
+    QTextStream m_stream;
+    bool m_first;
+    bool m_firstValue;
 };
 
-int main(int argc, char **argv)
+struct Totals
 {
-    QCoreApplication application(argc, argv);
-    QCoreApplication::setOrganizationDomain(QLatin1String("arora-browser.org"));
-    QCoreApplication::setApplicationName(QLatin1String("Arora"));
+    Totals() : count(0), bytes(0) {}
+    int count;
+    qint64 bytes;
+};
 
-    QStringList args = application.arguments();
-    args.takeFirst();
-    if (args.isEmpty()) {
-        QTextStream stream(stdout);
-        stream << "arora-cacheinfo is a tool for viewing and extracting information out of Arora cache files." << endl;
-        stream << "arora-cacheinfo [-o cachefile] [file | url]" << endl;
-        return 0;
+static void outputTotals(Output &output, const QString &section, const QHash<QString, Totals> &totals, int limit = 20)
+{
+    QMultiMap<qint64, QString> bySize;
+    QHash<QString, Totals>::const_iterator it = totals.constBegin();
+    for (; it != totals.constEnd(); ++it)
+        bySize.insert(it.value().bytes, it.key());
+
+    output.beginSection(section);
+    QMapIterator<qint64, QString> sorted(bySize);
+    sorted.toBack();
+    for (int i = 0; i < limit && sorted.hasPrevious(); ++i) {
+        sorted.previous();
+        const Totals &total = totals[sorted.value()];
+        QString name = sorted.value().isEmpty() ? QLatin1String("(none)") : sorted.value();
+        output.totals(name, total.count, total.bytes);
     }
+    output.endSection();
+}
 
-    NetworkDiskCache diskCache;
-    QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
-            + QLatin1String("/browser/");
-    diskCache.setCacheDirectory(location);
+static QString bucket(int seconds)
+{
+    if (seconds < 60 * 60)
+        return QLatin1String("< 1 hour");
+    if (seconds < 24 * 60 * 60)
+        return QLatin1String("< 1 day");
+    if (seconds < 7 * 24 * 60 * 60)
+        return QLatin1String("< 1 week");
+    if (seconds < 30 * 24 * 60 * 60)
+        return QLatin1String("< 1 month");
+    return QLatin1String("> 1 month");
+}
 
-    QNetworkCacheMetaData metaData;
-    QString last = args.takeLast();
-    if (QFile::exists(last)) {
-        qDebug() << "Reading in from a file and not a URL.";
-        metaData = diskCache._fileMetaData(last);
-    } else {
-        qDebug() << "Reading in from a URL and not a file.";
-        metaData = diskCache.metaData(last);
-    }
-
-    if (!args.isEmpty()
-        && args.count() >= 1
-        && args.first() == QLatin1String("-o")) {
-        QUrl url = metaData.url();
-        QIODevice *device = diskCache.data(url);
-        if (!device) {
-            qDebug() << "Error: data for URL is 0!";
-            return 1;
+static int report(NetworkCacheStore &store, Output &output)
+{
+    QList<ScanItem> items = scan(store, true);
+
+    Totals all;
+    Totals compressed;
+    Totals unused;
+    Totals damaged;
+    qint64 dataSize = 0;
+    QHash<QString, Totals> hosts;
+    QHash<QString, Totals> contentTypes;
+    QHash<QString, Totals> ages;
+    QHash<QString, Totals> expiration;
+    QHash<QByteArray, Totals> bodies;
+    uint now = QDateTime::currentDateTime().toTime_t();
+    foreach (const ScanItem &item, items) {
+        Totals *totals[] = { &all, &hosts[item.host], &contentTypes[item.contentType], 0, 0, 0, 0 };
+        int count = 3;
+        if (item.damaged) {
+            totals[count++] = &damaged;
+        } else {
+            dataSize += item.dataSize;
+            bodies[item.hash].count++;
+            bodies[item.hash].bytes = item.storedSize;
+        }
+        if (item.compressed)
+            totals[count++] = &compressed;
+        if (item.hits == 0)
+            totals[count++] = &unused;
+        QString age = item.date.isValid()
+                      ? bucket(item.date.toTime_t() > now ? 0 : now - item.date.toTime_t())
+                      : QLatin1String("unknown");
+        ages[age].count++;
+        ages[age].bytes += item.storedSize;
+        QString expires = QLatin1String("never");
+        if (item.expires)
+            expires = item.expires <= now ? QLatin1String("expired") : bucket(item.expires - now);
+        expiration[expires].count++;
+        expiration[expires].bytes += item.storedSize;
+        for (int i = 0; i < count; ++i) {
+            totals[i]->count++;
+            totals[i]->bytes += item.storedSize;
         }
+    }
+
+    Totals duplicates;
+    foreach (const Totals &body, bodies) {
+        if (body.count < 2)
+            continue;
+        duplicates.count += body.count - 1;
+        duplicates.bytes += (body.count - 1) * body.bytes;
+    }
+
+    output.beginSection(QLatin1String("summary"));
+    output.value(QLatin1String("directory"), store.directory());
+    output.value(QLatin1String("entries"), all.count);
+    output.value(QLatin1String("diskSize"), store.size());
+    output.value(QLatin1String("liveSize"), store.liveSize());
+    output.value(QLatin1String("maximumSize"), store.maximumSize());
+    output.value(QLatin1String("dataSize"), dataSize);
+    output.value(QLatin1String("compressedEntries"), compressed.count);
+    output.value(QLatin1String("compressedSize"), compressed.bytes);
+    output.value(QLatin1String("neverReusedEntries"), unused.count);
+    output.value(QLatin1String("neverReusedSize"), unused.bytes);
+    output.value(QLatin1String("duplicateEntries"), duplicates.count);
+    output.value(QLatin1String("duplicateSize"), duplicates.bytes);
+    output.value(QLatin1String("damagedEntries"), damaged.count);
+    output.endSection();
+
+    outputTotals(output, QLatin1String("hosts"), hosts);
+    outputTotals(output, QLatin1String("contentTypes"), contentTypes);
+    outputTotals(output, QLatin1String("age"), ages);
+    outputTotals(output, QLatin1String("expiration"), expiration);
+    return 0;
+}
+
+static int prune(NetworkCacheStore &store, Output &output, const QStringList &args)
+{
+    qint64 sizeBefore = store.size();
+    int countBefore = store.count();
+    bool expired = args.contains(QLatin1String("--expired"));
+    bool unused = args.contains(QLatin1String("--unused"));
+    int maxSize = args.indexOf(QLatin1String("--max-size"));
+    if (maxSize != -1 && maxSize + 1 < args.count())
+        store.setMaximumSize(args.at(maxSize + 1).toLongLong() * 1024 * 1024);
+
+    uint now = QDateTime::currentDateTime().toTime_t();
+    foreach (const QUrl &url, store.urls()) {
+        NetworkCacheStore::Entry entry = store.entry(url);
+        if ((expired && entry.expires && entry.expires < now)
+            || (unused && entry.hits == 0))
+            store.remove(url);
+    }
+    store.expire();
+    store.waitForCompaction();
+    store.saveIndex();
+
+    output.beginSection(QLatin1String("prune"));
+    output.value(QLatin1String("removedEntries"), countBefore - store.count());
+    output.value(QLatin1String("sizeBefore"), sizeBefore);
+    output.value(QLatin1String("sizeAfter"), store.size());
+    output.endSection();
+    return 0;
+}
+
+static int compact(NetworkCacheStore &store, Output &output)
+{
+    qint64 sizeBefore = store.size();
+    int failed = 0;
+    for (int i = 0; i < store.shardCount(); ++i) {
+        if (store.deadSize(i) > 0 && !store.compact(i))
+            ++failed;
+    }
+
+    output.beginSection(QLatin1String("compact"));
+    output.value(QLatin1String("sizeBefore"), sizeBefore);
+    output.value(QLatin1String("sizeAfter"), store.size());
+    output.value(QLatin1String("failedShards"), failed);
+    output.endSection();
+    return failed ? 1 : 0;
+}
+
+static int verify(NetworkCacheStore &store, Output &output, const QStringList &args)
+{
+    bool repair = args.contains(QLatin1String("--repair"));
+    QList<ScanItem> items = scan(store, true);
+    int damaged = 0;
+    output.beginSection(QLatin1String("verify"));
+    output.value(QLatin1String("entries"), items.count());
+    foreach (const ScanItem &item, items) {
+        if (!item.damaged)
+            continue;
+        ++damaged;
+        output.value(item.url.toString(), QLatin1String("damaged"));
+        if (repair)
+            store.remove(item.url);
+    }
+    output.value(QLatin1String("damagedEntries"), damaged);
+    output.value(QLatin1String("repaired"), repair);
+    output.endSection();
+    if (repair)
+        store.saveIndex();
+    return damaged && !repair ? 1 : 0;
+}
+
+static int info(NetworkCacheStore &store, QStringList args)
+{
+    if (args.isEmpty()) {
+        qDebug() << "Please specify a url.";
+        return 1;
+    }
+    QUrl url = QUrl::fromEncoded(args.takeLast().toUtf8());
+    if (!store.contains(url)) {
+        qDebug() << "Error:" << url << "is not in the cache.";
+        return 1;
+    }
+    // Read the entry directly so that looking at it does not count as a hit
+    NetworkCacheStore::Entry entry = store.entry(url);
+    QNetworkCacheMetaData metaData;
+    QByteArray data;
+    QFile shard(store.shardFileName(entry.shard));
+    if (!shard.open(QFile::ReadOnly)
+        || !NetworkCacheStore::readEntry(&shard, entry, &metaData, &data)) {
+        qDebug() << "Error: the cache entry for" << url << "is damaged.";
+        return 1;
+    }
+
+    if (!args.isEmpty() && args.first() == QLatin1String("-o")) {
         QString fileName;
         if (args.count() == 2) {
             fileName = args.last();
@@ -87,8 +405,7 @@ int main(int argc, char **argv)
         if (!file.open(QFile::ReadWrite))
             qDebug() << "Unable to open the output file for writing.";
         else
-            file.write(device->readAll());
-        delete device;
+            file.write(data);
     }
 
     QTextStream stream(stdout);
@@ -96,18 +413,84 @@ int main(int argc, char **argv)
     stream << "Expiration Date: " << metaData.expirationDate().toString() << endl;
     stream << "Last Modified Date: " << metaData.lastModified().toString() << endl;
     stream << "Save to disk: " << metaData.saveToDisk() << endl;
+    stream << "Shard: " << store.shardFileName(entry.shard) << " at " << entry.offset << endl;
+    stream << "Stored Size: " << entry.bodySize << (entry.compressed ? " (compressed)" : "") << endl;
+    stream << "Hits: " << entry.hits << endl;
     stream << "Headers:" << endl;
     foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders())
         stream << "\t" << header.first << ": " << header.second << endl;
-    QIODevice *device = diskCache.data(metaData.url());
-    if (device) {
-        stream << "Data Size: " << device->size() << endl;
-        stream << "First line: " << device->readLine(100);
-    } else {
-        stream << "No data? Either the file is corrupt or there is an error." << endl;
+    stream << "Data Size: " << data.size() << endl;
+    QBuffer buffer(&data);
+    buffer.open(QBuffer::ReadOnly);
+    stream << "First line: " << buffer.readLine(100);
+    return 0;
+}
+
+static void usage()
+{
+    QTextStream stream(stdout);
+    stream << "arora-cacheinfo is a tool for inspecting and maintaining the Arora cache." << endl;
+    stream << "arora-cacheinfo [--cache-dir dir] [--json] command" << endl;
+    stream << "Commands:" << endl;
+    stream << "\t[info] [-o file] url\tshow the meta data of url and optionally save its data" << endl;
+    stream << "\treport\t\t\tsize by host, content type, age and expiration, duplicates and unused entries" << endl;
+    stream << "\tprune [--max-size MB] [--expired] [--unused]" << endl;
+    stream << "\tcompact\t\t\treclaim the space of removed entries" << endl;
+    stream << "\tverify [--repair]\tread every entry and report (or remove) damaged ones" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setOrganizationDomain(QLatin1String("arora-browser.org"));
+    QCoreApplication::setApplicationName(QLatin1String("Arora"));
+
+    QStringList args = application.arguments();
+    args.takeFirst();
+    if (args.isEmpty()) {
+        usage();
+        return 0;
     }
 
-    delete device;
-    return 0;
+    QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation)
+            + QLatin1String("/browser");
+    int cacheDir = args.indexOf(QLatin1String("--cache-dir"));
+    if (cacheDir != -1 && cacheDir + 1 < args.count()) {
+        location = args.at(cacheDir + 1);
+        args.removeAt(cacheDir);
+        args.removeAt(cacheDir);
+    }
+    bool json = args.removeAll(QLatin1String("--json")) > 0;
+    if (args.isEmpty()) {
+        usage();
+        return 1;
+    }
+
+    QSettings settings;
+    settings.beginGroup(QLatin1String("network"));
+    qint64 maximumCacheSize = settings.value(QLatin1String("maximumCacheSize"), 50).toInt();
+
+    NetworkCacheStore store;
+    store.setDirectory(location);
+    store.setMaximumSize(maximumCacheSize * 1024 * 1024);
+
+    Output output(json);
+    QString command = args.first();
+    int result;
+    if (command == QLatin1String("report")) {
+        result = report(store, output);
+    } else if (command == QLatin1String("prune")) {
+        result = prune(store, output, args);
+    } else if (command == QLatin1String("compact")) {
+        result = compact(store, output);
+    } else if (command == QLatin1String("verify")) {
+        result = verify(store, output, args);
+    } else {
+        if (command == QLatin1String("info"))
+            args.takeFirst();
+        return info(store, args);
+    }
+    output.finish();
+    return result;
 }
 